@@ -0,0 +1,131 @@
+//! The bus entry points (`--bench`) against tests/fixtures/mock_systemd.c on a
+//! private dbus-daemon, so the numbers do not depend on the host's systemd:
+//! `cargo bench --features bench --bench bus [-- UNITS...]`, by default 10, 1000 and 50000 units.
+//! Needs dbus-daemon on the PATH; the popen(systemctl) row also needs systemctl.
+
+#[cfg(target_os = "linux")]
+mod fixture {
+    use std::io::{BufRead, BufReader};
+    use std::path::PathBuf;
+    use std::process::{Child, Command, Stdio};
+
+    /// A dbus-daemon with the mock systemd on it; both are killed on drop.
+    pub struct Fixture {
+        dir: PathBuf,
+        children: Vec<Child>,
+        pub address: String,
+    }
+
+    /// The first line `child` prints, which both programs use to say they serve.
+    fn first_line(child: &mut Child) -> std::io::Result<String> {
+        let mut line = String::new();
+        BufReader::new(child.stdout.take().unwrap()).read_line(&mut line)?;
+        Ok(line.trim().to_string())
+    }
+
+    impl Fixture {
+        pub fn start(mock: &str, units: usize) -> std::io::Result<Fixture> {
+            let dir = std::env::temp_dir().join(format!("bus_bench.{}.{}", std::process::id(), units));
+            std::fs::create_dir_all(&dir)?;
+            let mut fixture = Fixture { dir, children: Vec::new(), address: String::new() };
+
+            // Unit files for the FragmentPaths the mock reports, read by the popen(systemctl) row.
+            let units_dir = fixture.dir.join("units");
+            std::fs::create_dir_all(&units_dir)?;
+            for unit in 0..units {
+                let name = format!("fixture{:06}.{}", unit, if unit % 10 == 9 { "socket" } else { "service" });
+                let text = format!(
+                    "[Unit]\nDescription=Fixture unit {unit}\n\n[Service]\nType=simple\nUser=nobody\nExecStart=/usr/bin/true --config=/etc/fixture/{unit}.conf\n",
+                    unit = unit
+                );
+                std::fs::write(units_dir.join(name), text)?;
+            }
+
+            let config = concat!(env!("CARGO_MANIFEST_DIR"), "/tests/fixtures/bus.conf");
+            let mut daemon = Command::new("dbus-daemon")
+                .arg(format!("--config-file={}", config))
+                .arg(format!("--address=unix:path={}", fixture.dir.join("bus.sock").display()))
+                .args(["--nofork", "--print-address"])
+                .stdout(Stdio::piped())
+                .stderr(Stdio::null())
+                .spawn()?;
+            let address = first_line(&mut daemon);
+            fixture.children.push(daemon);
+            fixture.address = address?;
+            if fixture.address.is_empty() {
+                return Err(std::io::Error::new(std::io::ErrorKind::Other, "dbus-daemon did not start"));
+            }
+
+            let mut server = Command::new(mock)
+                .arg(&fixture.address)
+                .arg(units.to_string())
+                .arg(&units_dir)
+                .stdout(Stdio::piped())
+                .spawn()?;
+            let ready = first_line(&mut server);
+            fixture.children.push(server);
+            if ready? != "ready" {
+                return Err(std::io::Error::new(std::io::ErrorKind::Other, "mock_systemd did not start"));
+            }
+            Ok(fixture)
+        }
+    }
+
+    impl Drop for Fixture {
+        fn drop(&mut self) {
+            for child in self.children.iter_mut().rev() {
+                let _ = child.kill();
+                let _ = child.wait();
+            }
+            let _ = std::fs::remove_dir_all(&self.dir);
+        }
+    }
+
+    /// Iterations per entry point: enough for a stable p99 without listing 50k units a thousand times.
+    fn iterations(units: usize) -> usize {
+        match units {
+            0..=100 => 2000,
+            101..=5000 => 500,
+            _ => 20,
+        }
+    }
+
+    pub fn run(sizes: &[usize]) -> std::io::Result<()> {
+        let mock = match option_env!("SERVICE_VIEWER_MOCK_SYSTEMD") {
+            Some(mock) => mock,
+            None => {
+                eprintln!("mock_systemd was not built, see the build warnings");
+                return Ok(());
+            }
+        };
+
+        for &units in sizes {
+            let fixture = Fixture::start(mock, units)?;
+            println!("== mock systemd with {} units on {}", units, fixture.address);
+            let status = Command::new(env!("CARGO_BIN_EXE_service_viewer"))
+                .args(["--bus-address", &fixture.address, "--bench", &iterations(units).to_string()])
+                .status()?;
+            if !status.success() {
+                return Err(std::io::Error::new(std::io::ErrorKind::Other, format!("service_viewer --bench {}", status)));
+            }
+            println!();
+        }
+        Ok(())
+    }
+}
+
+fn main() {
+    // cargo bench passes `--bench`; numbers pick the fixture sizes.
+    let mut sizes: Vec<usize> = std::env::args().skip(1).filter_map(|arg| arg.parse().ok()).collect();
+    if sizes.is_empty() {
+        sizes = vec![10, 1_000, 50_000];
+    }
+
+    #[cfg(target_os = "linux")]
+    if let Err(err) = fixture::run(&sizes) {
+        eprintln!("bus benchmark failed: {}", err);
+        std::process::exit(1);
+    }
+    #[cfg(not(target_os = "linux"))]
+    let _ = sizes;
+}
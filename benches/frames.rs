@@ -0,0 +1,28 @@
+//! Per-frame cost of the UI over a large list: `cargo bench --features bench --bench frames [-- UNITS]`,
+//! by default 100k synthetic units. Runs `service_viewer --bench 1000 --frames UNITS`,
+//! which draws the app into a ratatui TestBackend; no systemd is involved.
+
+fn main() {
+    // cargo bench passes `--bench`; a number picks the unit count.
+    let units: usize = std::env::args().skip(1).find_map(|arg| arg.parse().ok()).unwrap_or(100_000);
+
+    #[cfg(target_os = "linux")]
+    {
+        let status = std::process::Command::new(env!("CARGO_BIN_EXE_service_viewer"))
+            .args(["--bench", "1000", "--frames", &units.to_string()])
+            .status();
+        match status {
+            Ok(status) if status.success() => {}
+            Ok(status) => {
+                eprintln!("frame benchmark failed: service_viewer {}", status);
+                std::process::exit(1);
+            }
+            Err(err) => {
+                eprintln!("frame benchmark failed: {}", err);
+                std::process::exit(1);
+            }
+        }
+    }
+    #[cfg(not(target_os = "linux"))]
+    let _ = units;
+}
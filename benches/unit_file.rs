@@ -0,0 +1,133 @@
+//! Throughput of the unit file parser (src/unit_file.c) over a synthetic corpus:
+//! `cargo bench --features bench --bench unit_file [-- FILES]`. Every fourth unit has a drop-in,
+//! and the files use comments, continuations and `=` inside values like real ones.
+
+#[cfg(target_os = "linux")]
+mod parser {
+    use std::ffi::CString;
+    use std::os::raw::c_char;
+    use std::path::{Path, PathBuf};
+    use std::time::{Duration, Instant};
+
+    #[repr(C)]
+    pub struct UnitFile {
+        _private: [u8; 0],
+    }
+
+    extern "C" {
+        fn parseUnitFile(cache: *mut u8, root: *const c_char, path: *const c_char, dropin_dirs: *const *const c_char, dropin_dir_count: usize) -> *mut UnitFile;
+        fn freeUnitFile(unit: *mut UnitFile);
+    }
+
+    const ROUNDS: usize = 5;
+
+    fn unit_text(i: usize) -> String {
+        format!(
+            "#  SPDX-License-Identifier: LGPL-2.1-or-later\n\
+             #\n\
+             # Synthetic unit {i} for the parser benchmark.\n\
+             \n\
+             [Unit]\n\
+             Description=Synthetic service number {i}\n\
+             Documentation=man:synthetic({i}) https://example.org/docs/{i}\n\
+             After=network-online.target remote-fs.target nss-lookup.target\n\
+             Wants=network-online.target\n\
+             ConditionPathExists=/etc/synthetic/{i}.conf\n\
+             \n\
+             [Service]\n\
+             Type=notify\n\
+             User=svc{user}\n\
+             Environment=LANG=C.UTF-8 MODE=fast=1\n\
+             EnvironmentFile=-/etc/default/synthetic{i}\n\
+             ExecStartPre=/usr/bin/synthetic --check\n\
+             ExecStart=/usr/bin/synthetic{i} \\\n    --config=/etc/synthetic/{i}.conf \\\n# keeps the old flag around\n    --listen=127.0.0.1:{port} \\\n    --verbose\n\
+             ExecReload=/bin/kill -HUP $MAINPID\n\
+             Restart=on-failure\n\
+             RestartSec=5s\n\
+             LimitNOFILE=65536\n\
+             ProtectSystem=strict\n\
+             ProtectHome=yes\n\
+             ReadWritePaths=/var/lib/synthetic{i}\n\
+             ; a semicolon comment\n\
+             \n\
+             [Install]\n\
+             WantedBy=multi-user.target\n",
+            i = i,
+            user = i % 17,
+            port = 10000 + i % 50000
+        )
+    }
+
+    const DROPIN: &str = "[Service]\nExecStartPre=\nExecStartPre=/usr/bin/true\nEnvironment=EXTRA=1\n";
+
+    fn write_corpus(dir: &Path, files: usize) -> std::io::Result<(Vec<PathBuf>, u64)> {
+        let mut paths = Vec::with_capacity(files);
+        let mut bytes = 0;
+        for i in 0..files {
+            let path = dir.join(format!("synthetic{:06}.service", i));
+            let text = unit_text(i);
+            bytes += text.len() as u64;
+            std::fs::write(&path, text)?;
+            if i % 4 == 0 {
+                let dropins = dir.join(format!("synthetic{:06}.service.d", i));
+                std::fs::create_dir_all(&dropins)?;
+                std::fs::write(dropins.join("override.conf"), DROPIN)?;
+                bytes += DROPIN.len() as u64;
+            }
+            paths.push(path);
+        }
+        Ok((paths, bytes))
+    }
+
+    pub fn run(files: usize) -> std::io::Result<()> {
+        let dir = std::env::temp_dir().join(format!("unit_file_bench.{}", std::process::id()));
+        std::fs::create_dir_all(&dir)?;
+        let (paths, bytes) = write_corpus(&dir, files)?;
+        let paths: Vec<CString> = paths.iter().map(|path| CString::new(path.to_str().unwrap()).unwrap()).collect();
+        let dirs = [CString::new(dir.to_str().unwrap()).unwrap()];
+        let dir_ptrs: Vec<*const c_char> = dirs.iter().map(|dir| dir.as_ptr()).collect();
+
+        let mut durations: Vec<Duration> = Vec::with_capacity(files * ROUNDS);
+        let mut failed = 0;
+        let start = Instant::now();
+        for _ in 0..ROUNDS {
+            for path in &paths {
+                let call = Instant::now();
+                let unit = unsafe { parseUnitFile(std::ptr::null_mut(), std::ptr::null(), path.as_ptr(), dir_ptrs.as_ptr(), dir_ptrs.len()) };
+                durations.push(call.elapsed());
+                if unit.is_null() {
+                    failed += 1;
+                }
+                unsafe { freeUnitFile(unit) };
+            }
+        }
+        let elapsed = start.elapsed();
+        durations.sort_unstable();
+        let percentile = |p: usize| durations[(durations.len() - 1) * p / 100];
+
+        println!("{} units ({} bytes with drop-ins), {} rounds, {} failed", files, bytes, ROUNDS, failed);
+        println!("{:>12} {:>12} {:>12} {:>12}", "p50", "p99", "units/s", "MB/s");
+        println!(
+            "{:>12.1?} {:>12.1?} {:>12.0} {:>12.1}",
+            percentile(50),
+            percentile(99),
+            (files * ROUNDS) as f64 / elapsed.as_secs_f64(),
+            (bytes * ROUNDS as u64) as f64 / elapsed.as_secs_f64() / 1e6
+        );
+
+        std::fs::remove_dir_all(&dir)
+    }
+}
+
+fn main() {
+    // cargo bench passes `--bench`; a number picks the corpus size.
+    let files = std::env::args().skip(1).find_map(|arg| arg.parse().ok()).unwrap_or(10_000);
+
+    #[cfg(target_os = "linux")]
+    if let Err(err) = parser::run(files) {
+        eprintln!("unit file benchmark failed: {}", err);
+        std::process::exit(1);
+    }
+    #[cfg(not(target_os = "linux"))]
+    let _ = files;
+}
@@ -4,8 +4,55 @@ fn main() {
         let lib_dir = "/usr/lib/x86_64-linux-gnu";
         println!("cargo:rustc-link-search=native={}", lib_dir);
         println!("cargo:rustc-link-lib=dylib=systemd");
+
+        // The C tests, run by tests/native.rs. Only the test targets link them, with
+        // libservice after them for the symbols they use.
+        let out_dir = std::env::var("OUT_DIR").unwrap();
+        cc::Build::new()
+            .file("tests/c/unit_file_test.c")
+            .file("tests/c/integrity_test.c")
+            .include("src")
+            .cargo_metadata(false)
+            .compile("service_tests");
+        println!("cargo:rustc-link-arg-tests={}/libservice_tests.a", out_dir);
+        println!("cargo:rustc-link-arg-tests={}/libservice.a", out_dir);
+        println!("cargo:rustc-link-arg-tests=-lsystemd");
+
+        // The mock systemd behind benches/bus.rs, with the bench feature only. It is
+        // a program of its own, so it is linked here rather than archived; without it
+        // only that bench is lost.
+        if std::env::var_os("CARGO_FEATURE_BENCH").is_some() {
+            let mock = std::path::Path::new(&out_dir).join("mock_systemd");
+            let built = cc::Build::new()
+                .get_compiler()
+                .to_command()
+                .arg("tests/fixtures/mock_systemd.c")
+                .arg("-o")
+                .arg(&mock)
+                .arg(format!("-L{}", lib_dir))
+                .arg("-lsystemd")
+                .status()
+                .map_or(false, |status| status.success());
+            if built {
+                println!("cargo:rustc-env=SERVICE_VIEWER_MOCK_SYSTEMD={}", mock.display());
+            } else {
+                println!("cargo:warning=could not build tests/fixtures/mock_systemd.c, the bus benchmark is disabled");
+            }
+        }
+
         cc::Build::new()
             .file("src/service.c")
+            .file("src/unit_file.c")
+            .file("src/unit_cache.c")
+            .file("src/offline.c")
+            .file("src/watch.c")
+            .file("src/stats.c")
+            .file("src/work_pool.c")
+            .file("src/cgroup.c")
+            .file("src/graph.c")
+            .file("src/journal.c")
+            .file("src/integrity.c")
+            .file("src/util.c")
             .include("/usr/include/systemd")
             .flag("-lsystemd")
             .compile("service");
@@ -18,7 +65,27 @@ fn main() {
     }
 
 
-    println!("cargo:rerun-if-changed=src/service.c"); 
+    println!("cargo:rerun-if-changed=src/service.c");
+    println!("cargo:rerun-if-changed=src/service.cpp");
+    println!("cargo:rerun-if-changed=src/service.h");
+    println!("cargo:rerun-if-changed=src/unit_file.c");
+    println!("cargo:rerun-if-changed=src/unit_file.h");
+    println!("cargo:rerun-if-changed=src/unit_cache.c");
+    println!("cargo:rerun-if-changed=src/unit_cache.h");
+    println!("cargo:rerun-if-changed=src/offline.c");
+    println!("cargo:rerun-if-changed=src/watch.c");
+    println!("cargo:rerun-if-changed=src/stats.c");
+    println!("cargo:rerun-if-changed=src/stats.h");
+    println!("cargo:rerun-if-changed=src/work_pool.c");
+    println!("cargo:rerun-if-changed=src/work_pool.h");
+    println!("cargo:rerun-if-changed=src/cgroup.c");
+    println!("cargo:rerun-if-changed=src/graph.c");
+    println!("cargo:rerun-if-changed=src/journal.c");
+    println!("cargo:rerun-if-changed=src/integrity.c");
+    println!("cargo:rerun-if-changed=src/util.c");
+    println!("cargo:rerun-if-changed=src/util.h");
+    println!("cargo:rerun-if-changed=tests/c");
+    println!("cargo:rerun-if-changed=tests/fixtures");
     println!("cargo:rerun-if-env-changed=CC");
     println!("cargo:rustc-link-lib=static=service");
 
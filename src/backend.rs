@@ -0,0 +1,120 @@
+//! Everything the UI asks of systemd runs on one thread that keeps its own bus
+//! connection, so keys and redraws never wait for a round trip. Requests are tagged
+//! with the generation they were made in; a refresh starts a new one, and whatever
+//! is still queued or streaming for an older one is skipped.
+
+use super::*;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::mpsc::{self, Receiver, Sender};
+use std::sync::Arc;
+use std::thread::JoinHandle;
+
+/// Units per details response; a refresh is noticed between two of them.
+const DETAILS_BATCH: usize = 64;
+
+pub enum Request {
+    /// Lists the selected units again.
+    Reload,
+    /// Details of units by (item index, unit name, object path).
+    Details(Vec<(usize, String, String)>),
+    /// Loads the dependency graph of all units.
+    Graph,
+}
+
+pub enum Response {
+    Items(Vec<StatusItem>),
+    /// One batch of a `Details` request, with the integrity lines already appended.
+    Details(Vec<(usize, String, Option<ServiceEntry>)>),
+    Graph(Option<Graph>),
+}
+
+pub struct Worker {
+    requests: Option<Sender<(u64, Request)>>,
+    responses: Receiver<(u64, Response)>,
+    generation: Arc<AtomicU64>,
+    thread: Option<JoinHandle<()>>,
+}
+
+impl Worker {
+    pub fn start() -> Self {
+        let (requests, queue) = mpsc::channel();
+        let (replies, responses) = mpsc::channel();
+        let generation = Arc::new(AtomicU64::new(0));
+        let current = Arc::clone(&generation);
+        let thread = std::thread::spawn(move || serve(queue, replies, current));
+        Self { requests: Some(requests), responses, generation, thread: Some(thread) }
+    }
+
+    pub fn send(&self, request: Request) {
+        let generation = self.generation.load(Ordering::Relaxed);
+        if let Some(requests) = &self.requests {
+            // The thread only ends when this side hangs up.
+            let _ = requests.send((generation, request));
+        }
+    }
+
+    /// Cancels everything asked so far and lists the units again.
+    pub fn reload(&self) {
+        self.generation.fetch_add(1, Ordering::Relaxed);
+        self.send(Request::Reload);
+    }
+
+    /// Responses that arrived since the last call, without stale ones.
+    pub fn poll(&self) -> Vec<Response> {
+        let generation = self.generation.load(Ordering::Relaxed);
+        self.responses.try_iter().filter(|(tag, _)| *tag == generation).map(|(_, response)| response).collect()
+    }
+}
+
+impl Drop for Worker {
+    /// Waits for the request in progress, so nothing calls into the backends after their cleanup.
+    fn drop(&mut self) {
+        self.requests = None;
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
+fn serve(queue: Receiver<(u64, Request)>, replies: Sender<(u64, Response)>, generation: Arc<AtomicU64>) {
+    let stale = |tag: u64| tag != generation.load(Ordering::Relaxed);
+
+    for (tag, request) in queue {
+        if stale(tag) {
+            continue;
+        }
+        let sent = match request {
+            Request::Reload => replies.send((tag, Response::Items(load_status_items()))).is_ok(),
+            Request::Graph => replies.send((tag, Response::Graph(Graph::load()))).is_ok(),
+            Request::Details(units) => units
+                .chunks(DETAILS_BATCH)
+                .take_while(|_| !stale(tag))
+                .all(|batch| replies.send((tag, Response::Details(load_details(batch)))).is_ok()),
+        };
+        if !sent {
+            break;
+        }
+    }
+
+    unsafe { closeServiceBus() };
+}
+
+fn load_details(batch: &[(usize, String, String)]) -> Vec<(usize, String, Option<ServiceEntry>)> {
+    let names: Vec<&str> = batch.iter().map(|(_, unit_name, _)| unit_name.as_str()).collect();
+    let paths: Vec<&str> = batch.iter().map(|(_, _, object_path)| object_path.as_str()).collect();
+    let mut entries = query_services(&names, Some(&paths));
+
+    // The batch's binaries are hashed together; repeats come from the cache.
+    if integrity::enabled() {
+        let none = integrity::Exec::default();
+        let execs: Vec<&integrity::Exec> = entries.iter().map(|entry| entry.as_ref().map_or(&none, |entry| &entry.exec)).collect();
+        let checks = integrity::check(&execs);
+        for (entry, check) in entries.iter_mut().zip(checks) {
+            if let (Some(entry), Some(check)) = (entry, check) {
+                entry.details.push_str(&check.lines());
+            }
+        }
+    }
+
+    batch.iter().zip(entries).map(|((index, unit_name, _), entry)| (*index, unit_name.clone(), entry)).collect()
+}
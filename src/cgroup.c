@@ -0,0 +1,405 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/vfs.h>
+
+#include "service.h"
+#include "stats.h"
+#include "util.h"
+
+/*
+ * Resource sampling from the unified cgroup hierarchy. The four files of
+ * every sampled cgroup stay open between calls, so a sample is four
+ * pread()s per unit and no path lookups. Cgroups that were not asked for
+ * in a call are closed at its end, which keeps the open set to what the
+ * caller is looking at.
+ */
+#define CGROUP_ROOT "/sys/fs/cgroup"
+#define CGROUP_UNIFIED_ROOT "/sys/fs/cgroup/unified"
+#define CGROUP2_SUPER_MAGIC 0x63677270
+
+/* Descriptors left for everything else when sizing the cache to RLIMIT_NOFILE. */
+#define RESERVED_FDS 256
+
+typedef enum {
+    CGROUP_MEMORY_CURRENT,
+    CGROUP_CPU_STAT,
+    CGROUP_IO_STAT,
+    CGROUP_PIDS_CURRENT,
+    CGROUP_FILE_COUNT,
+} CgroupFile;
+
+static const char *const cgroup_file_names[CGROUP_FILE_COUNT] = {
+    "memory.current",
+    "cpu.stat",
+    "io.stat",
+    "pids.current",
+};
+
+typedef struct {
+    char *path;
+    int fds[CGROUP_FILE_COUNT];   /* -1 where the controller is not enabled */
+    bool used;
+} CgroupEntry;
+
+/* Everything below is protected by sampler_lock. */
+static pthread_mutex_t sampler_lock = PTHREAD_MUTEX_INITIALIZER;
+static int root_fd = -1;
+static bool root_missing;        /* checked once; there is nothing to sample without it */
+static size_t max_entries;
+static CgroupEntry *entries;
+static size_t entry_count;
+static size_t entry_capacity;
+static uint32_t *slots;          /* entry indices, see insertSlot() */
+static size_t slot_count;
+static char read_buffer[65536];  /* io.stat has a line per device */
+
+static bool open_root(void) {
+    const char *roots[] = { CGROUP_ROOT, CGROUP_UNIFIED_ROOT };
+    struct statfs fs;
+
+    for (size_t i = 0; i < sizeof(roots) / sizeof(roots[0]); i++) {
+        if (statfs(roots[i], &fs) == 0 && fs.f_type == CGROUP2_SUPER_MAGIC) {
+            root_fd = open(roots[i], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (root_fd < 0) {
+                fprintf(stderr, "Failed to open %s: %s\n", roots[i], strerror(errno));
+                return false;
+            }
+            break;
+        }
+    }
+    if (root_fd < 0) {
+        fprintf(stderr, "No cgroup v2 hierarchy mounted at %s\n", CGROUP_ROOT);
+        return false;
+    }
+
+    /* Four descriptors per unit easily outgrow the default soft limit of 1024. */
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        if (limit.rlim_cur < limit.rlim_max) {
+            limit.rlim_cur = limit.rlim_max;
+            if (setrlimit(RLIMIT_NOFILE, &limit) != 0) {
+                getrlimit(RLIMIT_NOFILE, &limit);
+            }
+        }
+        if (limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur > 1 << 20) {
+            limit.rlim_cur = 1 << 20;
+        }
+        max_entries = limit.rlim_cur > RESERVED_FDS ? (limit.rlim_cur - RESERVED_FDS) / CGROUP_FILE_COUNT : 0;
+    }
+
+    return true;
+}
+
+static void close_fds(int* fds) {
+    for (size_t i = 0; i < CGROUP_FILE_COUNT; i++) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+            fds[i] = -1;
+        }
+    }
+}
+
+static bool has_open_files(const int* fds) {
+    for (size_t i = 0; i < CGROUP_FILE_COUNT; i++) {
+        if (fds[i] >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Opens the files of the cgroup at `path` (a ControlGroup value such as "/system.slice/foo.service"). */
+static bool open_cgroup(const char* path, int* fds) {
+    for (size_t i = 0; i < CGROUP_FILE_COUNT; i++) {
+        fds[i] = -1;
+    }
+
+    const char *relative = path[1] != '\0' ? path + 1 : ".";
+    int dir_fd = openat(root_fd, relative, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) {
+        return false;
+    }
+
+    for (size_t i = 0; i < CGROUP_FILE_COUNT; i++) {
+        fds[i] = openat(dir_fd, cgroup_file_names[i], O_RDONLY | O_CLOEXEC);
+    }
+    close(dir_fd);
+    return true;
+}
+
+static void insert_slot(size_t index) {
+    insertSlot(slots, slot_count, entries[index].path, (uint32_t)index);
+}
+
+static const char* entry_path(const void* context, uint32_t index) {
+    (void)context;
+    return entries[index].path;
+}
+
+/* Resizes the table for `wanted` entries, at most half full, and reinserts the current ones. */
+static bool rebuild_slots(size_t wanted) {
+    size_t count = 16;
+    while (count < wanted * 2) {
+        count *= 2;
+    }
+
+    if (count != slot_count) {
+        uint32_t *temp = realloc(slots, count * sizeof(uint32_t));
+        if (temp == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return false;
+        }
+        slots = temp;
+        slot_count = count;
+    }
+
+    memset(slots, 0, slot_count * sizeof(uint32_t));
+    for (size_t i = 0; i < entry_count; i++) {
+        insert_slot(i);
+    }
+    return true;
+}
+
+static CgroupEntry* find_entry(const char* path) {
+    uint32_t index;
+    return findSlot(slots, slot_count, path, entry_path, NULL, &index) ? &entries[index] : NULL;
+}
+
+/* Keeps `fds` open under `path`; NULL if the cache is full or out of memory. */
+static CgroupEntry* add_entry(const char* path, const int* fds) {
+    if (entry_count >= max_entries) {
+        return NULL;
+    }
+    if ((entry_count + 1) * 2 > slot_count && !rebuild_slots(entry_count + 1)) {
+        return NULL;
+    }
+
+    if (entry_count == entry_capacity) {
+        size_t capacity = entry_capacity ? entry_capacity * 2 : 64;
+        CgroupEntry *temp = realloc(entries, capacity * sizeof(CgroupEntry));
+        if (temp == NULL) {
+            return NULL;
+        }
+        entries = temp;
+        entry_capacity = capacity;
+    }
+
+    CgroupEntry *entry = &entries[entry_count];
+    entry->path = strdup(path);
+    if (entry->path == NULL) {
+        return NULL;
+    }
+    memcpy(entry->fds, fds, sizeof(entry->fds));
+    entry->used = true;
+    insert_slot(entry_count++);
+
+    return entry;
+}
+
+/* Closes the cgroups that were not sampled since the last call. */
+static void drop_unused_entries(void) {
+    size_t kept = 0;
+
+    for (size_t i = 0; i < entry_count; i++) {
+        if (!entries[i].used) {
+            close_fds(entries[i].fds);
+            free(entries[i].path);
+            continue;
+        }
+        entries[i].used = false;
+        entries[kept++] = entries[i];
+    }
+
+    if (kept != entry_count) {
+        entry_count = kept;
+        /* Shrinking; on failure the old, larger table is still big enough. */
+        if (!rebuild_slots(entry_count)) {
+            memset(slots, 0, slot_count * sizeof(uint32_t));
+            for (size_t i = 0; i < entry_count; i++) {
+                insert_slot(i);
+            }
+        }
+    }
+}
+
+static uint64_t parse_u64(const char* s, const char** end) {
+    uint64_t value = 0;
+    while (*s >= '0' && *s <= '9') {
+        value = value * 10 + (uint64_t)(*s++ - '0');
+    }
+    if (end) {
+        *end = s;
+    }
+    return value;
+}
+
+/* Reads the whole file into read_buffer; -errno on failure. */
+static ssize_t read_cgroup_file(int fd) {
+    ssize_t n = pread(fd, read_buffer, sizeof(read_buffer) - 1, 0);
+    if (n < 0) {
+        return -errno;
+    }
+    read_buffer[n] = '\0';
+    return n;
+}
+
+/* The value of `key` in a flat-keyed file such as cpu.stat. */
+static uint64_t parse_keyed(const char* key) {
+    size_t key_length = strlen(key);
+
+    for (const char *line = read_buffer; *line; ) {
+        if (strncmp(line, key, key_length) == 0 && line[key_length] == ' ') {
+            return parse_u64(line + key_length + 1, NULL);
+        }
+        const char *next = strchr(line, '\n');
+        if (next == NULL) {
+            break;
+        }
+        line = next + 1;
+    }
+
+    return 0;
+}
+
+/* io.stat lines are "MAJ:MIN rbytes=N wbytes=N rios=N ..."; bytes are summed over devices. */
+static void parse_io_stat(CgroupSample* sample) {
+    for (const char *p = read_buffer; (p = strchr(p, '=')) != NULL; p++) {
+        if (p - read_buffer >= 6 && strncmp(p - 6, "rbytes", 6) == 0) {
+            sample->io_read_bytes += parse_u64(p + 1, &p);
+        } else if (p - read_buffer >= 6 && strncmp(p - 6, "wbytes", 6) == 0) {
+            sample->io_write_bytes += parse_u64(p + 1, &p);
+        }
+        if (*p == '\0') {
+            break;
+        }
+    }
+}
+
+/* Fills `sample` from open files; false if the cgroup went away under them. */
+static bool read_cgroup(const int* fds, CgroupSample* sample) {
+    memset(sample, 0, sizeof(*sample));
+
+    for (size_t i = 0; i < CGROUP_FILE_COUNT; i++) {
+        if (fds[i] < 0) {
+            continue;
+        }
+
+        ssize_t r = read_cgroup_file(fds[i]);
+        if (r == -ENODEV || r == -ENOENT) {
+            return false;
+        }
+        if (r < 0) {
+            continue;
+        }
+
+        switch ((CgroupFile)i) {
+            case CGROUP_MEMORY_CURRENT:
+                sample->memory_current = parse_u64(read_buffer, NULL);
+                break;
+            case CGROUP_CPU_STAT:
+                sample->cpu_usage_usec = parse_keyed("usage_usec");
+                break;
+            case CGROUP_IO_STAT:
+                parse_io_stat(sample);
+                break;
+            case CGROUP_PIDS_CURRENT:
+                sample->pids_current = parse_u64(read_buffer, NULL);
+                break;
+            case CGROUP_FILE_COUNT:
+                break;
+        }
+    }
+
+    sample->valid = true;
+    return true;
+}
+
+static void sample_cgroup(const char* path, CgroupSample* sample) {
+    int fds[CGROUP_FILE_COUNT];
+
+    memset(sample, 0, sizeof(*sample));
+    if (path == NULL || path[0] != '/') {
+        return;
+    }
+
+    CgroupEntry *entry = find_entry(path);
+    if (entry != NULL) {
+        entry->used = true;
+        if (has_open_files(entry->fds) && read_cgroup(entry->fds, sample)) {
+            return;
+        }
+        /* Removed, and maybe recreated by a restart: the old files only say ENODEV. */
+        close_fds(entry->fds);
+        if (open_cgroup(path, entry->fds)) {
+            read_cgroup(entry->fds, sample);
+        }
+        return;
+    }
+
+    if (!open_cgroup(path, fds)) {
+        return;
+    }
+    read_cgroup(fds, sample);
+
+    /* Past the descriptor budget, cgroups are read without being kept open. */
+    if (add_entry(path, fds) == NULL) {
+        close_fds(fds);
+    }
+}
+
+static bool sample_cgroups(const char* const* control_groups, size_t count, CgroupSample* samples) {
+    pthread_mutex_lock(&sampler_lock);
+
+    if (root_missing || (root_fd < 0 && !open_root())) {
+        root_missing = true;
+        pthread_mutex_unlock(&sampler_lock);
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        sample_cgroup(control_groups[i], &samples[i]);
+    }
+    drop_unused_entries();
+
+    pthread_mutex_unlock(&sampler_lock);
+    return true;
+}
+
+bool sampleCgroups(const char* const* control_groups, size_t count, CgroupSample* samples) {
+    uint64_t start = statsNow();
+    bool success = sample_cgroups(control_groups, count, samples);
+    statsRecord(STAT_SAMPLE_CGROUPS, start, !success);
+    return success;
+}
+
+void closeCgroupSampler(void) {
+    pthread_mutex_lock(&sampler_lock);
+
+    for (size_t i = 0; i < entry_count; i++) {
+        close_fds(entries[i].fds);
+        free(entries[i].path);
+    }
+    free(entries);
+    free(slots);
+    entries = NULL;
+    slots = NULL;
+    entry_count = 0;
+    entry_capacity = 0;
+    slot_count = 0;
+
+    if (root_fd >= 0) {
+        close(root_fd);
+        root_fd = -1;
+    }
+    root_missing = false;
+
+    pthread_mutex_unlock(&sampler_lock);
+}
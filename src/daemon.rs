@@ -0,0 +1,290 @@
+//! `--serve PATH`: keeps a snapshot of the selected units up to date from the watch
+//! and serves it on a Unix socket, as Prometheus text on `/metrics` and JSON on `/json`.
+//! Both responses are rendered when the snapshot changes, not per scrape, so a scrape
+//! is one write of a shared buffer and never touches the bus. While the watch is
+//! reconnecting the snapshot may be stale: `/metrics` says so in
+//! `service_viewer_watch_up`, `/json` answers 503, and the snapshot is reloaded once
+//! the watch is back.
+
+use super::*;
+use std::collections::BTreeMap;
+use std::io::Read;
+use std::os::unix::fs::FileTypeExt;
+use std::os::unix::net::{UnixListener, UnixStream};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Arc, RwLock};
+
+/// How often queued watch events are folded into the snapshot.
+const UPDATE_INTERVAL: Duration = Duration::from_millis(100);
+/// Threads blocked in accept(); a scrape is short enough that a few suffice.
+const ACCEPT_THREADS: usize = 4;
+const REQUEST_TIMEOUT: Duration = Duration::from_secs(1);
+
+static STOP: AtomicBool = AtomicBool::new(false);
+
+extern "C" fn request_stop(_: c_int) {
+    STOP.store(true, Ordering::Relaxed);
+}
+
+/// What the responses need of one unit, copied out of its details.
+struct UnitSnapshot {
+    /// The unit's `--export jsonl` record, without the newline.
+    json: Vec<u8>,
+    active_state: String,
+    sub_state: String,
+    running: bool,
+    memory: u64,
+    cpu_nsec: u64,
+    restarts: u32,
+}
+
+impl UnitSnapshot {
+    fn new(unit_name: &str, description: &str, active_state: &str, running: bool, details: Option<&ServiceDetails>) -> Self {
+        let mut json = Vec::new();
+        // Writing to a Vec cannot fail.
+        let _ = export::write_record(&mut json, ExportFormat::JsonLines, &export::COLUMNS, &export::record(unit_name, description, active_state, running, details));
+        json.pop();
+
+        match details {
+            Some(d) => UnitSnapshot {
+                json,
+                active_state: d.str(d.active_state).into_owned(),
+                sub_state: d.str(d.sub_state).into_owned(),
+                running,
+                memory: d.memory_current,
+                cpu_nsec: d.cpu_usage_nsec,
+                restarts: d.restart_count,
+            },
+            None => UnitSnapshot {
+                json,
+                active_state: active_state.to_string(),
+                sub_state: String::new(),
+                running,
+                memory: u64::MAX,
+                cpu_nsec: u64::MAX,
+                restarts: 0,
+            },
+        }
+    }
+}
+
+/// Complete HTTP responses, swapped as a whole when the snapshot changes.
+struct Responses {
+    metrics: Arc<Vec<u8>>,
+    json: Arc<Vec<u8>>,
+}
+
+fn response(status: &str, content_type: &str, body: &[u8]) -> Arc<Vec<u8>> {
+    let mut response = format!(
+        "HTTP/1.0 {}\r\nContent-Type: {}\r\nContent-Length: {}\r\nConnection: close\r\n\r\n",
+        status,
+        content_type,
+        body.len()
+    )
+    .into_bytes();
+    response.extend_from_slice(body);
+    Arc::new(response)
+}
+
+/// Escapes a Prometheus label value.
+fn label(value: &str) -> Cow<'_, str> {
+    if !value.contains(|c| matches!(c, '\\' | '"' | '\n')) {
+        return Cow::Borrowed(value);
+    }
+    Cow::Owned(value.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n"))
+}
+
+/// `watch_up` is None when nothing is watched, e.g. below `--root`.
+fn render(units: &BTreeMap<String, UnitSnapshot>, watch_up: Option<bool>) -> Responses {
+    use std::fmt::Write as _;
+
+    let mut text = String::with_capacity(units.len() * 256);
+    if let Some(up) = watch_up {
+        let _ = writeln!(text, "# HELP service_viewer_watch_up Whether live updates are arriving; 0 while the snapshot may be stale.\n# TYPE service_viewer_watch_up gauge\nservice_viewer_watch_up {}", u8::from(up));
+    }
+    let _ = writeln!(text, "# HELP service_viewer_units Units in the snapshot.\n# TYPE service_viewer_units gauge\nservice_viewer_units {}", units.len());
+
+    let _ = writeln!(text, "# HELP service_viewer_unit_active Whether the unit is active, labelled with its states.\n# TYPE service_viewer_unit_active gauge");
+    for (name, unit) in units {
+        let _ = writeln!(
+            text,
+            "service_viewer_unit_active{{unit=\"{}\",active_state=\"{}\",sub_state=\"{}\"}} {}",
+            label(name),
+            label(&unit.active_state),
+            label(&unit.sub_state),
+            u8::from(unit.running)
+        );
+    }
+
+    let _ = writeln!(text, "# HELP service_viewer_unit_memory_bytes Memory charged to the unit.\n# TYPE service_viewer_unit_memory_bytes gauge");
+    for (name, unit) in units.iter().filter(|(_, unit)| unit.memory != u64::MAX) {
+        let _ = writeln!(text, "service_viewer_unit_memory_bytes{{unit=\"{}\"}} {}", label(name), unit.memory);
+    }
+
+    let _ = writeln!(text, "# HELP service_viewer_unit_cpu_seconds_total CPU time used by the unit.\n# TYPE service_viewer_unit_cpu_seconds_total counter");
+    for (name, unit) in units.iter().filter(|(_, unit)| unit.cpu_nsec != u64::MAX) {
+        let _ = writeln!(text, "service_viewer_unit_cpu_seconds_total{{unit=\"{}\"}} {}", label(name), unit.cpu_nsec as f64 / 1e9);
+    }
+
+    let _ = writeln!(text, "# HELP service_viewer_unit_restarts_total Automatic restarts of the unit.\n# TYPE service_viewer_unit_restarts_total counter");
+    for (name, unit) in units {
+        let _ = writeln!(text, "service_viewer_unit_restarts_total{{unit=\"{}\"}} {}", label(name), unit.restarts);
+    }
+
+    let mut json = Vec::with_capacity(units.values().map(|unit| unit.json.len() + 1).sum::<usize>() + 16);
+    json.extend_from_slice(b"{\"units\":[");
+    for (i, unit) in units.values().enumerate() {
+        if i > 0 {
+            json.push(b',');
+        }
+        json.extend_from_slice(&unit.json);
+    }
+    json.extend_from_slice(b"]}\n");
+
+    Responses {
+        metrics: response("200 OK", "text/plain; version=0.0.4", text.as_bytes()),
+        json: match watch_up {
+            Some(false) => response("503 Service Unavailable", "application/json", b"{\"error\":\"service watch disconnected\"}\n"),
+            _ => response("200 OK", "application/json", &json),
+        },
+    }
+}
+
+/// Reads one request and answers it from the current responses.
+fn serve(mut stream: UnixStream, responses: &RwLock<Responses>) -> io::Result<()> {
+    stream.set_read_timeout(Some(REQUEST_TIMEOUT))?;
+    stream.set_write_timeout(Some(REQUEST_TIMEOUT))?;
+
+    // Only the request line matters; headers are not waited for once it is in.
+    let mut request = [0u8; 1024];
+    let mut length = 0;
+    while !request[..length].contains(&b'\n') && length < request.len() {
+        match stream.read(&mut request[length..])? {
+            0 => break,
+            n => length += n,
+        }
+    }
+
+    let line = request[..length].split(|&b| b == b'\n').next().unwrap_or_default();
+    let path = line.split(|&b| b == b' ').nth(1).unwrap_or_default();
+    let body = match path {
+        b"/" | b"/metrics" => responses.read().unwrap().metrics.clone(),
+        b"/json" => responses.read().unwrap().json.clone(),
+        _ => return stream.write_all(b"HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"),
+    };
+    stream.write_all(&body)
+}
+
+/// Loads every selected unit in batches, like `--export`.
+fn load_snapshot(query: &ServiceQuery) -> BTreeMap<String, UnitSnapshot> {
+    let states: Vec<&str> = query.states.iter().map(String::as_str).collect();
+    let units = list_service_units(&query.unit_patterns(), &states);
+
+    let mut snapshot = BTreeMap::new();
+    for chunk in units.chunks(256) {
+        let names: Vec<&str> = chunk.iter().map(|unit| unit.name.as_str()).collect();
+        let paths: Vec<&str> = chunk.iter().map(|unit| unit.object_path.as_str()).collect();
+        query_services_with(&names, Some(&paths), |i, running, details| {
+            let unit = &chunk[i];
+            snapshot.insert(unit.name.clone(), UnitSnapshot::new(&unit.name, &unit.description, &unit.active_state, running, details));
+        });
+    }
+    snapshot
+}
+
+/// Folds queued watch events into the snapshot; returns whether anything changed.
+/// After the watch reconnected, updates may have been missed, so everything is reloaded.
+fn apply_events(snapshot: &mut BTreeMap<String, UnitSnapshot>, query: &ServiceQuery) -> bool {
+    let mut changed = false;
+    let mut resync = false;
+
+    loop {
+        let mut events: Vec<ServiceEvent> = Vec::with_capacity(SERVICE_EVENT_BATCH);
+        let count = unsafe { pollServiceEvents(events.as_mut_ptr(), SERVICE_EVENT_BATCH) };
+        unsafe { events.set_len(count) };
+
+        for event in &events {
+            if event.kind == SERVICE_EVENT_RESYNC {
+                resync = true;
+                continue;
+            }
+            let name = c_char_to_string(event.name);
+            if event.kind == SERVICE_EVENT_REMOVED {
+                changed |= snapshot.remove(&name).is_some();
+            } else if let Some(d) = unsafe { event.details.as_ref() } {
+                let active_state = d.str(d.active_state);
+                // Units that leave the filtered states leave the snapshot.
+                if query.matches_states(&d.str(d.load_state), &active_state, &d.str(d.sub_state)) {
+                    let unit = UnitSnapshot::new(&name, &d.str(d.description), &active_state, event.running, Some(d));
+                    snapshot.insert(name, unit);
+                    changed = true;
+                } else {
+                    changed |= snapshot.remove(&name).is_some();
+                }
+            }
+        }
+
+        unsafe { freeServiceEvents(events.as_mut_ptr(), count) };
+
+        if count < SERVICE_EVENT_BATCH {
+            break;
+        }
+    }
+
+    if resync {
+        *snapshot = load_snapshot(query);
+        changed = true;
+    }
+    changed
+}
+
+pub fn run(path: &str) -> io::Result<()> {
+    // A socket left behind by an earlier run is replaced; anything else is not ours to remove.
+    if let Ok(metadata) = std::fs::symlink_metadata(path) {
+        if !metadata.file_type().is_socket() {
+            return Err(io::Error::new(io::ErrorKind::AlreadyExists, format!("{} exists and is not a socket", path)));
+        }
+        std::fs::remove_file(path)?;
+    }
+    let listener = UnixListener::bind(path)?;
+
+    unsafe {
+        libc::signal(libc::SIGINT, request_stop as libc::sighandler_t);
+        libc::signal(libc::SIGTERM, request_stop as libc::sighandler_t);
+    }
+
+    // Watching first means nothing that changes during the initial load is missed.
+    start_service_watch();
+    let watching = OPTIONS.lock().unwrap().root.is_none();
+    let watch_up = || watching.then(|| unsafe { isServiceWatchConnected() });
+    let query = SERVICES.lock().unwrap();
+    let mut snapshot = load_snapshot(&query);
+    apply_events(&mut snapshot, &query);
+
+    let mut up = watch_up();
+    let responses = Arc::new(RwLock::new(render(&snapshot, up)));
+    eprintln!("serving {} units on {}", snapshot.len(), path);
+
+    for _ in 0..ACCEPT_THREADS {
+        let listener = listener.try_clone()?;
+        let responses = Arc::clone(&responses);
+        std::thread::spawn(move || {
+            for stream in listener.incoming().flatten() {
+                let _ = serve(stream, &responses);
+            }
+        });
+    }
+
+    while !STOP.load(Ordering::Relaxed) {
+        std::thread::sleep(UPDATE_INTERVAL);
+        let changed = apply_events(&mut snapshot, &query);
+        let now_up = watch_up();
+        if changed || now_up != up {
+            up = now_up;
+            let rendered = render(&snapshot, up);
+            *responses.write().unwrap() = rendered;
+        }
+    }
+
+    std::fs::remove_file(path)
+}
@@ -0,0 +1,236 @@
+//! `--export jsonl|csv`: one record per unit on stdout, written as each batch of details
+//! arrives. Details are read straight out of the native results, so memory does not grow
+//! with the number of units beyond the listing itself.
+
+use super::*;
+use std::io::BufWriter;
+
+/// Units whose details are fetched, written and released together.
+const EXPORT_CHUNK: usize = 256;
+
+pub const COLUMNS: [&str; 14] = [
+    "unit", "description", "active_state", "sub_state", "running", "type", "exec_start", "user",
+    "main_pid", "restarts", "memory_bytes", "cpu_nsec", "active_enter_usec", "control_group",
+];
+
+pub enum Value<'a> {
+    Str(Cow<'a, str>),
+    Bool(bool),
+    U64(u64),
+    /// A counter systemd reports as unset (UINT64_MAX).
+    Null,
+}
+
+fn counter<'a>(value: u64) -> Value<'a> {
+    if value == u64::MAX { Value::Null } else { Value::U64(value) }
+}
+
+/// A record in `COLUMNS` order; the listing fills in what failed details lack.
+pub fn record<'a>(unit_name: &'a str, description: &'a str, active_state: &'a str, running: bool, details: Option<&'a ServiceDetails>) -> [Value<'a>; 14] {
+    let str = |value: Cow<'a, str>| Value::Str(value);
+    match details {
+        Some(d) => [
+            str(Cow::Borrowed(unit_name)),
+            str(d.str(d.description)),
+            str(d.str(d.active_state)),
+            str(d.str(d.sub_state)),
+            Value::Bool(running),
+            str(d.str(d.service_type)),
+            str(d.str(d.executable_path)),
+            str(d.str(d.service_account)),
+            Value::U64(d.main_pid as u64),
+            Value::U64(d.restart_count as u64),
+            counter(d.memory_current),
+            counter(d.cpu_usage_nsec),
+            counter(d.active_enter_timestamp),
+            str(d.str(d.control_group)),
+        ],
+        None => [
+            str(Cow::Borrowed(unit_name)),
+            str(Cow::Borrowed(description)),
+            str(Cow::Borrowed(active_state)),
+            Value::Null,
+            Value::Bool(running),
+            Value::Null,
+            Value::Null,
+            Value::Null,
+            Value::Null,
+            Value::Null,
+            Value::Null,
+            Value::Null,
+            Value::Null,
+            Value::Null,
+        ],
+    }
+}
+
+fn write_json_string(out: &mut impl Write, value: &str) -> io::Result<()> {
+    out.write_all(b"\"")?;
+    let mut start = 0;
+    for (i, c) in value.char_indices() {
+        let escape = match c {
+            '"' => "\\\"",
+            '\\' => "\\\\",
+            '\n' => "\\n",
+            '\r' => "\\r",
+            '\t' => "\\t",
+            c if (c as u32) < 0x20 => "",
+            _ => continue,
+        };
+        out.write_all(value[start..i].as_bytes())?;
+        if escape.is_empty() {
+            write!(out, "\\u{:04x}", c as u32)?;
+        } else {
+            out.write_all(escape.as_bytes())?;
+        }
+        start = i + c.len_utf8();
+    }
+    out.write_all(value[start..].as_bytes())?;
+    out.write_all(b"\"")
+}
+
+fn write_csv_field(out: &mut impl Write, value: &str) -> io::Result<()> {
+    if !value.contains(|c| matches!(c, ',' | '"' | '\n' | '\r')) {
+        return out.write_all(value.as_bytes());
+    }
+    out.write_all(b"\"")?;
+    for (i, part) in value.split('"').enumerate() {
+        if i > 0 {
+            out.write_all(b"\"\"")?;
+        }
+        out.write_all(part.as_bytes())?;
+    }
+    out.write_all(b"\"")
+}
+
+pub fn write_record(out: &mut impl Write, format: ExportFormat, columns: &[&str], values: &[Value]) -> io::Result<()> {
+    match format {
+        ExportFormat::JsonLines => {
+            out.write_all(b"{")?;
+            for (i, (column, value)) in columns.iter().zip(values).enumerate() {
+                if i > 0 {
+                    out.write_all(b",")?;
+                }
+                write!(out, "\"{}\":", column)?;
+                match value {
+                    Value::Str(s) => write_json_string(out, s)?,
+                    Value::Bool(b) => write!(out, "{}", b)?,
+                    Value::U64(n) => write!(out, "{}", n)?,
+                    Value::Null => out.write_all(b"null")?,
+                }
+            }
+            out.write_all(b"}\n")
+        }
+        ExportFormat::Csv => {
+            for (i, value) in values.iter().enumerate() {
+                if i > 0 {
+                    out.write_all(b",")?;
+                }
+                match value {
+                    Value::Str(s) => write_csv_field(out, s)?,
+                    Value::Bool(b) => write!(out, "{}", b)?,
+                    Value::U64(n) => write!(out, "{}", n)?,
+                    Value::Null => {}
+                }
+            }
+            out.write_all(b"\n")
+        }
+    }
+}
+
+fn into_owned(values: [Value<'_>; 14]) -> [Value<'static>; 14] {
+    values.map(|value| match value {
+        Value::Str(s) => Value::Str(Cow::Owned(s.into_owned())),
+        Value::Bool(b) => Value::Bool(b),
+        Value::U64(n) => Value::U64(n),
+        Value::Null => Value::Null,
+    })
+}
+
+/// Hashes the binaries of a batch of records in one call and writes them with the integrity columns.
+fn write_checked(out: &mut impl Write, format: ExportFormat, columns: &[&str], rows: Vec<([Value<'static>; 14], integrity::Exec)>) -> io::Result<()> {
+    let execs: Vec<&integrity::Exec> = rows.iter().map(|(_, exec)| exec).collect();
+    let checks = integrity::check(&execs);
+    for ((values, _), check) in rows.into_iter().zip(checks) {
+        let mut values = Vec::from(values);
+        values.extend(integrity::values(check.as_ref()));
+        write_record(out, format, columns, &values)?;
+    }
+    Ok(())
+}
+
+pub fn run(format: ExportFormat, root: Option<&str>) -> io::Result<()> {
+    let stdout = io::stdout();
+    let mut out = BufWriter::new(stdout.lock());
+
+    // With --integrity, records wait for their batch's digests instead of streaming one by one.
+    let checked = integrity::enabled();
+    let mut columns: Vec<&str> = COLUMNS.to_vec();
+    if checked {
+        columns.extend(integrity::COLUMNS);
+    }
+
+    if format == ExportFormat::Csv {
+        writeln!(out, "{}", columns.join(","))?;
+    }
+
+    let query = SERVICES.lock().unwrap();
+
+    if let Some(root) = root {
+        // Units arrive in batches as they are parsed; each EXPORT_CHUNK of records is
+        // written, hashed with --integrity, and flushed before the next is held.
+        let patterns: Vec<String> = query.unit_patterns().iter().map(|p| p.to_string()).collect();
+        let mut result = Ok(());
+        let mut rows = Vec::new();
+        let mut written = 0;
+        query_offline_services_with(root, &patterns, |details| {
+            if result.is_err() {
+                return;
+            }
+            let unit_name = details.str(details.service_name);
+            let values = record(&unit_name, "", "", false, Some(details));
+            if checked {
+                rows.push((into_owned(values), integrity::Exec::of(details)));
+                if rows.len() == EXPORT_CHUNK {
+                    result = write_checked(&mut out, format, &columns, std::mem::take(&mut rows)).and_then(|_| out.flush());
+                }
+            } else {
+                written += 1;
+                result = write_record(&mut out, format, &columns, &values);
+                if result.is_ok() && written % EXPORT_CHUNK == 0 {
+                    result = out.flush();
+                }
+            }
+        });
+        result?;
+        write_checked(&mut out, format, &columns, rows)?;
+        return out.flush();
+    }
+
+    let states: Vec<&str> = query.states.iter().map(String::as_str).collect();
+    let units = list_service_units(&query.unit_patterns(), &states);
+    drop(query);
+
+    for chunk in units.chunks(EXPORT_CHUNK) {
+        let names: Vec<&str> = chunk.iter().map(|unit| unit.name.as_str()).collect();
+        let paths: Vec<&str> = chunk.iter().map(|unit| unit.object_path.as_str()).collect();
+
+        let mut result = Ok(());
+        let mut rows = Vec::new();
+        query_services_with(&names, Some(&paths), |i, running, details| {
+            let unit = &chunk[i];
+            let values = record(&unit.name, &unit.description, &unit.active_state, running, details);
+            if checked {
+                rows.push((into_owned(values), details.map_or_else(integrity::Exec::default, integrity::Exec::of)));
+            } else if result.is_ok() {
+                result = write_record(&mut out, format, &columns, &values);
+            }
+        });
+        result?;
+        write_checked(&mut out, format, &columns, rows)?;
+        // Consumers see each batch as soon as it is complete.
+        out.flush()?;
+    }
+
+    out.flush()
+}
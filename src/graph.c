@@ -0,0 +1,699 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <systemd/sd-bus.h>
+
+#include "service.h"
+#include "stats.h"
+#include "util.h"
+
+/*
+ * Dependency graph of all loaded units. Unit names are interned into dense
+ * ids once; each dependency kind is then a CSR adjacency: offsets[id] ..
+ * offsets[id + 1] index the ids in edges[]. Queries are plain walks over
+ * those arrays and never touch the bus.
+ */
+#define DESTINATION "org.freedesktop.systemd1"
+#define UNIT_INTERFACE "org.freedesktop.systemd1.Unit"
+#define GRAPH_MAX_IN_FLIGHT 64
+
+typedef enum {
+    EDGE_REQUIRES,
+    EDGE_WANTS,
+    EDGE_BINDS_TO,
+    EDGE_AFTER,
+    EDGE_BEFORE,
+    EDGE_LOADED_KINDS,
+    /* Derived: the reverse of Requires= and BindsTo=, i.e. what stops with a unit. */
+    EDGE_STOPPED_BY = EDGE_LOADED_KINDS,
+    EDGE_KINDS,
+} EdgeKind;
+
+static const char *const edge_properties[EDGE_LOADED_KINDS] = {
+    "Requires",
+    "Wants",
+    "BindsTo",
+    "After",
+    "Before",
+};
+
+typedef struct {
+    uint32_t from;
+    uint32_t to;
+    EdgeKind kind;
+} PendingEdge;
+
+struct ServiceGraph {
+    /* Interned names: name_offsets[id] into the NUL-separated `names`. */
+    char *names;
+    size_t names_size;
+    size_t names_capacity;
+    uint32_t *name_offsets;
+    size_t unit_count;
+    size_t unit_capacity;
+    uint32_t *slots;          /* open addressing, id + 1, 0 is empty */
+    size_t slot_count;
+
+    /* Per id; 0 for units that never (de)activated or were not loaded. */
+    uint64_t *activating_usec;
+    uint64_t *active_usec;
+    uint64_t userspace_usec;
+
+    uint32_t *offsets[EDGE_KINDS];   /* unit_count + 1 each */
+    uint32_t *edges[EDGE_KINDS];
+};
+
+static const char* unit_name(const ServiceGraph* graph, uint32_t id) {
+    return graph->names + graph->name_offsets[id];
+}
+
+static const char* slot_name(const void* context, uint32_t id) {
+    return unit_name(context, id);
+}
+
+static bool lookup_unit(const ServiceGraph* graph, const char* name, uint32_t* id) {
+    return findSlot(graph->slots, graph->slot_count, name, slot_name, graph, id);
+}
+
+static void insert_slot(ServiceGraph* graph, uint32_t id) {
+    insertSlot(graph->slots, graph->slot_count, unit_name(graph, id), id);
+}
+
+/* The id of `name`, adding it if new; false only when out of memory. */
+static bool intern_unit(ServiceGraph* graph, const char* name, uint32_t* id) {
+    if (lookup_unit(graph, name, id)) {
+        return true;
+    }
+
+    size_t length = strlen(name) + 1;
+    if (graph->names_size + length > graph->names_capacity) {
+        size_t capacity = graph->names_capacity ? graph->names_capacity * 2 : 16384;
+        while (capacity < graph->names_size + length) {
+            capacity *= 2;
+        }
+        char *temp = realloc(graph->names, capacity);
+        if (temp == NULL) {
+            return false;
+        }
+        graph->names = temp;
+        graph->names_capacity = capacity;
+    }
+
+    if (graph->unit_count == graph->unit_capacity) {
+        size_t capacity = graph->unit_capacity ? graph->unit_capacity * 2 : 512;
+        uint32_t *offsets = realloc(graph->name_offsets, capacity * sizeof(uint32_t));
+        if (offsets == NULL) {
+            return false;
+        }
+        graph->name_offsets = offsets;
+        graph->unit_capacity = capacity;
+    }
+
+    /* Kept at most half full. */
+    if ((graph->unit_count + 1) * 2 > graph->slot_count) {
+        size_t slot_count = graph->slot_count ? graph->slot_count * 2 : 1024;
+        uint32_t *slots = calloc(slot_count, sizeof(uint32_t));
+        if (slots == NULL) {
+            return false;
+        }
+        free(graph->slots);
+        graph->slots = slots;
+        graph->slot_count = slot_count;
+        for (uint32_t i = 0; i < graph->unit_count; i++) {
+            insert_slot(graph, i);
+        }
+    }
+
+    *id = (uint32_t)graph->unit_count++;
+    graph->name_offsets[*id] = (uint32_t)graph->names_size;
+    memcpy(graph->names + graph->names_size, name, length);
+    graph->names_size += length;
+    insert_slot(graph, *id);
+    return true;
+}
+
+/* State of one load: the units' object paths and the edges found so far. */
+typedef struct GraphLoad GraphLoad;
+
+typedef struct {
+    GraphLoad *load;
+    uint32_t id;
+    sd_bus_slot *slot;
+    uint64_t sent;
+} LoadUnit;
+
+struct GraphLoad {
+    ServiceGraph *graph;
+    sd_bus *bus;
+    char **paths;             /* per listed unit, parallel to the first ids */
+    LoadUnit *units;
+    size_t listed;
+    size_t next;
+    size_t in_flight;
+    PendingEdge *edges;
+    size_t edge_count;
+    size_t edge_capacity;
+    int error;
+};
+
+static int add_edge(GraphLoad* load, uint32_t from, const char* to_name, EdgeKind kind) {
+    uint32_t to;
+
+    if (!intern_unit(load->graph, to_name, &to)) {
+        return -ENOMEM;
+    }
+
+    if (load->edge_count == load->edge_capacity) {
+        size_t capacity = load->edge_capacity ? load->edge_capacity * 2 : 4096;
+        PendingEdge *temp = realloc(load->edges, capacity * sizeof(PendingEdge));
+        if (temp == NULL) {
+            return -ENOMEM;
+        }
+        load->edges = temp;
+        load->edge_capacity = capacity;
+    }
+
+    load->edges[load->edge_count++] = (PendingEdge){ .from = from, .to = to, .kind = kind };
+    return 0;
+}
+
+static int read_dependencies(GraphLoad* load, uint32_t id, sd_bus_message* msg, EdgeKind kind) {
+    const char *name;
+    int r;
+
+    r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_VARIANT, "as");
+    if (r < 0) {
+        return r;
+    }
+    r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_ARRAY, "s");
+    if (r < 0) {
+        return r;
+    }
+
+    while ((r = sd_bus_message_read_basic(msg, SD_BUS_TYPE_STRING, &name)) > 0) {
+        r = add_edge(load, id, name, kind);
+        if (r < 0) {
+            return r;
+        }
+    }
+    if (r < 0) {
+        return r;
+    }
+
+    r = sd_bus_message_exit_container(msg);
+    if (r < 0) {
+        return r;
+    }
+    return sd_bus_message_exit_container(msg);
+}
+
+static int read_timestamp(sd_bus_message* msg, uint64_t* value) {
+    const char *contents;
+    int r;
+
+    r = sd_bus_message_peek_type(msg, NULL, &contents);
+    if (r < 0) {
+        return r;
+    }
+    if (strcmp(contents, "t") != 0) {
+        return sd_bus_message_skip(msg, "v");
+    }
+    return sd_bus_message_read(msg, "v", "t", value);
+}
+
+/* Picks the dependency lists and activation times out of a Unit GetAll reply. */
+static int read_unit_reply(GraphLoad* load, uint32_t id, sd_bus_message* reply) {
+    ServiceGraph *graph = load->graph;
+    const char *property;
+    int r;
+
+    r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "{sv}");
+    if (r < 0) {
+        return r;
+    }
+
+    while ((r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_DICT_ENTRY, "sv")) > 0) {
+        r = sd_bus_message_read_basic(reply, SD_BUS_TYPE_STRING, &property);
+        if (r < 0) {
+            return r;
+        }
+
+        int kind = -1;
+        for (int i = 0; i < EDGE_LOADED_KINDS; i++) {
+            if (strcmp(property, edge_properties[i]) == 0) {
+                kind = i;
+                break;
+            }
+        }
+
+        if (kind >= 0) {
+            r = read_dependencies(load, id, reply, (EdgeKind)kind);
+        } else if (strcmp(property, "InactiveExitTimestampMonotonic") == 0) {
+            r = read_timestamp(reply, &graph->activating_usec[id]);
+        } else if (strcmp(property, "ActiveEnterTimestampMonotonic") == 0) {
+            r = read_timestamp(reply, &graph->active_usec[id]);
+        } else {
+            r = sd_bus_message_skip(reply, "v");
+        }
+        if (r < 0) {
+            return r;
+        }
+
+        r = sd_bus_message_exit_container(reply);
+        if (r < 0) {
+            return r;
+        }
+    }
+    if (r < 0) {
+        return r;
+    }
+
+    return sd_bus_message_exit_container(reply);
+}
+
+static int on_unit_reply(sd_bus_message* reply, void* userdata, sd_bus_error* ret_error) {
+    (void)ret_error;
+    LoadUnit *unit = userdata;
+    GraphLoad *load = unit->load;
+    int r;
+
+    load->in_flight--;
+    statsRecord(STAT_BUS_GET_ALL, unit->sent, sd_bus_message_is_method_error(reply, NULL));
+
+    /* A unit unloaded since the listing just has no outgoing edges. */
+    if (sd_bus_message_is_method_error(reply, NULL)) {
+        return 0;
+    }
+
+    r = read_unit_reply(load, unit->id, reply);
+    if (r == -ENOMEM) {
+        load->error = r;
+    } else if (r < 0) {
+        fprintf(stderr, "Failed to read dependencies of %s: %s\n", unit_name(load->graph, unit->id), strerror(-r));
+    }
+    return 0;
+}
+
+static int issue_get_all(GraphLoad* load) {
+    LoadUnit *unit = &load->units[load->next];
+    int r;
+
+    unit->load = load;
+    unit->id = (uint32_t)load->next;
+    load->next++;
+
+    unit->sent = statsNow();
+    r = sd_bus_call_method_async(load->bus, &unit->slot, DESTINATION, load->paths[unit->id],
+        "org.freedesktop.DBus.Properties", "GetAll", on_unit_reply, unit, "s", UNIT_INTERFACE);
+    if (r < 0) {
+        return r;
+    }
+
+    load->in_flight++;
+    return 0;
+}
+
+/* Interns every listed unit, so that ids 0 .. listed - 1 are the loaded units. */
+static int list_units(GraphLoad* load) {
+    sd_bus_message *reply = NULL;
+    sd_bus_error error = SD_BUS_ERROR_NULL;
+    const char *name, *object_path;
+    size_t capacity = 0;
+    int r;
+
+    uint64_t start = statsNow();
+    r = sd_bus_call_method(load->bus, DESTINATION, "/org/freedesktop/systemd1", "org.freedesktop.systemd1.Manager",
+                           "ListUnits", &error, &reply, "");
+    statsRecord(STAT_BUS_LIST_UNITS, start, r < 0);
+    if (r < 0) {
+        fprintf(stderr, "Failed to list units: %s\n", error.message ? error.message : strerror(-r));
+        sd_bus_error_free(&error);
+        return r;
+    }
+
+    r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(ssssssouso)");
+    while (r >= 0 && (r = sd_bus_message_read(reply, "(ssssssouso)", &name, NULL, NULL, NULL, NULL, NULL,
+                                              &object_path, NULL, NULL, NULL)) > 0) {
+        uint32_t id;
+
+        if (load->listed == capacity) {
+            capacity = capacity ? capacity * 2 : 512;
+            char **temp = realloc(load->paths, capacity * sizeof(char*));
+            if (temp == NULL) {
+                r = -ENOMEM;
+                break;
+            }
+            load->paths = temp;
+        }
+        /* ListUnits has no duplicates, so each name gets the next id. */
+        if (!intern_unit(load->graph, name, &id) || (load->paths[id] = strdup(object_path)) == NULL) {
+            r = -ENOMEM;
+            break;
+        }
+        load->listed++;
+    }
+
+    sd_bus_message_unref(reply);
+    if (r < 0) {
+        fprintf(stderr, "Failed to read unit list: %s\n", strerror(-r));
+    }
+    return r;
+}
+
+/* Pipelines a Unit GetAll for every listed unit over one connection. */
+static int load_dependencies(GraphLoad* load) {
+    int r;
+
+    load->units = calloc(load->listed ? load->listed : 1, sizeof(LoadUnit));
+    if (load->units == NULL) {
+        return -ENOMEM;
+    }
+
+    while (load->error == 0 && (load->in_flight > 0 || load->next < load->listed)) {
+        while (load->error == 0 && load->in_flight < GRAPH_MAX_IN_FLIGHT && load->next < load->listed) {
+            load->error = issue_get_all(load);
+        }
+
+        r = sd_bus_process(load->bus, NULL);
+        if (r < 0) {
+            load->error = r;
+            break;
+        }
+        if (r > 0) {
+            continue;
+        }
+
+        r = sd_bus_wait(load->bus, UINT64_MAX);
+        if (r < 0 && r != -EINTR) {
+            load->error = r;
+        }
+    }
+
+    for (size_t i = 0; i < load->listed; i++) {
+        sd_bus_slot_unref(load->units[i].slot);
+    }
+    return load->error;
+}
+
+/* Counting sort of the pending edges of `kind` into CSR arrays. */
+static bool build_csr(ServiceGraph* graph, const PendingEdge* edges, size_t edge_count, EdgeKind kind, bool reverse) {
+    size_t n = graph->unit_count;
+    uint32_t *offsets = calloc(n + 1, sizeof(uint32_t));
+    if (offsets == NULL) {
+        return false;
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < edge_count; i++) {
+        if (edges[i].kind == kind) {
+            offsets[(reverse ? edges[i].to : edges[i].from) + 1]++;
+            count++;
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+
+    uint32_t *targets = malloc((count ? count : 1) * sizeof(uint32_t));
+    uint32_t *fill = malloc((n ? n : 1) * sizeof(uint32_t));
+    if (targets == NULL || fill == NULL) {
+        free(offsets);
+        free(targets);
+        free(fill);
+        return false;
+    }
+    memcpy(fill, offsets, n * sizeof(uint32_t));
+
+    for (size_t i = 0; i < edge_count; i++) {
+        if (edges[i].kind == kind) {
+            uint32_t from = reverse ? edges[i].to : edges[i].from;
+            targets[fill[from]++] = reverse ? edges[i].from : edges[i].to;
+        }
+    }
+    free(fill);
+
+    graph->offsets[kind] = offsets;
+    graph->edges[kind] = targets;
+    return true;
+}
+
+static bool build_graph(ServiceGraph* graph, PendingEdge* edges, size_t edge_count) {
+    for (int kind = 0; kind < EDGE_LOADED_KINDS; kind++) {
+        if (!build_csr(graph, edges, edge_count, (EdgeKind)kind, false)) {
+            return false;
+        }
+    }
+
+    /* Requires= and BindsTo= both stop the dependent unit, so they share one reverse list. */
+    for (size_t i = 0; i < edge_count; i++) {
+        if (edges[i].kind == EDGE_REQUIRES || edges[i].kind == EDGE_BINDS_TO) {
+            edges[i].kind = EDGE_STOPPED_BY;
+        }
+    }
+    return build_csr(graph, edges, edge_count, EDGE_STOPPED_BY, true);
+}
+
+/* Units named only as dependencies got ids after loading started; give them times too. */
+static bool grow_times(ServiceGraph* graph, size_t count) {
+    uint64_t *activating = realloc(graph->activating_usec, (count ? count : 1) * sizeof(uint64_t));
+    if (activating == NULL) {
+        return false;
+    }
+    graph->activating_usec = activating;
+
+    uint64_t *active = realloc(graph->active_usec, (count ? count : 1) * sizeof(uint64_t));
+    if (active == NULL) {
+        return false;
+    }
+    graph->active_usec = active;
+    return true;
+}
+
+static ServiceGraph* load_service_graph(void) {
+    GraphLoad load = {0};
+    ServiceGraph *graph = calloc(1, sizeof(ServiceGraph));
+    bool ok = false;
+    int r;
+
+    if (graph == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return NULL;
+    }
+    load.graph = graph;
+
+    /* A connection of its own: the pipelined replies would otherwise queue up behind other callers. */
+    r = openServiceBus(&load.bus);
+    if (r < 0) {
+        fprintf(stderr, "Failed to connect to the bus: %s\n", strerror(-r));
+        free(graph);
+        return NULL;
+    }
+
+    r = list_units(&load);
+    if (r >= 0) {
+        /* Dependencies intern more units while loading; times are sized for the listed ones first. */
+        graph->activating_usec = calloc(load.listed ? load.listed : 1, sizeof(uint64_t));
+        graph->active_usec = calloc(load.listed ? load.listed : 1, sizeof(uint64_t));
+        r = graph->activating_usec && graph->active_usec ? load_dependencies(&load) : -ENOMEM;
+    }
+    if (r >= 0) {
+        sd_bus_get_property_trivial(load.bus, DESTINATION, "/org/freedesktop/systemd1", "org.freedesktop.systemd1.Manager",
+                                    "UserspaceTimestampMonotonic", NULL, 't', &graph->userspace_usec);
+    }
+
+    if (r >= 0 && grow_times(graph, graph->unit_count)) {
+        memset(graph->activating_usec + load.listed, 0, (graph->unit_count - load.listed) * sizeof(uint64_t));
+        memset(graph->active_usec + load.listed, 0, (graph->unit_count - load.listed) * sizeof(uint64_t));
+        ok = build_graph(graph, load.edges, load.edge_count);
+    }
+    if (r < 0) {
+        fprintf(stderr, "Failed to load the dependency graph: %s\n", strerror(-r));
+    } else if (!ok) {
+        fprintf(stderr, "Memory allocation failed\n");
+    }
+
+    for (size_t i = 0; i < load.listed; i++) {
+        free(load.paths[i]);
+    }
+    free(load.paths);
+    free(load.units);
+    free(load.edges);
+    sd_bus_flush_close_unref(load.bus);
+
+    if (!ok) {
+        freeServiceGraph(graph);
+        return NULL;
+    }
+    return graph;
+}
+
+ServiceGraph* loadServiceGraph(void) {
+    uint64_t start = statsNow();
+    ServiceGraph *graph = load_service_graph();
+    statsRecord(STAT_LOAD_SERVICE_GRAPH, start, graph == NULL);
+    return graph;
+}
+
+void freeServiceGraph(ServiceGraph* graph) {
+    if (graph == NULL) {
+        return;
+    }
+
+    for (int kind = 0; kind < EDGE_KINDS; kind++) {
+        free(graph->offsets[kind]);
+        free(graph->edges[kind]);
+    }
+    free(graph->names);
+    free(graph->name_offsets);
+    free(graph->slots);
+    free(graph->activating_usec);
+    free(graph->active_usec);
+    free(graph);
+}
+
+size_t serviceGraphUnitCount(const ServiceGraph* graph) {
+    return graph->unit_count;
+}
+
+const char* serviceGraphUnitName(const ServiceGraph* graph, uint32_t unit) {
+    return unit < graph->unit_count ? unit_name(graph, unit) : NULL;
+}
+
+bool serviceGraphFindUnit(const ServiceGraph* graph, const char* name, uint32_t* unit) {
+    return lookup_unit(graph, name, unit);
+}
+
+uint64_t serviceGraphUserspaceUsec(const ServiceGraph* graph) {
+    return graph->userspace_usec;
+}
+
+static ServiceGraphNode make_node(const ServiceGraph* graph, uint32_t unit, uint32_t depth) {
+    return (ServiceGraphNode){
+        .unit = unit,
+        .depth = depth,
+        .activating_usec = graph->activating_usec[unit],
+        .active_usec = graph->active_usec[unit],
+    };
+}
+
+/*
+ * Depth-first preorder over the union of `kinds` from `root`; every unit
+ * shows up once, under the first unit that reached it.
+ */
+static size_t walk_tree(const ServiceGraph* graph, uint32_t root, const EdgeKind* kinds, size_t kind_count,
+                        ServiceGraphNode* nodes, size_t max) {
+    size_t n = graph->unit_count;
+    size_t written = 0;
+    size_t stack_size = 0, stack_capacity = 64;
+    bool *seen = calloc(n, sizeof(bool));
+    ServiceGraphNode *stack = malloc(stack_capacity * sizeof(ServiceGraphNode));
+
+    if (seen == NULL || stack == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        free(seen);
+        free(stack);
+        return 0;
+    }
+
+    stack[stack_size++] = make_node(graph, root, 0);
+    while (stack_size > 0 && written < max) {
+        ServiceGraphNode node = stack[--stack_size];
+        if (seen[node.unit]) {
+            continue;
+        }
+        seen[node.unit] = true;
+        nodes[written++] = node;
+
+        /* Pushed in reverse, so children come out in the order systemd listed them. */
+        for (size_t k = kind_count; k-- > 0; ) {
+            const uint32_t *offsets = graph->offsets[kinds[k]];
+            const uint32_t *edges = graph->edges[kinds[k]];
+
+            for (uint32_t e = offsets[node.unit + 1]; e-- > offsets[node.unit]; ) {
+                if (seen[edges[e]]) {
+                    continue;
+                }
+                if (stack_size == stack_capacity) {
+                    ServiceGraphNode *temp = realloc(stack, stack_capacity * 2 * sizeof(ServiceGraphNode));
+                    if (temp == NULL) {
+                        fprintf(stderr, "Memory allocation failed\n");
+                        free(seen);
+                        free(stack);
+                        return written;
+                    }
+                    stack = temp;
+                    stack_capacity *= 2;
+                }
+                stack[stack_size++] = make_node(graph, edges[e], node.depth + 1);
+            }
+        }
+    }
+
+    free(seen);
+    free(stack);
+    return written;
+}
+
+/*
+ * Like systemd-analyze critical-chain: from `root`, step to the After=
+ * dependency that became active last before the current unit started
+ * activating, until there is none.
+ */
+static size_t critical_chain(const ServiceGraph* graph, uint32_t root, ServiceGraphNode* nodes, size_t max) {
+    const uint32_t *offsets = graph->offsets[EDGE_AFTER];
+    const uint32_t *edges = graph->edges[EDGE_AFTER];
+    size_t written = 0;
+    uint32_t unit = root;
+
+    /* Each step goes strictly back in time, so at most one step per unit. */
+    while (written < max && written < graph->unit_count) {
+        nodes[written] = make_node(graph, unit, (uint32_t)written);
+        written++;
+
+        uint64_t started = graph->activating_usec[unit];
+        uint64_t latest = 0;
+        uint32_t next = unit;
+        for (uint32_t e = offsets[unit]; e < offsets[unit + 1] && started != 0; e++) {
+            uint64_t active = graph->active_usec[edges[e]];
+            if (active != 0 && active <= started && active > latest && edges[e] != unit) {
+                latest = active;
+                next = edges[e];
+            }
+        }
+        if (next == unit) {
+            break;
+        }
+        unit = next;
+    }
+
+    return written;
+}
+
+static size_t query_service_graph(const ServiceGraph* graph, ServiceGraphQuery query, uint32_t unit, ServiceGraphNode* nodes, size_t max) {
+    static const EdgeKind pulls_in[] = { EDGE_REQUIRES, EDGE_BINDS_TO, EDGE_WANTS };
+    static const EdgeKind stops[] = { EDGE_STOPPED_BY };
+
+    if (unit >= graph->unit_count || max == 0) {
+        return 0;
+    }
+
+    switch (query) {
+        case SERVICE_GRAPH_PULLS_IN:
+            return walk_tree(graph, unit, pulls_in, sizeof(pulls_in) / sizeof(pulls_in[0]), nodes, max);
+        case SERVICE_GRAPH_STOPS_WITH:
+            return walk_tree(graph, unit, stops, 1, nodes, max);
+        case SERVICE_GRAPH_CRITICAL_CHAIN:
+            return critical_chain(graph, unit, nodes, max);
+    }
+    return 0;
+}
+
+size_t queryServiceGraph(const ServiceGraph* graph, ServiceGraphQuery query, uint32_t unit, ServiceGraphNode* nodes, size_t max) {
+    uint64_t start = statsNow();
+    size_t count = query_service_graph(graph, query, unit, nodes, max);
+    statsRecord(STAT_QUERY_SERVICE_GRAPH, start, count == 0);
+    return count;
+}
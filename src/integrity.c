@@ -0,0 +1,591 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "service.h"
+#include "stats.h"
+#include "util.h"
+#include "work_pool.h"
+
+/*
+ * SHA-256 of the binaries services run. Every distinct file of a call is
+ * mapped and hashed once, in parallel on the work pool. Digests are kept
+ * in a cache file keyed by (dev, inode, mtime, size), so a repeat run only
+ * reads files that changed since.
+ *
+ * Cache file layout, native endian: HashCacheHeader, then
+ * HashRecord[record_count] sorted by (dev, inode).
+ */
+#define HASH_CACHE_MAGIC "SVHCACHE"
+#define HASH_CACHE_VERSION 1
+
+/* Records not looked up for this long are dropped when the cache is saved. */
+#define HASH_CACHE_MAX_AGE (30 * 24 * 60 * 60)
+
+#define SHA256_BLOCK_SIZE 64
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_count;
+} HashCacheHeader;
+
+typedef struct {
+    uint64_t dev;
+    uint64_t inode;
+    uint64_t mtime_nsec;
+    uint64_t size;
+    uint64_t used;       /* time() of the last call that looked it up */
+    uint8_t sha256[EXECUTABLE_HASH_SIZE];
+} HashRecord;
+
+/* systemd's search path for ExecStart= commands that are not absolute. */
+static const char *const exec_search_path[] = {
+    "/usr/local/sbin",
+    "/usr/local/bin",
+    "/usr/sbin",
+    "/usr/bin",
+    "/sbin",
+    "/bin",
+};
+
+/* Everything below is protected by cache_lock. */
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool cache_loaded;
+static char *cache_path;
+static HashRecord *records;
+static size_t record_count;
+static size_t record_capacity;
+
+/* ---- SHA-256 (FIPS 180-4) ---- */
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t block[SHA256_BLOCK_SIZE];
+    size_t used;
+} Sha256;
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_init(Sha256* sha) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(sha->state, initial, sizeof(initial));
+    sha->length = 0;
+    sha->used = 0;
+}
+
+static void sha256_compress(uint32_t state[8], const uint8_t* block) {
+    uint32_t w[64];
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+            (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+static void sha256_update(Sha256* sha, const uint8_t* data, size_t length) {
+    sha->length += length;
+
+    if (sha->used > 0) {
+        size_t take = SHA256_BLOCK_SIZE - sha->used < length ? SHA256_BLOCK_SIZE - sha->used : length;
+        memcpy(sha->block + sha->used, data, take);
+        sha->used += take;
+        data += take;
+        length -= take;
+        if (sha->used < SHA256_BLOCK_SIZE) {
+            return;
+        }
+        sha256_compress(sha->state, sha->block);
+        sha->used = 0;
+    }
+
+    /* Whole blocks straight from the mapping. */
+    for (; length >= SHA256_BLOCK_SIZE; data += SHA256_BLOCK_SIZE, length -= SHA256_BLOCK_SIZE) {
+        sha256_compress(sha->state, data);
+    }
+
+    memcpy(sha->block, data, length);
+    sha->used = length;
+}
+
+static void sha256_final(Sha256* sha, uint8_t digest[EXECUTABLE_HASH_SIZE]) {
+    uint64_t bits = sha->length * 8;
+    uint8_t padding[SHA256_BLOCK_SIZE * 2] = { 0x80 };
+    size_t pad = (sha->used < 56 ? 56 : 120) - sha->used;
+    uint8_t length[8];
+
+    for (int i = 0; i < 8; i++) {
+        length[i] = (uint8_t)(bits >> (56 - i * 8));
+    }
+    sha256_update(sha, padding, pad);
+    sha256_update(sha, length, sizeof(length));
+
+    for (int i = 0; i < 8; i++) {
+        digest[i * 4] = (uint8_t)(sha->state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(sha->state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(sha->state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)sha->state[i];
+    }
+}
+
+void sha256Digest(const void* data, size_t length, uint8_t digest[EXECUTABLE_HASH_SIZE]) {
+    Sha256 sha;
+
+    sha256_init(&sha);
+    sha256_update(&sha, data, length);
+    sha256_final(&sha, digest);
+}
+
+/* ---- Cache ---- */
+
+static uint64_t mtime_nsec(const struct stat* st) {
+    return (uint64_t)st->st_mtim.tv_sec * 1000000000ULL + (uint64_t)st->st_mtim.tv_nsec;
+}
+
+static int compare_records(const void* a, const void* b) {
+    const HashRecord *left = a;
+    const HashRecord *right = b;
+
+    if (left->dev != right->dev) {
+        return left->dev < right->dev ? -1 : 1;
+    }
+    if (left->inode != right->inode) {
+        return left->inode < right->inode ? -1 : 1;
+    }
+    return 0;
+}
+
+/* Called with cache_lock held. A missing or invalid file leaves the cache empty. */
+static void load_cache(void) {
+    HashCacheHeader header;
+    FILE *file;
+
+    cache_loaded = true;
+    cache_path = cacheFilePath("hashes.cache");
+    if (cache_path == NULL || (file = fopen(cache_path, "rb")) == NULL) {
+        return;
+    }
+
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, HASH_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != HASH_CACHE_VERSION) {
+        fclose(file);
+        return;
+    }
+
+    records = malloc((header.record_count ? header.record_count : 1) * sizeof(HashRecord));
+    if (records == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        fclose(file);
+        return;
+    }
+    if (fread(records, sizeof(HashRecord), header.record_count, file) != header.record_count) {
+        fprintf(stderr, "Ignoring corrupt hash cache %s\n", cache_path);
+        free(records);
+        records = NULL;
+        fclose(file);
+        return;
+    }
+    fclose(file);
+
+    record_count = header.record_count;
+    record_capacity = header.record_count;
+    /* Written sorted, but a binary search must not trust that. */
+    qsort(records, record_count, sizeof(HashRecord), compare_records);
+}
+
+/* Searches the first `sorted` records. */
+static HashRecord* find_record(uint64_t dev, uint64_t inode, size_t sorted) {
+    HashRecord key = { .dev = dev, .inode = inode };
+    return sorted ? bsearch(&key, records, sorted, sizeof(HashRecord), compare_records) : NULL;
+}
+
+/* Called with cache_lock held; drops stale records and writes the rest. */
+static void save_cache(uint64_t now) {
+    size_t kept = 0;
+
+    for (size_t i = 0; i < record_count; i++) {
+        if (records[i].used + HASH_CACHE_MAX_AGE >= now) {
+            records[kept++] = records[i];
+        }
+    }
+    record_count = kept;
+
+    if (cache_path == NULL) {
+        return;
+    }
+
+    char *temporary = malloc(strlen(cache_path) + 5);
+    if (temporary == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return;
+    }
+    sprintf(temporary, "%s.tmp", cache_path);
+    makeParentDirs(cache_path);
+
+    HashCacheHeader header = { .version = HASH_CACHE_VERSION, .record_count = (uint32_t)record_count };
+    memcpy(header.magic, HASH_CACHE_MAGIC, sizeof(header.magic));
+
+    FILE *file = fopen(temporary, "wb");
+    bool ok = file != NULL &&
+        fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(records, sizeof(HashRecord), record_count, file) == record_count;
+    if (file != NULL && fclose(file) != 0) {
+        ok = false;
+    }
+    if (!ok || rename(temporary, cache_path) < 0) {
+        fprintf(stderr, "Failed to write %s: %s\n", cache_path, strerror(errno));
+        unlink(temporary);
+    }
+    free(temporary);
+}
+
+/* ---- Hashing ---- */
+
+/* The first word of `command` without systemd's `-@:+!|` prefixes, unquoted. */
+static char* first_word(const char* command) {
+    const char *start = command;
+    size_t length;
+
+    while (*start == ' ' || (*start && strchr("-@:+!|", *start))) {
+        start++;
+    }
+    if (*start == '"') {
+        const char *end = strchr(++start, '"');
+        length = end ? (size_t)(end - start) : strlen(start);
+    } else {
+        length = strcspn(start, " ;");
+    }
+    return strndup(start, length);
+}
+
+/*
+ * The file to read for one unit, or NULL with *error set (0 if the unit
+ * names no binary). `binary` is taken as is; only below a root, where no
+ * systemd resolved one, is it guessed from the first word of `command`,
+ * looked up in the search path if not absolute. *shown gets the binary as
+ * the unit names it, below `root` if not NULL.
+ */
+static char* resolve_executable(const char* root, const char* binary, const char* command, char** shown, int* error) {
+    char *name;
+
+    *shown = NULL;
+    *error = 0;
+    if (binary && binary[0]) {
+        name = strdup(binary);
+    } else if (root && command && command[0]) {
+        name = first_word(command);
+    } else {
+        return NULL;
+    }
+    if (name == NULL || name[0] == '\0') {
+        *error = name ? ENOENT : ENOMEM;
+        free(name);
+        return NULL;
+    }
+
+    const char *prefix = root ? root : "";
+    size_t prefix_length = strlen(prefix);
+    while (prefix_length > 0 && prefix[prefix_length - 1] == '/') {
+        prefix_length--;
+    }
+
+    bool absolute = name[0] == '/';
+    size_t dir_count = absolute ? 1 : sizeof(exec_search_path) / sizeof(exec_search_path[0]);
+    char *file = NULL;
+    *error = ENOENT;
+    for (size_t i = 0; i < dir_count && file == NULL; i++) {
+        char candidate[PATH_MAX];
+        int written = absolute ? snprintf(candidate, sizeof(candidate), "%s", name) :
+            snprintf(candidate, sizeof(candidate), "%s/%s", exec_search_path[i], name);
+        if (written < 0 || (size_t)written >= sizeof(candidate)) {
+            *error = ENAMETOOLONG;
+            break;
+        }
+
+        file = root ? resolveInRoot(root, candidate) : strdup(candidate);
+        if (file == NULL && absolute) {
+            *error = errno;
+        } else if (file && !absolute && access(file, X_OK) < 0) {
+            free(file);
+            file = NULL;
+        }
+        if (file || absolute) {
+            *shown = malloc(prefix_length + (size_t)written + 1);
+            if (*shown) {
+                sprintf(*shown, "%.*s%s", (int)prefix_length, prefix, candidate);
+            }
+        }
+    }
+
+    free(name);
+    if (file) {
+        *error = 0;
+    }
+    return file;
+}
+
+static int hash_file(const char* path, const struct stat* expected, uint8_t digest[EXECUTABLE_HASH_SIZE]) {
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        return errno;
+    }
+    if (fstat(fd, &st) < 0) {
+        int error = errno;
+        close(fd);
+        return error;
+    }
+    /* Replaced between the stat and the open: the cache key would describe another file. */
+    if (st.st_dev != expected->st_dev || st.st_ino != expected->st_ino) {
+        close(fd);
+        return EAGAIN;
+    }
+
+    if (st.st_size > 0) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            int error = errno;
+            close(fd);
+            return error;
+        }
+        madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+        sha256Digest(map, (size_t)st.st_size, digest);
+        munmap(map, (size_t)st.st_size);
+    } else {
+        sha256Digest("", 0, digest);
+    }
+    close(fd);
+    return 0;
+}
+
+/* Cache misses, sorted by file so each distinct one is hashed once. */
+typedef struct {
+    struct stat st;
+    size_t index;
+} HashMiss;
+
+static int compare_misses(const void* a, const void* b) {
+    const struct stat *left = &((const HashMiss*)a)->st;
+    const struct stat *right = &((const HashMiss*)b)->st;
+
+    if (left->st_dev != right->st_dev) {
+        return left->st_dev < right->st_dev ? -1 : 1;
+    }
+    if (left->st_ino != right->st_ino) {
+        return left->st_ino < right->st_ino ? -1 : 1;
+    }
+    return 0;
+}
+
+/* One distinct file that was not in the cache. */
+typedef struct {
+    const char *path;
+    struct stat st;
+    int error;
+    uint8_t sha256[EXECUTABLE_HASH_SIZE];
+} HashTask;
+
+static void run_hash_task(void* context, size_t index) {
+    HashTask *task = (HashTask*)context + index;
+    task->error = hash_file(task->path, &task->st, task->sha256);
+}
+
+static bool hash_executables(const char* root, const char* const* binaries, const char* const* commands, size_t count,
+                             ExecutableHash* hashes) {
+    size_t alloc_count = count ? count : 1;
+    HashMiss *misses = malloc(alloc_count * sizeof(HashMiss));
+    HashTask *tasks = malloc(alloc_count * sizeof(HashTask));
+    size_t *task_of = malloc(alloc_count * sizeof(size_t));
+    /* What is read: hashes[i].path with its symlinks resolved below the root. */
+    char **files = calloc(alloc_count, sizeof(char*));
+    size_t miss_count = 0;
+    size_t task_count = 0;
+    uint64_t now = (uint64_t)time(NULL);
+    bool changed = false;
+
+    memset(hashes, 0, count * sizeof(ExecutableHash));
+    if (misses == NULL || tasks == NULL || task_of == NULL || files == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        free(misses);
+        free(tasks);
+        free(task_of);
+        free(files);
+        return false;
+    }
+
+    pthread_mutex_lock(&cache_lock);
+    if (!cache_loaded) {
+        load_cache();
+    }
+
+    /* Resolve and stat everything; what the cache has is done here. */
+    for (size_t i = 0; i < count; i++) {
+        struct stat st;
+
+        files[i] = resolve_executable(root, binaries ? binaries[i] : NULL, commands ? commands[i] : NULL,
+                                      &hashes[i].path, &hashes[i].error);
+        if (files[i] == NULL) {
+            continue;
+        }
+        if (stat(files[i], &st) < 0) {
+            hashes[i].error = errno;
+            continue;
+        }
+
+        HashRecord *record = find_record((uint64_t)st.st_dev, (uint64_t)st.st_ino, record_count);
+        if (record && record->mtime_nsec == mtime_nsec(&st) && record->size == (uint64_t)st.st_size) {
+            memcpy(hashes[i].sha256, record->sha256, EXECUTABLE_HASH_SIZE);
+            hashes[i].cached = true;
+            /* Kept fresh on disk roughly daily, not rewritten on every call. */
+            changed |= record->used + 24 * 60 * 60 < now;
+            record->used = now;
+            continue;
+        }
+
+        misses[miss_count++] = (HashMiss){ .st = st, .index = i };
+    }
+
+    /* Services sharing a binary (interpreters, wrappers) read it once. */
+    qsort(misses, miss_count, sizeof(HashMiss), compare_misses);
+    for (size_t m = 0; m < miss_count; m++) {
+        if (m == 0 || compare_misses(&misses[m - 1], &misses[m]) != 0) {
+            tasks[task_count++] = (HashTask){ .path = files[misses[m].index], .st = misses[m].st };
+        }
+        task_of[m] = task_count - 1;
+    }
+
+    /* The pool runs one job at a time; other callers only wait for the lock meanwhile. */
+    pthread_mutex_unlock(&cache_lock);
+    runWork(run_hash_task, tasks, task_count);
+    pthread_mutex_lock(&cache_lock);
+
+    size_t sorted = record_count;
+    for (size_t t = 0; t < task_count; t++) {
+        if (tasks[t].error != 0) {
+            continue;
+        }
+
+        HashRecord *record = find_record((uint64_t)tasks[t].st.st_dev, (uint64_t)tasks[t].st.st_ino, sorted);
+        if (record == NULL) {
+            if (record_count == record_capacity) {
+                size_t capacity = record_capacity ? record_capacity * 2 : 64;
+                HashRecord *grown = realloc(records, capacity * sizeof(HashRecord));
+                if (grown == NULL) {
+                    fprintf(stderr, "Memory allocation failed\n");
+                    break;
+                }
+                records = grown;
+                record_capacity = capacity;
+            }
+            record = &records[record_count++];
+            record->dev = (uint64_t)tasks[t].st.st_dev;
+            record->inode = (uint64_t)tasks[t].st.st_ino;
+        }
+        record->mtime_nsec = mtime_nsec(&tasks[t].st);
+        record->size = (uint64_t)tasks[t].st.st_size;
+        record->used = now;
+        memcpy(record->sha256, tasks[t].sha256, EXECUTABLE_HASH_SIZE);
+        changed = true;
+    }
+    if (record_count > sorted) {
+        qsort(records, record_count, sizeof(HashRecord), compare_records);
+    }
+    if (changed) {
+        save_cache(now);
+    }
+    pthread_mutex_unlock(&cache_lock);
+
+    for (size_t m = 0; m < miss_count; m++) {
+        const HashTask *task = &tasks[task_of[m]];
+        ExecutableHash *hash = &hashes[misses[m].index];
+        hash->error = task->error;
+        if (task->error == 0) {
+            memcpy(hash->sha256, task->sha256, EXECUTABLE_HASH_SIZE);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        free(files[i]);
+    }
+    free(misses);
+    free(tasks);
+    free(task_of);
+    free(files);
+    return true;
+}
+
+bool hashExecutables(const char* root, const char* const* binaries, const char* const* commands, size_t count,
+                     ExecutableHash* hashes) {
+    uint64_t start = statsNow();
+    bool success = hash_executables(root, binaries, commands, count, hashes);
+    statsRecord(STAT_HASH_EXECUTABLES, start, !success);
+    return success;
+}
+
+void freeExecutableHashes(ExecutableHash* hashes, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(hashes[i].path);
+        hashes[i].path = NULL;
+    }
+}
+
+void closeHashCache(void) {
+    pthread_mutex_lock(&cache_lock);
+    free(records);
+    free(cache_path);
+    records = NULL;
+    cache_path = NULL;
+    record_count = 0;
+    record_capacity = 0;
+    cache_loaded = false;
+    pthread_mutex_unlock(&cache_lock);
+}
@@ -0,0 +1,131 @@
+//! `--integrity`: the SHA-256 of every service's binary, hashed and cached by integrity.c,
+//! and with `--manifest FILE` whether it matches the known-good digest listed there.
+
+use super::*;
+
+pub const COLUMNS: [&str; 3] = ["exec_binary", "exec_sha256", "integrity"];
+
+lazy_static::lazy_static! {
+    /// Lowercase hex digest by absolute path, from `--manifest`.
+    static ref MANIFEST: Mutex<Option<HashMap<String, String>>> = Mutex::new(None);
+}
+
+pub struct Integrity {
+    /// The binary, relative to `--root` if there is one.
+    pub path: String,
+    /// Lowercase hex, empty if it could not be read.
+    pub sha256: String,
+    /// `ok`, `mismatch` or `unlisted` against the manifest, empty without one;
+    /// why it could not be hashed otherwise.
+    pub verdict: String,
+}
+
+impl Integrity {
+    /// Lines for the details pane.
+    pub fn lines(&self) -> String {
+        let mut lines = format!("\nBinary: {}", self.path);
+        match (self.sha256.is_empty(), self.verdict.is_empty()) {
+            (true, _) => lines.push_str(&format!("\nSHA-256: unavailable ({})", self.verdict)),
+            (false, true) => lines.push_str(&format!("\nSHA-256: {}", self.sha256)),
+            (false, false) => lines.push_str(&format!("\nSHA-256: {} ({})", self.sha256, self.verdict)),
+        }
+        lines
+    }
+}
+
+pub fn enabled() -> bool {
+    OPTIONS.lock().unwrap().integrity
+}
+
+/// Reads `sha256sum` output: a hex digest, whitespace, and the path, optionally marked with `*`.
+pub fn load_manifest(path: &str) -> io::Result<()> {
+    let mut digests = HashMap::new();
+    for (number, line) in std::fs::read_to_string(path)?.lines().enumerate() {
+        let line = line.trim_end();
+        if line.is_empty() || line.starts_with('#') {
+            continue;
+        }
+        let parsed = line.split_once(char::is_whitespace).and_then(|(digest, file)| {
+            let file = file.trim_start();
+            let file = file.strip_prefix('*').unwrap_or(file);
+            let valid = digest.len() == EXECUTABLE_HASH_SIZE * 2 && digest.bytes().all(|b| b.is_ascii_hexdigit());
+            (valid && !file.is_empty()).then(|| (file.to_string(), digest.to_ascii_lowercase()))
+        });
+        let Some((file, digest)) = parsed else {
+            return Err(io::Error::new(io::ErrorKind::InvalidData, format!("line {}: expected `<sha256>  <path>`", number + 1)));
+        };
+        digests.insert(file, digest);
+    }
+    *MANIFEST.lock().unwrap() = Some(digests);
+    Ok(())
+}
+
+/// A unit's ExecStart as integrity.c needs it: the binary systemd resolved for the
+/// first command, and the command lines it is guessed from under `--root`, where
+/// there is no systemd.
+#[derive(Default)]
+pub struct Exec {
+    pub binary: String,
+    pub command: String,
+}
+
+impl Exec {
+    pub fn of(details: &ServiceDetails) -> Self {
+        Exec { binary: details.str(details.executable_path_binary).into_owned(), command: details.str(details.executable_path).into_owned() }
+    }
+}
+
+/// Hashes the binaries of `execs` in one native call; None where a unit has none.
+pub fn check(execs: &[&Exec]) -> Vec<Option<Integrity>> {
+    let root = OPTIONS.lock().unwrap().root.clone();
+    let c_root = root.as_deref().and_then(|root| CString::new(root).ok());
+    let c_binaries: Vec<CString> = execs.iter().map(|e| CString::new(e.binary.as_str()).unwrap_or_default()).collect();
+    let c_binary_ptrs: Vec<*const c_char> = c_binaries.iter().map(|c| c.as_ptr()).collect();
+    let c_commands: Vec<CString> = execs.iter().map(|e| CString::new(e.command.as_str()).unwrap_or_default()).collect();
+    let c_command_ptrs: Vec<*const c_char> = c_commands.iter().map(|c| c.as_ptr()).collect();
+
+    let mut hashes: Vec<ExecutableHash> = Vec::with_capacity(execs.len());
+    let root_ptr = c_root.as_ref().map_or(std::ptr::null(), |root| root.as_ptr());
+    if !unsafe { hashExecutables(root_ptr, c_binary_ptrs.as_ptr(), c_command_ptrs.as_ptr(), execs.len(), hashes.as_mut_ptr()) } {
+        return execs.iter().map(|_| None).collect();
+    }
+    unsafe { hashes.set_len(execs.len()) };
+
+    let manifest = MANIFEST.lock().unwrap();
+    let checks = hashes
+        .iter()
+        .map(|hash| {
+            if hash.path.is_null() && hash.error == 0 {
+                return None;
+            }
+            let full_path = if hash.path.is_null() { Cow::Borrowed("") } else { unsafe { CStr::from_ptr(hash.path) }.to_string_lossy() };
+            let path = root.as_deref().and_then(|root| full_path.strip_prefix(root.trim_end_matches('/'))).unwrap_or(&full_path).to_string();
+
+            if hash.path.is_null() || hash.error != 0 {
+                let reason = io::Error::from_raw_os_error(if hash.error != 0 { hash.error } else { libc::ENOENT });
+                return Some(Integrity { path, sha256: String::new(), verdict: reason.to_string() });
+            }
+            let sha256: String = hash.sha256.iter().map(|byte| format!("{:02x}", byte)).collect();
+            let verdict = match manifest.as_ref().map(|digests| digests.get(&path)) {
+                None => "",
+                Some(None) => "unlisted",
+                Some(Some(expected)) if *expected == sha256 => "ok",
+                Some(Some(_)) => "mismatch",
+            };
+            Some(Integrity { path, sha256, verdict: verdict.to_string() })
+        })
+        .collect();
+
+    unsafe { freeExecutableHashes(hashes.as_mut_ptr(), hashes.len()) };
+    checks
+}
+
+/// The `COLUMNS` values of one record.
+pub fn values(check: Option<&Integrity>) -> [export::Value<'static>; 3] {
+    use export::Value;
+    let text = |value: &str| if value.is_empty() { Value::Null } else { Value::Str(Cow::Owned(value.to_string())) };
+    match check {
+        Some(check) => [text(&check.path), text(&check.sha256), text(&check.verdict)],
+        None => [Value::Null, Value::Null, Value::Null],
+    }
+}
@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <systemd/sd-journal.h>
+
+#include "service.h"
+#include "stats.h"
+
+/*
+ * Journal tails of single units. Every unit keeps the cursor of the last
+ * entry it read and a fixed ring of formatted lines, so a read only walks
+ * the entries added since and memory does not grow with the journal. The
+ * journal's inotify watch (sd_journal_process()) says whether anything was
+ * written at all, which makes idle reads free.
+ */
+
+/* Units whose tails are kept; the least recently read one is dropped beyond this. */
+#define JOURNAL_MAX_UNITS 16
+
+/* Longest field read, in bytes; longer messages are cut. */
+#define JOURNAL_DATA_THRESHOLD 2048
+
+#define UNIT_MATCH "_SYSTEMD_UNIT="
+#define MESSAGE_FIELD "MESSAGE="
+
+typedef struct {
+    char *unit;
+    char *match;           /* "_SYSTEMD_UNIT=<unit>" */
+    char *cursor;          /* last entry read, NULL before the first */
+    char **lines;          /* ring of `capacity` lines, the oldest at `first` */
+    size_t first;
+    size_t count;
+    uint64_t generation;   /* the journal's generation at its last read */
+    uint64_t last_used;
+} JournalUnit;
+
+struct JournalTail {
+    sd_journal *journal;
+    size_t capacity;
+    bool watching;         /* sd_journal_process() works, else every read walks */
+    uint64_t generation;   /* bumped whenever the journal changed */
+    uint64_t clock;
+    JournalUnit units[JOURNAL_MAX_UNITS];
+    size_t unit_count;
+};
+
+static void clear_unit(JournalTail* tail, JournalUnit* unit) {
+    for (size_t i = 0; i < unit->count; i++) {
+        free(unit->lines[(unit->first + i) % tail->capacity]);
+    }
+    free(unit->lines);
+    free(unit->unit);
+    free(unit->match);
+    free(unit->cursor);
+    memset(unit, 0, sizeof(*unit));
+}
+
+static JournalUnit* find_unit(JournalTail* tail, const char* name) {
+    for (size_t i = 0; i < tail->unit_count; i++) {
+        if (strcmp(tail->units[i].unit, name) == 0) {
+            return &tail->units[i];
+        }
+    }
+    return NULL;
+}
+
+/* The unit's tail, starting an empty one (in place of the least recently used if full). */
+static JournalUnit* get_unit(JournalTail* tail, const char* name) {
+    JournalUnit *unit = find_unit(tail, name);
+    if (unit != NULL) {
+        return unit;
+    }
+
+    size_t name_length = strlen(name);
+    char *copy = strdup(name);
+    char *match = malloc(strlen(UNIT_MATCH) + name_length + 1);
+    char **lines = calloc(tail->capacity, sizeof(char*));
+    if (copy == NULL || match == NULL || lines == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        free(copy);
+        free(match);
+        free(lines);
+        return NULL;
+    }
+    memcpy(match, UNIT_MATCH, strlen(UNIT_MATCH));
+    memcpy(match + strlen(UNIT_MATCH), name, name_length + 1);
+
+    if (tail->unit_count < JOURNAL_MAX_UNITS) {
+        unit = &tail->units[tail->unit_count++];
+    } else {
+        unit = &tail->units[0];
+        for (size_t i = 1; i < tail->unit_count; i++) {
+            if (tail->units[i].last_used < unit->last_used) {
+                unit = &tail->units[i];
+            }
+        }
+        clear_unit(tail, unit);
+    }
+    unit->unit = copy;
+    unit->match = match;
+    unit->lines = lines;
+    return unit;
+}
+
+static void push_line(JournalTail* tail, JournalUnit* unit, char* line) {
+    size_t slot = (unit->first + unit->count) % tail->capacity;
+
+    if (unit->count == tail->capacity) {
+        free(unit->lines[slot]);
+        unit->first = (unit->first + 1) % tail->capacity;
+    } else {
+        unit->count++;
+    }
+    unit->lines[slot] = line;
+}
+
+/* "Oct 17 12:00:01 message" for the current entry, control characters blanked. */
+static char* format_entry(sd_journal* journal) {
+    const void *data = NULL;
+    size_t length = 0;
+    const char *message = "";
+    size_t message_length = 0;
+
+    if (sd_journal_get_data(journal, "MESSAGE", &data, &length) >= 0 && length >= strlen(MESSAGE_FIELD)) {
+        message = (const char*)data + strlen(MESSAGE_FIELD);
+        message_length = length - strlen(MESSAGE_FIELD);
+    }
+
+    char stamp[32] = "";
+    uint64_t usec;
+    if (sd_journal_get_realtime_usec(journal, &usec) >= 0) {
+        time_t seconds = (time_t)(usec / 1000000);
+        struct tm tm;
+        if (localtime_r(&seconds, &tm) != NULL) {
+            strftime(stamp, sizeof(stamp), "%b %d %H:%M:%S", &tm);
+        }
+    }
+
+    size_t stamp_length = strlen(stamp);
+    char *line = malloc(stamp_length + 1 + message_length + 1);
+    if (line == NULL) {
+        return NULL;
+    }
+    memcpy(line, stamp, stamp_length);
+    line[stamp_length] = ' ';
+    for (size_t i = 0; i < message_length; i++) {
+        unsigned char c = (unsigned char)message[i];
+        line[stamp_length + 1 + i] = c < 0x20 || c == 0x7f ? ' ' : (char)c;
+    }
+    line[stamp_length + 1 + message_length] = '\0';
+    return line;
+}
+
+static int read_unit(JournalTail* tail, JournalUnit* unit) {
+    sd_journal *journal = tail->journal;
+    int added = 0;
+    int r;
+
+    sd_journal_flush_matches(journal);
+    r = sd_journal_add_match(journal, unit->match, 0);
+    if (r < 0) {
+        goto fail;
+    }
+
+    if (unit->cursor == NULL) {
+        /* First read: the newest entries that fit, oldest first. */
+        r = sd_journal_seek_tail(journal);
+        if (r < 0) {
+            goto fail;
+        }
+        r = sd_journal_previous_skip(journal, tail->capacity);
+    } else {
+        r = sd_journal_seek_cursor(journal, unit->cursor);
+        if (r < 0) {
+            goto fail;
+        }
+        /* Seeking lands on the cursor's own entry while it is still there. */
+        r = sd_journal_next(journal);
+        if (r > 0 && sd_journal_test_cursor(journal, unit->cursor) > 0) {
+            r = sd_journal_next(journal);
+        }
+    }
+
+    while (r > 0) {
+        char *line = format_entry(journal);
+        if (line == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            r = -ENOMEM;
+            break;
+        }
+        push_line(tail, unit, line);
+        added++;
+        r = sd_journal_next(journal);
+    }
+
+    /* Lines already taken stay; the cursor moves past them either way. */
+    if (added > 0) {
+        char *cursor = NULL;
+        if (sd_journal_get_cursor(journal, &cursor) >= 0) {
+            free(unit->cursor);
+            unit->cursor = cursor;
+        }
+    }
+    if (r < 0) {
+        goto fail;
+    }
+    return added;
+
+fail:
+    fprintf(stderr, "Failed to read the journal of %s: %s\n", unit->unit, strerror(-r));
+    return added > 0 ? added : -1;
+}
+
+JournalTail* openJournalTail(const char* directory, size_t capacity) {
+    if (capacity == 0) {
+        return NULL;
+    }
+
+    JournalTail *tail = calloc(1, sizeof(JournalTail));
+    if (tail == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return NULL;
+    }
+
+    int r = directory != NULL
+        ? sd_journal_open_directory(&tail->journal, directory, 0)
+        : sd_journal_open(&tail->journal, SD_JOURNAL_LOCAL_ONLY);
+    if (r < 0) {
+        fprintf(stderr, "Failed to open the journal%s%s: %s\n", directory ? " in " : "", directory ? directory : "", strerror(-r));
+        free(tail);
+        return NULL;
+    }
+
+    sd_journal_set_data_threshold(tail->journal, JOURNAL_DATA_THRESHOLD);
+    tail->capacity = capacity;
+    tail->watching = sd_journal_get_fd(tail->journal) >= 0;
+    tail->generation = 1;
+    return tail;
+}
+
+void closeJournalTail(JournalTail* tail) {
+    if (tail == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < tail->unit_count; i++) {
+        clear_unit(tail, &tail->units[i]);
+    }
+    sd_journal_close(tail->journal);
+    free(tail);
+}
+
+static int read_journal_tail(JournalTail* tail, const char* unit_name) {
+    if (tail->watching) {
+        int r = sd_journal_process(tail->journal);
+        if (r != SD_JOURNAL_NOP) {
+            tail->generation++;
+        }
+    } else {
+        tail->generation++;
+    }
+
+    JournalUnit *unit = get_unit(tail, unit_name);
+    if (unit == NULL) {
+        return -1;
+    }
+    unit->last_used = ++tail->clock;
+    if (unit->generation == tail->generation) {
+        return 0;
+    }
+    unit->generation = tail->generation;
+    return read_unit(tail, unit);
+}
+
+int readJournalTail(JournalTail* tail, const char* unit) {
+    uint64_t start = statsNow();
+    int added = read_journal_tail(tail, unit);
+    statsRecord(STAT_READ_JOURNAL_TAIL, start, added < 0);
+    return added;
+}
+
+size_t journalTailLines(JournalTail* tail, const char* unit_name, const char** lines, size_t max) {
+    JournalUnit *unit = find_unit(tail, unit_name);
+    if (unit == NULL) {
+        return 0;
+    }
+
+    size_t count = unit->count < max ? unit->count : max;
+    size_t skip = unit->count - count;
+    for (size_t i = 0; i < count; i++) {
+        lines[i] = unit->lines[(unit->first + skip + i) % tail->capacity];
+    }
+    return count;
+}
@@ -1,4 +1,4 @@
-use std::{error::Error, ffi::{CStr, CString}, io::{self, Write}, os::raw::c_char, slice, sync::Mutex};
+use std::{borrow::Cow, collections::HashMap, error::Error, ffi::{CStr, CString}, io::{self, Write}, os::raw::c_char, slice, sync::Mutex, time::Duration};
 use crossterm::event::KeyEvent;
 use libc::{c_int, wchar_t};
 use ratatui::{
@@ -12,9 +12,9 @@ use ratatui::{
     },
     symbols,
     terminal::Terminal,
-    text::Line,
+    text::{Line, Text},
     widgets::{
-        Block, Borders, HighlightSpacing, List, ListItem, ListState, Padding, Paragraph,
+        Block, Borders, Clear, HighlightSpacing, List, ListItem, ListState, Padding, Paragraph,
         StatefulWidget, Widget, Wrap,
     },
 };
@@ -27,28 +27,288 @@ const TEXT_FG_COLOR: Color = SLATE.c200;
 const INACTIVE_TEXT_FG_COLOR: Color = RED.c500;
 const RUNNING_TEXT_FG_COLOR: Color = GREEN.c500;
 
+/// A string inside a `ServiceDetails` allocation: `length` bytes at `data + offset`.
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct ServiceString {
+    offset: u32,
+    length: u32,
+}
+
+/// Mirror of `ServiceDetails` in service.h. The C side returns it as one
+/// allocation holding the fixed fields followed by the string bytes, so it is
+/// only ever handled by reference and released with `freeServiceDetails`.
 #[repr(C)]
 #[derive(Debug)]
 pub struct ServiceDetails {
-    service_name: [c_char; 256],
-    service_display_name: [c_char; 256],
-    executable_path: [c_char; 1024],
-    description: [c_char; 4192],
-    service_type: [c_char; 256],
-    service_account: [c_char; 256],
+    service_name: ServiceString,
+    service_display_name: ServiceString,
+    executable_path: ServiceString,
+    executable_path_binary: ServiceString,
+    description: ServiceString,
+    service_type: ServiceString,
+    service_account: ServiceString,
+    load_state: ServiceString,
+    active_state: ServiceString,
+    sub_state: ServiceString,
+    control_group: ServiceString,
+    state_change_timestamp: u64,
+    active_enter_timestamp: u64,
+    active_exit_timestamp: u64,
+    memory_current: u64,
+    cpu_usage_nsec: u64,
+    main_pid: u32,
+    restart_count: u32,
+    size: u32,
+    data: [u8; 0],
+}
+
+impl ServiceDetails {
+    /// Borrows a string straight out of the allocation; only invalid UTF-8 is copied.
+    fn str(&self, string: ServiceString) -> Cow<'_, str> {
+        if string.length == 0 || string.offset as u64 + string.length as u64 > self.size as u64 {
+            return Cow::Borrowed("");
+        }
+        // SAFETY: the C side allocates `size` bytes behind the header and keeps
+        // every ServiceString within them, as checked above.
+        let bytes = unsafe { slice::from_raw_parts(self.data.as_ptr().add(string.offset as usize), string.length as usize) };
+        String::from_utf8_lossy(bytes)
+    }
+}
+
+#[cfg(target_os = "linux")]
+#[repr(C)]
+pub struct ServiceQueryResult {
+    exists: bool,
+    running: bool,
+    details: *mut ServiceDetails,
+}
+
+#[cfg(target_os = "linux")]
+impl ServiceQueryResult {
+    fn empty() -> Self {
+        Self { exists: false, running: false, details: std::ptr::null_mut() }
+    }
+}
+
+#[cfg(target_os = "linux")]
+const SERVICE_EVENT_REMOVED: c_int = 1;
+#[cfg(target_os = "linux")]
+const SERVICE_EVENT_RESYNC: c_int = 2;
+
+/// A live update from watch.c: fresh details for a new or changed unit, a removal, or a
+/// resync after the watch reconnected.
+#[cfg(target_os = "linux")]
+#[repr(C)]
+pub struct ServiceEvent {
+    kind: c_int,
+    running: bool,
+    name: *mut c_char,
+    details: *mut ServiceDetails,
+}
+
+/// Mirror of `CgroupSample` in service.h.
+#[cfg(target_os = "linux")]
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct CgroupSample {
+    valid: bool,
+    memory_current: u64,
+    cpu_usage_usec: u64,
+    io_read_bytes: u64,
+    io_write_bytes: u64,
+    pids_current: u64,
+}
+
+/// Opaque dependency graph owned by graph.c.
+#[cfg(target_os = "linux")]
+#[repr(C)]
+pub struct ServiceGraph {
+    _private: [u8; 0],
+}
+
+/// Opaque batch reader over the units of a root, owned by offline.c.
+#[cfg(target_os = "linux")]
+#[repr(C)]
+pub struct OfflineQuery {
+    _private: [u8; 0],
+}
+
+/// Opaque journal reader owned by journal.c.
+#[cfg(target_os = "linux")]
+#[repr(C)]
+pub struct JournalTail {
+    _private: [u8; 0],
+}
+
+#[cfg(target_os = "linux")]
+const EXECUTABLE_HASH_SIZE: usize = 32;
+
+/// Mirror of `ExecutableHash` in service.h.
+#[cfg(target_os = "linux")]
+#[repr(C)]
+pub struct ExecutableHash {
+    path: *mut c_char,
+    error: c_int,
+    cached: bool,
+    sha256: [u8; EXECUTABLE_HASH_SIZE],
+}
+
+/// Mirror of `ServiceGraphNode` in service.h.
+#[cfg(target_os = "linux")]
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct ServiceGraphNode {
+    unit: u32,
+    depth: u32,
+    activating_usec: u64,
+    active_usec: u64,
+}
+
+#[cfg(target_os = "linux")]
+#[repr(C)]
+#[derive(Default)]
+pub struct UnitCacheStats {
+    hits: u64,
+    misses: u64,
+    stale: u64,
+    records: u64,
+}
+
+#[cfg(target_os = "linux")]
+const SERVICE_STATS_BUCKETS: usize = 32;
+
+/// Calls and latencies of one entry point, bus method or parse step, from stats.c.
+#[cfg(target_os = "linux")]
+#[repr(C)]
+pub struct ServiceViewerStat {
+    name: *const c_char,
+    calls: u64,
+    errors: u64,
+    total_ns: u64,
+    max_ns: u64,
+    /// `buckets[i]` counts calls that took [2^i, 2^(i+1)) ns.
+    buckets: [u64; SERVICE_STATS_BUCKETS],
+}
+
+#[cfg(target_os = "linux")]
+impl ServiceViewerStat {
+    fn name(&self) -> Cow<'_, str> {
+        unsafe { CStr::from_ptr(self.name) }.to_string_lossy()
+    }
+
+    fn mean_ns(&self) -> u64 {
+        if self.calls == 0 { 0 } else { self.total_ns / self.calls }
+    }
+
+    /// Upper bound of the bucket holding the `p`th percentile, capped at the slowest call.
+    fn percentile_ns(&self, p: u64) -> u64 {
+        let rank = (self.calls * p).div_ceil(100).max(1);
+        let mut seen = 0;
+        for (i, &count) in self.buckets.iter().enumerate() {
+            seen += count;
+            if seen >= rank {
+                return (1u64 << (i + 1)).min(self.max_ns);
+            }
+        }
+        self.max_ns
+    }
+}
+
+#[cfg(target_os = "linux")]
+#[repr(C)]
+pub struct ServiceUnitRecord {
+    name: *mut c_char,
+    description: *mut c_char,
+    load_state: *mut c_char,
+    active_state: *mut c_char,
+    sub_state: *mut c_char,
+    object_path: *mut c_char,
 }
 
 extern "C" {
+    // The per-name calls of the windows UI; on linux only the benchmark uses them.
+    #[cfg(any(feature = "bench", not(target_os = "linux")))]
     fn doesServiceExist(service_name: *const i8) -> bool;
+    #[cfg(any(feature = "bench", not(target_os = "linux")))]
     fn isServiceRunning(service_name: *const i8) -> bool;
-    fn getServiceDetails(service_name: *const i8, details: *mut ServiceDetails);
+    #[cfg(any(feature = "bench", not(target_os = "linux")))]
+    fn getServiceDetails(service_name: *const i8) -> *mut ServiceDetails;
+    #[cfg(any(feature = "bench", not(target_os = "linux")))]
+    fn freeServiceDetails(details: *mut ServiceDetails);
     #[cfg(target_os = "windows")]
     fn EnumerateServiceNames(serviceNames: *mut *mut *mut wchar_t, count: *mut c_int) -> bool;
 
     #[cfg(target_os = "linux")]
-    fn serviceNamesArray(count: *mut usize) -> *mut *mut c_char;
+    fn listServiceUnits(patterns: *const *const c_char, pattern_count: usize, states: *const *const c_char, state_count: usize, count: *mut usize) -> *mut ServiceUnitRecord;
     #[cfg(target_os = "linux")]
+    fn freeServiceUnitRecords(records: *mut ServiceUnitRecord, count: usize);
+    #[cfg(target_os = "linux")]
+    fn setServiceBusAddress(address: *const c_char) -> bool;
+    #[cfg(target_os = "linux")]
+    fn closeServiceBus();
+    #[cfg(target_os = "linux")]
+    fn stopWorkPool();
+    #[cfg(all(feature = "bench", target_os = "linux"))]
+    fn serviceNamesArray(count: *mut usize) -> *mut *mut c_char;
+    #[cfg(all(feature = "bench", target_os = "linux"))]
     fn freeServiceNameArray(array: *mut *mut c_char, count: usize);
+    #[cfg(target_os = "linux")]
+    fn queryServices(service_names: *const *const c_char, unit_paths: *const *const c_char, count: usize, results: *mut ServiceQueryResult) -> bool;
+    #[cfg(target_os = "linux")]
+    fn freeServiceQueryResults(results: *mut ServiceQueryResult, count: usize);
+    #[cfg(target_os = "linux")]
+    fn openOfflineQuery(root: *const c_char, patterns: *const *const c_char, pattern_count: usize) -> *mut OfflineQuery;
+    #[cfg(target_os = "linux")]
+    fn readOfflineServices(query: *mut OfflineQuery, results: *mut ServiceQueryResult, capacity: usize) -> usize;
+    #[cfg(target_os = "linux")]
+    fn closeOfflineQuery(query: *mut OfflineQuery);
+    #[cfg(target_os = "linux")]
+    fn getOfflineCacheStats(stats: *mut UnitCacheStats);
+    #[cfg(target_os = "linux")]
+    fn startServiceWatch(patterns: *const *const c_char, pattern_count: usize) -> bool;
+    #[cfg(target_os = "linux")]
+    fn stopServiceWatch();
+    #[cfg(target_os = "linux")]
+    fn isServiceWatchConnected() -> bool;
+    #[cfg(target_os = "linux")]
+    fn pollServiceEvents(events: *mut ServiceEvent, max: usize) -> usize;
+    #[cfg(target_os = "linux")]
+    fn freeServiceEvents(events: *mut ServiceEvent, count: usize);
+    #[cfg(target_os = "linux")]
+    fn getServiceViewerStats(stats: *mut ServiceViewerStat, max: usize) -> usize;
+    #[cfg(target_os = "linux")]
+    fn sampleCgroups(control_groups: *const *const c_char, count: usize, samples: *mut CgroupSample) -> bool;
+    #[cfg(target_os = "linux")]
+    fn closeCgroupSampler();
+    #[cfg(target_os = "linux")]
+    fn loadServiceGraph() -> *mut ServiceGraph;
+    #[cfg(target_os = "linux")]
+    fn freeServiceGraph(graph: *mut ServiceGraph);
+    #[cfg(target_os = "linux")]
+    fn serviceGraphUnitCount(graph: *const ServiceGraph) -> usize;
+    #[cfg(target_os = "linux")]
+    fn serviceGraphUnitName(graph: *const ServiceGraph, unit: u32) -> *const c_char;
+    #[cfg(target_os = "linux")]
+    fn serviceGraphFindUnit(graph: *const ServiceGraph, name: *const c_char, unit: *mut u32) -> bool;
+    #[cfg(target_os = "linux")]
+    fn serviceGraphUserspaceUsec(graph: *const ServiceGraph) -> u64;
+    #[cfg(target_os = "linux")]
+    fn openJournalTail(directory: *const c_char, capacity: usize) -> *mut JournalTail;
+    #[cfg(target_os = "linux")]
+    fn closeJournalTail(tail: *mut JournalTail);
+    #[cfg(target_os = "linux")]
+    fn readJournalTail(tail: *mut JournalTail, unit: *const c_char) -> c_int;
+    #[cfg(target_os = "linux")]
+    fn journalTailLines(tail: *mut JournalTail, unit: *const c_char, lines: *mut *const c_char, max: usize) -> usize;
+    #[cfg(target_os = "linux")]
+    fn hashExecutables(root: *const c_char, binaries: *const *const c_char, commands: *const *const c_char, count: usize, hashes: *mut ExecutableHash) -> bool;
+    #[cfg(target_os = "linux")]
+    fn freeExecutableHashes(hashes: *mut ExecutableHash, count: usize);
+    #[cfg(target_os = "linux")]
+    fn closeHashCache();
+    #[cfg(target_os = "linux")]
+    fn queryServiceGraph(graph: *const ServiceGraph, query: c_int, unit: u32, nodes: *mut ServiceGraphNode, max: usize) -> usize;
 
 
 
@@ -58,75 +318,1073 @@ extern "C" {
 
 
 
-#[cfg(target_os = "linux")]
-#[link(name = "systemd")]
-extern "C" {
-    fn sd_bus_open_system(bus: *mut *mut std::ffi::c_void) -> i32;
-    fn sd_bus_unref(bus: *mut std::ffi::c_void);
+lazy_static::lazy_static! {
+    static ref SERVICES: Mutex<ServiceQuery> = Mutex::new(ServiceQuery::default());
+    static ref OPTIONS: Mutex<Options> = Mutex::new(Options::default());
 }
 
-lazy_static::lazy_static! {
-    static ref SERVICES: Mutex<Vec<String>> = Mutex::new(Vec::new());
+/// Command line options; the services themselves are still entered at the prompt.
+#[derive(Debug, Default)]
+struct Options {
+    /// Read unit files below this directory instead of asking the running systemd.
+    root: Option<String>,
+    /// D-Bus address to use instead of the system bus, e.g. a test bus.
+    bus_address: Option<String>,
+    /// Time the native entry points this many times each instead of starting the TUI.
+    bench: Option<usize>,
+    /// With `--bench`: draw the UI over this many synthetic units instead of timing the native calls.
+    frames: Option<usize>,
+    /// Print the call statistics as JSON on exit.
+    stats_json: bool,
+    /// Stream every matching unit to stdout in this format instead of starting the TUI.
+    export: Option<ExportFormat>,
+    /// What to select, as typed at the prompt; with `--export` it replaces the prompt.
+    query: Option<String>,
+    /// Keep a live snapshot and serve it on this Unix socket instead of starting the TUI.
+    serve: Option<String>,
+    /// With `--bench`: scrape the daemon on this socket instead of timing the native calls.
+    scrape: Option<String>,
+    /// Read unit logs from the journal files below this directory instead of the local journal.
+    journal_dir: Option<String>,
+    /// Write every selected unit to this binary snapshot file instead of starting the TUI.
+    snapshot: Option<String>,
+    /// Print the differences between two snapshot files instead of starting the TUI.
+    diff: Option<(String, String)>,
+    /// Show the SHA-256 of each service's binary in the UI and `--export`.
+    integrity: bool,
+    /// Known-good digests in `sha256sum` format to check the binaries against; implies `--integrity`.
+    manifest: Option<String>,
 }
 
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum ExportFormat {
+    JsonLines,
+    Csv,
+}
 
-fn main() -> Result<(), Box<dyn Error>> {
+/// What was typed at the prompt: unit names or globs, and `state:` filters.
+#[derive(Debug, Default)]
+struct ServiceQuery {
+    /// Unit names or globs such as `nginx*` or `*.timer`; on Linux bare names get `.service` appended.
+    patterns: Vec<String>,
+    /// Load, active or sub states such as `failed` or `running`, from `state:failed,running`.
+    states: Vec<String>,
+    /// `:all_services` was given.
+    all_services: bool,
+}
+
+impl ServiceQuery {
+    fn parse(input: &str) -> ServiceQuery {
+        let mut query = ServiceQuery::default();
+
+        for token in input.split(|c: char| c == ',' || c.is_whitespace()).filter(|t| !t.is_empty()) {
+            if token == ":all_services" {
+                query.all_services = true;
+            } else if let Some(states) = token.strip_prefix("state:") {
+                query.states.extend(states.split('|').filter(|s| !s.is_empty()).map(str::to_string));
+            } else if !cfg!(target_os = "linux") || token.contains('.') || token.contains(|c| matches!(c, '*' | '?' | '[')) {
+                query.patterns.push(token.to_string());
+            } else {
+                query.patterns.push(format!("{}.service", token));
+            }
+        }
 
+        query
+    }
+
+    /// Patterns to hand to systemd; a query of only states, or `:all_services`, covers every service.
+    fn unit_patterns(&self) -> Vec<&str> {
+        let mut patterns: Vec<&str> = self.patterns.iter().map(String::as_str).collect();
+        if self.all_services || patterns.is_empty() {
+            patterns.push("*.service");
+        }
+        patterns
+    }
+
+    /// Whether a unit in these states passes the `state:` filters. Like the states given to
+    /// ListUnitsByPatterns, a filter may name the load, active or sub state, so the live
+    /// updates keep e.g. `state:masked` units that the listing returned.
     #[cfg(target_os = "linux")]
-    unsafe {
-        let mut bus: *mut std::ffi::c_void = std::ptr::null_mut();
-        sd_bus_open_system(&mut bus);
-        sd_bus_unref(bus);
+    fn matches_states(&self, load_state: &str, active_state: &str, sub_state: &str) -> bool {
+        self.states.is_empty() || self.states.iter().any(|s| s == load_state || s == active_state || s == sub_state)
     }
-    println!("Welcome to status viewer cli");
-    println!("please enter the name of your service to get details about it:\n");
+}
 
-    let mut input = String::new();
+#[cfg(all(test, target_os = "linux"))]
+mod query_tests {
+    use super::ServiceQuery;
 
-    io::stdout().flush()?;
+    #[test]
+    fn state_filters_match_load_active_and_sub_states() {
+        let query = ServiceQuery::parse("state:masked|not-found,state:running");
+        assert!(query.matches_states("masked", "inactive", "dead"));
+        assert!(query.matches_states("not-found", "inactive", "dead"));
+        assert!(query.matches_states("loaded", "active", "running"));
+        assert!(!query.matches_states("loaded", "inactive", "dead"));
 
-    io::stdin().read_line(&mut input)?;
+        assert!(ServiceQuery::parse("state:loaded").matches_states("loaded", "failed", "failed"));
+        assert!(ServiceQuery::parse("nginx").matches_states("masked", "inactive", "dead"));
+    }
+}
 
-    let input = input.trim();
+fn parse_args() -> Result<Options, String> {
+    let mut options = Options::default();
+    let mut args = std::env::args().skip(1);
+
+    while let Some(arg) = args.next() {
+        match arg.as_str() {
+            "--root" => options.root = Some(args.next().ok_or("--root needs a path")?),
+            "--bus-address" => options.bus_address = Some(args.next().ok_or("--bus-address needs an address")?),
+            "--stats-json" => options.stats_json = true,
+            "--query" => options.query = Some(args.next().ok_or("--query needs a query")?),
+            "--serve" => options.serve = Some(args.next().ok_or("--serve needs a socket path")?),
+            #[cfg(feature = "bench")]
+            "--scrape" => options.scrape = Some(args.next().ok_or("--scrape needs a socket path")?),
+            "--snapshot" => options.snapshot = Some(args.next().ok_or("--snapshot needs a file")?),
+            "--diff" => {
+                let old = args.next().ok_or("--diff needs two snapshot files")?;
+                let new = args.next().ok_or("--diff needs two snapshot files")?;
+                options.diff = Some((old, new));
+            }
+            "--integrity" => options.integrity = true,
+            "--manifest" => {
+                options.manifest = Some(args.next().ok_or("--manifest needs a file")?);
+                options.integrity = true;
+            }
+            "--journal-dir" => options.journal_dir = Some(args.next().ok_or("--journal-dir needs a path")?),
+            "--export" => {
+                let format = args.next().ok_or("--export needs a format")?;
+                options.export = Some(match format.as_str() {
+                    "jsonl" => ExportFormat::JsonLines,
+                    "csv" => ExportFormat::Csv,
+                    _ => return Err(format!("unknown export format: {} (expected jsonl or csv)", format)),
+                });
+            }
+            #[cfg(feature = "bench")]
+            "--bench" => {
+                let iterations = args.next().ok_or("--bench needs an iteration count")?;
+                options.bench = Some(iterations.parse().map_err(|_| format!("invalid iteration count: {}", iterations))?);
+            }
+            #[cfg(feature = "bench")]
+            "--frames" => {
+                let items = args.next().ok_or("--frames needs a unit count")?;
+                options.frames = Some(items.parse().map_err(|_| format!("invalid unit count: {}", items))?);
+            }
+            _ => return Err(format!("unknown argument: {}", arg)),
+        }
+    }
 
-    let input_vec = input.split(", ").into_iter().collect::<Vec<&str>>();
-    let service_vec: Vec<String> = input_vec.iter().map(|s| s.to_string()).collect();
+    if options.root.is_some() && !cfg!(target_os = "linux") {
+        return Err("--root is only supported on linux".to_string());
+    }
+    if (options.bus_address.is_some() || options.bench.is_some() || options.stats_json || options.export.is_some()) && !cfg!(target_os = "linux") {
+        return Err("--bus-address, --bench, --stats-json and --export are only supported on linux".to_string());
+    }
+    if (options.serve.is_some() || options.scrape.is_some() || options.journal_dir.is_some()) && !cfg!(target_os = "linux") {
+        return Err("--serve, --scrape and --journal-dir are only supported on linux".to_string());
+    }
+    if (options.snapshot.is_some() || options.diff.is_some()) && !cfg!(target_os = "linux") {
+        return Err("--snapshot and --diff are only supported on linux".to_string());
+    }
+    if options.integrity && !cfg!(target_os = "linux") {
+        return Err("--integrity and --manifest are only supported on linux".to_string());
+    }
+    if options.integrity && (options.bench.is_some() || options.serve.is_some() || options.snapshot.is_some() || options.diff.is_some()) {
+        return Err("--integrity and --manifest only apply to the UI and --export".to_string());
+    }
+    let modes = [options.export.is_some(), options.bench.is_some(), options.serve.is_some(), options.snapshot.is_some(), options.diff.is_some()];
+    if modes.iter().filter(|&&mode| mode).count() > 1 {
+        return Err("--export, --bench, --serve, --snapshot and --diff cannot be combined".to_string());
+    }
+    if options.serve.is_some() && options.root.is_some() {
+        return Err("--serve needs a running systemd, not --root".to_string());
+    }
+    if options.scrape.is_some() && options.bench.is_none() {
+        return Err("--scrape needs --bench".to_string());
+    }
+    if options.frames.is_some() && (options.bench.is_none() || options.scrape.is_some()) {
+        return Err("--frames needs --bench and cannot be combined with --scrape".to_string());
+    }
+    if options.frames == Some(0) {
+        return Err("--frames needs at least one unit".to_string());
+    }
+    if options.bench == Some(0) {
+        return Err("--bench needs at least one iteration".to_string());
+    }
 
+    Ok(options)
+}
+
+
+fn main() -> Result<(), Box<dyn Error>> {
+
+    *OPTIONS.lock().unwrap() = parse_args()?;
+
+    #[cfg(target_os = "linux")]
     {
-        let mut service_static = SERVICES.lock().unwrap();
-        *service_static = service_vec; 
+        let options = OPTIONS.lock().unwrap();
+        if let Some(address) = &options.bus_address {
+            let address = CString::new(address.as_str())?;
+            if !unsafe { setServiceBusAddress(address.as_ptr()) } {
+                return Err("failed to set the bus address".into());
+            }
+        }
+        if let Some(path) = &options.manifest {
+            integrity::load_manifest(path).map_err(|err| format!("failed to read {}: {}", path, err))?;
+        }
+        if let Some(format) = options.export {
+            *SERVICES.lock().unwrap() = ServiceQuery::parse(options.query.as_deref().unwrap_or(":all_services"));
+            let root = options.root.clone();
+            drop(options);
+            let result = export::run(format, root.as_deref());
+            unsafe { closeHashCache() };
+            unsafe { stopWorkPool() };
+            unsafe { closeServiceBus() };
+            if OPTIONS.lock().unwrap().stats_json {
+                eprintln!("{}", stats_json(&service_viewer_stats()));
+            }
+            return match result {
+                // A closed pipe (e.g. `| head`) just ends the export.
+                Err(err) if err.kind() == io::ErrorKind::BrokenPipe => Ok(()),
+                result => Ok(result?),
+            };
+        }
+        if let Some(path) = options.snapshot.clone() {
+            *SERVICES.lock().unwrap() = ServiceQuery::parse(options.query.as_deref().unwrap_or(":all_services"));
+            let root = options.root.clone();
+            drop(options);
+            let result = snapshot::write(&path, root.as_deref());
+            unsafe { stopWorkPool() };
+            unsafe { closeServiceBus() };
+            println!("wrote {} units to {}", result?, path);
+            if OPTIONS.lock().unwrap().stats_json {
+                println!("{}", stats_json(&service_viewer_stats()));
+            }
+            return Ok(());
+        }
+        if let Some((old, new)) = options.diff.clone() {
+            drop(options);
+            // Like diff(1): 1 when the snapshots differ.
+            return match snapshot::diff(&old, &new) {
+                Ok(true) => std::process::exit(1),
+                Ok(false) => Ok(()),
+                Err(err) if err.kind() == io::ErrorKind::BrokenPipe => Ok(()),
+                Err(err) => Err(err.into()),
+            };
+        }
+        if let Some(path) = options.serve.clone() {
+            *SERVICES.lock().unwrap() = ServiceQuery::parse(options.query.as_deref().unwrap_or(":all_services"));
+            drop(options);
+            let result = daemon::run(&path);
+            unsafe { stopServiceWatch() };
+            unsafe { stopWorkPool() };
+            unsafe { closeServiceBus() };
+            return Ok(result?);
+        }
+        #[cfg(feature = "bench")]
+        {
+            if let (Some(iterations), Some(path)) = (options.bench, options.scrape.as_deref()) {
+                bench::scrape(path, iterations);
+                return Ok(());
+            }
+            if let (Some(iterations), Some(items)) = (options.bench, options.frames) {
+                drop(options);
+                bench::frames(items, iterations);
+                return Ok(());
+            }
+            if let Some(iterations) = options.bench {
+                bench::run(&options, iterations);
+                unsafe { stopWorkPool() };
+                unsafe { closeServiceBus() };
+                if options.stats_json {
+                    println!("{}", stats_json(&service_viewer_stats()));
+                }
+                return Ok(());
+            }
+        }
     }
 
-    get_service_details();
+    let mut input = OPTIONS.lock().unwrap().query.clone().unwrap_or_default();
+    if input.is_empty() {
+        println!("Welcome to status viewer cli");
+        println!("please enter the name of your service to get details about it:\n");
+
+        io::stdout().flush()?;
+
+        io::stdin().read_line(&mut input)?;
+    }
+
+    let input = input.trim();
+
+    *SERVICES.lock().unwrap() = ServiceQuery::parse(input);
+
+    #[cfg(target_os = "linux")]
+    start_service_watch();
    
     tui::init_error_hooks()?;
     let terminal = tui::init_terminal()?;
 
     let mut app = App::new();
     app.run(terminal)?;
+    // Joins the backend thread before the cleanup below.
+    drop(app);
 
     tui::restore_terminal()?;
 
+    #[cfg(target_os = "linux")]
+    {
+        unsafe { stopServiceWatch() };
+        unsafe { closeCgroupSampler() };
+        unsafe { closeHashCache() };
+        unsafe { stopWorkPool() };
+        unsafe { closeServiceBus() };
+
+        if OPTIONS.lock().unwrap().root.is_some() {
+            let mut stats = UnitCacheStats::default();
+            unsafe { getOfflineCacheStats(&mut stats) };
+            let lookups = stats.hits + stats.misses;
+            if lookups > 0 {
+                println!("unit cache: {}/{} hits ({:.1}%), {} stale", stats.hits, lookups, stats.hits as f64 * 100.0 / lookups as f64, stats.stale);
+            }
+        }
+
+        if OPTIONS.lock().unwrap().stats_json {
+            println!("{}", stats_json(&service_viewer_stats()));
+        }
+    }
+
     Ok(())
 }
 
 
 
+#[cfg(target_os = "linux")]
+fn service_viewer_stats() -> Vec<ServiceViewerStat> {
+    let total = unsafe { getServiceViewerStats(std::ptr::null_mut(), 0) };
+    let mut stats: Vec<ServiceViewerStat> = Vec::with_capacity(total);
+    let count = unsafe { getServiceViewerStats(stats.as_mut_ptr(), total) };
+    unsafe { stats.set_len(count.min(total)) };
+    stats
+}
+
+#[cfg(target_os = "linux")]
+fn stats_json(stats: &[ServiceViewerStat]) -> String {
+    let entries: Vec<String> = stats
+        .iter()
+        .map(|stat| {
+            let buckets: Vec<String> = stat.buckets.iter().map(u64::to_string).collect();
+            format!(
+                "{{\"name\":\"{}\",\"calls\":{},\"errors\":{},\"total_ns\":{},\"max_ns\":{},\"p50_ns\":{},\"p99_ns\":{},\"log2_ns_buckets\":[{}]}}",
+                stat.name(),
+                stat.calls,
+                stat.errors,
+                stat.total_ns,
+                stat.max_ns,
+                stat.percentile_ns(50),
+                stat.percentile_ns(99),
+                buckets.join(",")
+            )
+        })
+        .collect();
+    format!("{{\"stats\":[{}]}}", entries.join(","))
+}
+
+/// `--bench N`: latency of the native entry points against whatever bus is configured.
+/// Only built with the `bench` feature, which `cargo bench` needs.
+#[cfg(all(feature = "bench", target_os = "linux"))]
+mod bench {
+    use super::*;
+    use std::time::Instant;
+
+    struct Samples {
+        name: &'static str,
+        durations: Vec<Duration>,
+    }
+
+    impl Samples {
+        fn measure(name: &'static str, iterations: usize, mut call: impl FnMut(usize)) -> Samples {
+            let mut durations = Vec::with_capacity(iterations);
+            for i in 0..iterations {
+                let start = Instant::now();
+                call(i);
+                durations.push(start.elapsed());
+            }
+            durations.sort_unstable();
+            Samples { name, durations }
+        }
+
+        /// Zero without samples rather than an index underflow.
+        fn percentile(&self, p: usize) -> Duration {
+            match self.durations.len().checked_sub(1) {
+                Some(last) => self.durations[last * p / 100],
+                None => Duration::ZERO,
+            }
+        }
+
+        fn print(&self) {
+            let total: Duration = self.durations.iter().sum();
+            println!(
+                "{:<20} {:>8} {:>12.1?} {:>12.1?} {:>12.0}",
+                self.name,
+                self.durations.len(),
+                self.percentile(50),
+                self.percentile(99),
+                self.durations.len() as f64 / total.as_secs_f64()
+            );
+        }
+    }
+
+    fn service_names() -> Vec<CString> {
+        let mut count = 0;
+        let array = unsafe { serviceNamesArray(&mut count) };
+        if array.is_null() {
+            return Vec::new();
+        }
+        let names = unsafe { slice::from_raw_parts(array, count) }
+            .iter()
+            .map(|&name| unsafe { CStr::from_ptr(name) }.to_owned())
+            .collect();
+        unsafe { freeServiceNameArray(array, count) };
+        names
+    }
+
+    /// What getServiceDetails did before it read properties off the bus, kept only to compare
+    /// against: popen("systemctl show -p FragmentPath"), then the first Type, ExecStart,
+    /// Description and User lines of the unit file (no drop-ins, no continuations).
+    fn popen_service_details(name: &CStr) -> Option<[String; 4]> {
+        use std::io::BufRead;
+
+        let command = CString::new(format!("systemctl show -p FragmentPath {}", name.to_string_lossy())).ok()?;
+        let mut output = [0 as c_char; 256];
+        let fragment = unsafe {
+            let pipe = libc::popen(command.as_ptr(), b"r\0".as_ptr() as *const c_char);
+            if pipe.is_null() {
+                return None;
+            }
+            let line = libc::fgets(output.as_mut_ptr(), output.len() as c_int, pipe);
+            libc::pclose(pipe);
+            if line.is_null() {
+                return None;
+            }
+            CStr::from_ptr(output.as_ptr()).to_string_lossy().trim_end().strip_prefix("FragmentPath=")?.to_string()
+        };
+
+        let mut details: [String; 4] = Default::default();
+        let file = std::fs::File::open(fragment).ok()?;
+        for line in io::BufReader::new(file).lines().map_while(Result::ok) {
+            if let Some((key, value)) = line.split_once('=') {
+                let field = match key {
+                    "Type" => 0,
+                    "ExecStart" => 1,
+                    "Description" => 2,
+                    "User" => 3,
+                    _ => continue,
+                };
+                details[field] = value.to_string();
+            }
+        }
+        Some(details)
+    }
+
+    /// `--bench N --frames UNITS`: N frames of the UI over UNITS synthetic units, drawn into a
+    /// test terminal the size of a large window. The cursor jumps through the whole list between
+    /// frames, so every frame lays out another window of rows, first over all units and then
+    /// over the matches of a search.
+    pub fn frames(units: usize, iterations: usize) {
+        use ratatui::backend::TestBackend;
+
+        const WIDTH: u16 = 200;
+        const HEIGHT: u16 = 60;
+
+        let items = (0..units)
+            .map(|i| {
+                let status = if i % 3 == 0 { Status::Inactive } else { Status::Active };
+                let name = format!("synthetic{:06}", i);
+                let mut item = StatusItem::new(status, &name, &format!("{}.service", name), "");
+                item.summary = format!("Synthetic unit {}", i);
+                item.description = Some(format!("{}\nType: simple\nExecStart: /usr/bin/{}", item.summary, name));
+                item
+            })
+            .collect();
+        let mut app = App::with_items(items);
+        let mut terminal = match Terminal::new(TestBackend::new(WIDTH, HEIGHT)) {
+            Ok(terminal) => terminal,
+            Err(err) => {
+                eprintln!("failed to create a test terminal: {}", err);
+                return;
+            }
+        };
+
+        println!("{} units, {} frames of {}x{}", units, iterations, WIDTH, HEIGHT);
+        println!("{:<20} {:>8} {:>12} {:>12} {:>12}", "frame", "frames", "p50", "p99", "frames/s");
+
+        let mut draw = |app: &mut App, name: &'static str| {
+            Samples::measure(name, iterations, |i| {
+                let rows = app.status_list.len().max(1);
+                app.status_list.state.select(Some(i.wrapping_mul(7919) % rows));
+                if let Err(err) = terminal.draw(|f| f.render_widget(&mut *app, f.size())) {
+                    eprintln!("failed to draw: {}", err);
+                }
+            })
+            .print();
+        };
+
+        draw(&mut app, "all units");
+        app.search.query = "synthetic 7".to_string();
+        app.refilter(None);
+        draw(&mut app, "search matches");
+    }
+
+    /// `--bench N --scrape PATH`: N scrapes of a `--serve` daemon, spread over one client per CPU.
+    pub fn scrape(path: &str, iterations: usize) {
+        use std::io::Read;
+        use std::os::unix::net::UnixStream;
+
+        let clients = std::thread::available_parallelism().map_or(1, |n| n.get()).min(iterations).max(1);
+        println!("{} scrapes of {} from {} clients", iterations, path, clients);
+        println!("{:<20} {:>8} {:>12} {:>12} {:>12}", "request", "calls", "p50", "p99", "calls/s");
+
+        for (name, request) in [("GET /metrics", "GET /metrics HTTP/1.0\r\n\r\n"), ("GET /json", "GET /json HTTP/1.0\r\n\r\n")] {
+            let start = Instant::now();
+            let workers: Vec<_> = (0..clients)
+                .map(|client| {
+                    let path = path.to_string();
+                    let count = iterations / clients + usize::from(client < iterations % clients);
+                    std::thread::spawn(move || {
+                        let mut response = Vec::new();
+                        let mut failures = 0;
+                        let samples = Samples::measure(name, count, |_| {
+                            response.clear();
+                            let ok = UnixStream::connect(&path)
+                                .and_then(|mut stream| {
+                                    stream.write_all(request.as_bytes())?;
+                                    stream.read_to_end(&mut response)
+                                })
+                                .map_or(false, |_| response.starts_with(b"HTTP/1.0 200"));
+                            failures += usize::from(!ok);
+                        });
+                        (samples.durations, failures, response.len())
+                    })
+                })
+                .collect();
+
+            let mut durations = Vec::with_capacity(iterations);
+            let mut failures = 0;
+            let mut size = 0;
+            for worker in workers {
+                let (worker_durations, worker_failures, worker_size) = worker.join().unwrap();
+                durations.extend(worker_durations);
+                failures += worker_failures;
+                size = size.max(worker_size);
+            }
+            let elapsed = start.elapsed();
+            durations.sort_unstable();
+
+            let samples = Samples { name, durations };
+            println!(
+                "{:<20} {:>8} {:>12.1?} {:>12.1?} {:>12.0}   {} failed, {} bytes each",
+                samples.name,
+                samples.durations.len(),
+                samples.percentile(50),
+                samples.percentile(99),
+                samples.durations.len() as f64 / elapsed.as_secs_f64(),
+                failures,
+                size
+            );
+        }
+    }
+
+    pub fn run(options: &Options, iterations: usize) {
+        let names = service_names();
+        if names.is_empty() {
+            eprintln!("no services found, nothing to benchmark");
+            return;
+        }
+        println!("{} units, {} iterations per entry point", names.len(), iterations);
+        println!("{:<20} {:>8} {:>12} {:>12} {:>12}", "entry point", "calls", "p50", "p99", "calls/s");
+
+        let name = |i: usize| names[i % names.len()].as_ptr();
+        Samples::measure("isServiceRunning", iterations, |i| { unsafe { isServiceRunning(name(i)) }; }).print();
+        Samples::measure("doesServiceExist", iterations, |i| { unsafe { doesServiceExist(name(i)) }; }).print();
+        Samples::measure("getServiceDetails", iterations, |i| unsafe { freeServiceDetails(getServiceDetails(name(i))) }).print();
+        // systemctl talks to the bus in DBUS_SYSTEM_BUS_ADDRESS, except as root, where it
+        // prefers systemd's private socket; --root has no systemd to ask at all.
+        if options.root.is_none() {
+            if let Some(address) = &options.bus_address {
+                std::env::set_var("DBUS_SYSTEM_BUS_ADDRESS", address);
+            }
+            Samples::measure("popen(systemctl)", iterations, |i| { popen_service_details(&names[i % names.len()]); }).print();
+        }
+        Samples::measure("serviceNamesArray", iterations, |_| { service_names(); }).print();
+    }
+}
+
+#[cfg(target_os = "linux")]
+mod export;
+
+#[cfg(target_os = "linux")]
+mod integrity;
+
+#[cfg(target_os = "linux")]
+mod snapshot;
+
+#[cfg(target_os = "linux")]
+mod daemon;
+
 struct App {
     should_exit: bool,
+    show_stats: bool,
     status_list: StatusList,
+    details: DetailsCache,
+    metrics: Metrics,
+    #[cfg(target_os = "linux")]
+    dependencies: Dependencies,
+    #[cfg(target_os = "linux")]
+    journal: Journal,
+    #[cfg(target_os = "linux")]
+    backend: backend::Worker,
+    #[cfg(target_os = "linux")]
+    loading: Loading,
+    search: search::Search,
+    /// Rows of the list viewport at the last draw.
+    list_height: usize,
 }
 
 struct StatusList {
     items: Vec<StatusItem>,
     state: ListState,
+    /// Indices into `items` of the rows shown while searching; None shows every item.
+    rows: Option<Vec<usize>>,
 }
 
 #[derive(Debug)]
 struct StatusItem {
     service_name: String,
-    description: String,
+    /// Full unit name, e.g. `sshd.service`, to query details by.
+    unit_name: String,
+    /// D-Bus object path from the listing, empty if unknown.
+    object_path: String,
+    /// The unit's own one-line description, for searching.
+    summary: String,
+    /// Details known at load time (offline roots, Windows); systemd units load theirs on demand.
+    description: Option<String>,
+    /// The unit's cgroup once its details are loaded, empty while unknown or stopped.
+    control_group: String,
     status: Status,
+    /// Row text, rebuilt only when the status changes.
+    label: String,
+}
+
+/// How many rows above and below the viewport get their details loaded ahead of time.
+#[cfg(target_os = "linux")]
+const PREFETCH_ROWS: usize = 32;
+
+#[cfg(target_os = "linux")]
+const DETAILS_CACHE_CAPACITY: usize = 1024;
+
+/// Formatted details of recently shown units by unit name; the least recently used go first.
+#[derive(Default)]
+struct DetailsCache {
+    entries: HashMap<String, (String, u64)>,
+    tick: u64,
+}
+
+impl DetailsCache {
+    fn get(&self, unit_name: &str) -> Option<&str> {
+        self.entries.get(unit_name).map(|(details, _)| details.as_str())
+    }
+
+    /// Marks an entry as used; returns false if it is not cached.
+    #[cfg(target_os = "linux")]
+    fn touch(&mut self, unit_name: &str) -> bool {
+        self.tick += 1;
+        match self.entries.get_mut(unit_name) {
+            Some(entry) => {
+                entry.1 = self.tick;
+                true
+            }
+            None => false,
+        }
+    }
+
+    #[cfg(target_os = "linux")]
+    fn insert(&mut self, unit_name: &str, details: String) {
+        self.tick += 1;
+        self.entries.insert(unit_name.to_string(), (details, self.tick));
+
+        while self.entries.len() > DETAILS_CACHE_CAPACITY {
+            let oldest = self.entries.iter().min_by_key(|(_, (_, used))| *used).map(|(name, _)| name.clone());
+            match oldest {
+                Some(name) => self.entries.remove(&name),
+                None => break,
+            };
+        }
+    }
+
+    fn clear(&mut self) {
+        self.entries.clear();
+    }
+}
+
+/// How often the cgroups of units with loaded details are sampled.
+#[cfg(target_os = "linux")]
+const METRICS_INTERVAL: Duration = Duration::from_secs(1);
+
+/// A unit's resource use; the rates are over the interval between its last two samples.
+#[derive(Debug, Clone, Copy, Default)]
+struct Usage {
+    cpu_percent: f64,
+    memory: u64,
+    read_per_sec: f64,
+    write_per_sec: f64,
+    tasks: u64,
+}
+
+impl Usage {
+    /// Short form for the list rows.
+    fn summary(&self) -> String {
+        format!("{:>6.1}% {:>8}", self.cpu_percent, format_bytes(self.memory))
+    }
+
+    /// Lines for the details pane.
+    fn lines(&self) -> [String; 4] {
+        [
+            format!("CPU: {:.1}%", self.cpu_percent),
+            format!("Memory (live): {}", format_bytes(self.memory)),
+            format!("IO: {}/s read, {}/s written", format_bytes(self.read_per_sec as u64), format_bytes(self.write_per_sec as u64)),
+            format!("Tasks: {}", self.tasks),
+        ]
+    }
+}
+
+/// Live resource use of the units whose cgroup is known, by unit name.
+#[derive(Default)]
+struct Metrics {
+    usage: HashMap<String, Usage>,
+    /// The previous sample of each unit, to compute rates from.
+    #[cfg(target_os = "linux")]
+    samples: HashMap<String, CgroupSample>,
+    /// When the last sample was taken; None before the first.
+    #[cfg(target_os = "linux")]
+    sampled_at: Option<std::time::Instant>,
+}
+
+impl Metrics {
+    fn get(&self, unit_name: &str) -> Option<&Usage> {
+        self.usage.get(unit_name)
+    }
+
+    #[cfg(target_os = "linux")]
+    fn due(&self) -> bool {
+        self.sampled_at.map_or(true, |at| at.elapsed() >= METRICS_INTERVAL)
+    }
+
+    /// Samples every item with a cgroup in one native call; the others are forgotten,
+    /// which also lets the C side close their files.
+    #[cfg(target_os = "linux")]
+    fn sample(&mut self, items: &[StatusItem]) {
+        let sampled: Vec<&StatusItem> = items.iter().filter(|item| !item.control_group.is_empty()).collect();
+        let c_groups: Vec<CString> = sampled.iter().map(|item| CString::new(item.control_group.as_str()).unwrap_or_default()).collect();
+        let c_group_ptrs: Vec<*const c_char> = c_groups.iter().map(|g| g.as_ptr()).collect();
+        let mut results = vec![CgroupSample::default(); c_group_ptrs.len()];
+
+        let now = std::time::Instant::now();
+        let elapsed = self.sampled_at.map_or(0.0, |at| now.duration_since(at).as_secs_f64());
+        self.sampled_at = Some(now);
+
+        if !unsafe { sampleCgroups(c_group_ptrs.as_ptr(), c_group_ptrs.len(), results.as_mut_ptr()) } {
+            self.usage.clear();
+            self.samples.clear();
+            return;
+        }
+
+        let mut usage = HashMap::with_capacity(sampled.len());
+        let mut samples = HashMap::with_capacity(sampled.len());
+        for (item, sample) in sampled.iter().zip(results) {
+            if !sample.valid {
+                continue;
+            }
+            // Counters restart with the cgroup, so a drop just means no rate this time.
+            let rate = |now: u64, before: u64| if elapsed > 0.0 { now.saturating_sub(before) as f64 / elapsed } else { 0.0 };
+            let previous = self.samples.get(&item.unit_name).copied().unwrap_or(sample);
+            usage.insert(
+                item.unit_name.clone(),
+                Usage {
+                    cpu_percent: rate(sample.cpu_usage_usec, previous.cpu_usage_usec) / 10_000.0,
+                    memory: sample.memory_current,
+                    read_per_sec: rate(sample.io_read_bytes, previous.io_read_bytes),
+                    write_per_sec: rate(sample.io_write_bytes, previous.io_write_bytes),
+                    tasks: sample.pids_current,
+                },
+            );
+            samples.insert(item.unit_name.clone(), sample);
+        }
+        self.usage = usage;
+        self.samples = samples;
+    }
+}
+
+/// Which dependency tree of the selected unit replaces its description; `d` cycles through them.
+#[cfg(target_os = "linux")]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum DependencyView {
+    PullsIn,
+    StopsWith,
+    CriticalChain,
+}
+
+#[cfg(target_os = "linux")]
+impl DependencyView {
+    fn next(view: Option<Self>) -> Option<Self> {
+        match view {
+            None => Some(Self::PullsIn),
+            Some(Self::PullsIn) => Some(Self::StopsWith),
+            Some(Self::StopsWith) => Some(Self::CriticalChain),
+            Some(Self::CriticalChain) => None,
+        }
+    }
+
+    fn title(self) -> &'static str {
+        match self {
+            Self::PullsIn => "Pulls In",
+            Self::StopsWith => "Stops With",
+            Self::CriticalChain => "Critical Chain",
+        }
+    }
+
+    /// The matching `ServiceGraphQuery` value.
+    fn query(self) -> c_int {
+        match self {
+            Self::PullsIn => 0,
+            Self::StopsWith => 1,
+            Self::CriticalChain => 2,
+        }
+    }
+}
+
+/// Owns a graph from loadServiceGraph().
+#[cfg(target_os = "linux")]
+struct Graph(*mut ServiceGraph);
+
+// Loaded on the backend thread, then only read; service.h allows queries from any thread.
+#[cfg(target_os = "linux")]
+unsafe impl Send for Graph {}
+
+#[cfg(target_os = "linux")]
+impl Drop for Graph {
+    fn drop(&mut self) {
+        unsafe { freeServiceGraph(self.0) };
+    }
+}
+
+#[cfg(target_os = "linux")]
+impl Graph {
+    fn load() -> Option<Self> {
+        let graph = unsafe { loadServiceGraph() };
+        if graph.is_null() { None } else { Some(Self(graph)) }
+    }
+
+    fn unit_name(&self, unit: u32) -> Cow<'_, str> {
+        unsafe { CStr::from_ptr(serviceGraphUnitName(self.0, unit)) }.to_string_lossy()
+    }
+
+    /// The tree as text lines, systemctl list-dependencies style; None if systemd does not know the unit.
+    fn tree(&self, view: DependencyView, unit_name: &str) -> Option<Vec<String>> {
+        let name = CString::new(unit_name).ok()?;
+        let mut unit = 0u32;
+        if !unsafe { serviceGraphFindUnit(self.0, name.as_ptr(), &mut unit) } {
+            return None;
+        }
+
+        let total = unsafe { serviceGraphUnitCount(self.0) };
+        let mut nodes = vec![ServiceGraphNode::default(); total];
+        let count = unsafe { queryServiceGraph(self.0, view.query(), unit, nodes.as_mut_ptr(), total) };
+        nodes.truncate(count);
+
+        let userspace = unsafe { serviceGraphUserspaceUsec(self.0) };
+        let seconds = |usec: u64| usec as f64 / 1_000_000.0;
+
+        // Walking backwards, `more[d]` says whether a later row continues depth d
+        // before anything shallower, i.e. whether that branch still needs a │.
+        let mut lines = vec![String::new(); nodes.len()];
+        let mut more: Vec<bool> = Vec::new();
+        for (row, node) in nodes.iter().enumerate().rev() {
+            let depth = node.depth as usize;
+            more.resize(depth + 1, false);
+
+            let mut line = String::new();
+            if depth > 0 {
+                for &open in &more[1..depth] {
+                    line.push_str(if open { "│ " } else { "  " });
+                }
+                line.push_str(if more[depth] { "├─" } else { "└─" });
+            }
+            line.push_str(&self.unit_name(node.unit));
+            if view == DependencyView::CriticalChain && node.active_usec > 0 {
+                line.push_str(&format!(" @{:.3}s", seconds(node.active_usec.saturating_sub(userspace))));
+                if node.activating_usec > 0 && node.activating_usec < node.active_usec {
+                    line.push_str(&format!(" +{:.3}s", seconds(node.active_usec - node.activating_usec)));
+                }
+            }
+            lines[row] = line;
+            more[depth] = true;
+        }
+        Some(lines)
+    }
+}
+
+/// Where the dependency graph is; the backend loads it the first time a view is opened.
+#[cfg(target_os = "linux")]
+#[derive(Default)]
+enum GraphState {
+    #[default]
+    Unloaded,
+    Loading,
+    Loaded(Graph),
+    Failed,
+}
+
+/// The dependency view and the graph behind it.
+#[cfg(target_os = "linux")]
+#[derive(Default)]
+struct Dependencies {
+    view: Option<DependencyView>,
+    graph: GraphState,
+    /// Tree last built, keyed by unit name, so a frame does not repeat the query.
+    tree: Option<(String, DependencyView, Vec<String>)>,
+}
+
+#[cfg(target_os = "linux")]
+impl Dependencies {
+    fn cycle(&mut self) {
+        self.view = DependencyView::next(self.view);
+    }
+
+    /// Drops the graph; the next view loads a fresh one.
+    fn clear(&mut self) {
+        self.graph = GraphState::Unloaded;
+        self.tree = None;
+    }
+
+    /// Whether a view is open on a graph nobody asked for yet.
+    fn needs_graph(&self) -> bool {
+        self.view.is_some() && matches!(self.graph, GraphState::Unloaded) && OPTIONS.lock().unwrap().root.is_none()
+    }
+
+    fn set_graph(&mut self, graph: Option<Graph>) {
+        self.graph = graph.map_or(GraphState::Failed, GraphState::Loaded);
+        self.tree = None;
+    }
+
+    /// Lines to show for `unit_name` under the current view, querying on first use.
+    fn lines(&mut self, unit_name: &str) -> &[String] {
+        let Some(view) = self.view else { return &[] };
+        let stale = self.tree.as_ref().map_or(true, |(name, built, _)| name != unit_name || *built != view);
+        if stale {
+            let lines = if OPTIONS.lock().unwrap().root.is_some() {
+                vec!["Dependencies need a running systemd, not available with --root.".to_string()]
+            } else {
+                match &self.graph {
+                    GraphState::Loaded(graph) => graph
+                        .tree(view, unit_name)
+                        .unwrap_or_else(|| vec![format!("{} is not loaded.", unit_name)]),
+                    GraphState::Failed => vec!["Failed to load the dependency graph.".to_string()],
+                    GraphState::Unloaded | GraphState::Loading => vec!["Loading the dependency graph...".to_string()],
+                }
+            };
+            self.tree = Some((unit_name.to_string(), view, lines));
+        }
+        self.tree.as_ref().map_or(&[], |(_, _, lines)| lines.as_slice())
+    }
+}
+
+/// Journal lines kept per unit.
+#[cfg(target_os = "linux")]
+const JOURNAL_LINES: usize = 200;
+
+/// The selected unit's newest journal lines; every tick reads only what it logged since.
+#[cfg(target_os = "linux")]
+struct Journal {
+    /// Null without a journal to read, e.g. for a root that has none.
+    tail: *mut JournalTail,
+    unit_name: String,
+    lines: Vec<String>,
+}
+
+#[cfg(target_os = "linux")]
+impl Journal {
+    /// The local journal, or the one under `--journal-dir` or the `--root`.
+    fn open() -> Self {
+        let options = OPTIONS.lock().unwrap();
+        let directory = match (&options.journal_dir, &options.root) {
+            (Some(directory), _) => Some(directory.clone()),
+            (None, Some(root)) => Some(format!("{}/var/log/journal", root.trim_end_matches('/'))),
+            (None, None) => None,
+        };
+        drop(options);
+
+        let tail = match directory {
+            // A root without logs just has no journal pane.
+            Some(directory) if !std::path::Path::new(&directory).is_dir() => std::ptr::null_mut(),
+            Some(directory) => match CString::new(directory) {
+                Ok(directory) => unsafe { openJournalTail(directory.as_ptr(), JOURNAL_LINES) },
+                Err(_) => std::ptr::null_mut(),
+            },
+            None => unsafe { openJournalTail(std::ptr::null(), JOURNAL_LINES) },
+        };
+        Self { tail, unit_name: String::new(), lines: Vec::new() }
+    }
+
+    fn available(&self) -> bool {
+        !self.tail.is_null()
+    }
+
+    /// Follows `unit_name`; returns whether the lines changed.
+    fn refresh(&mut self, unit_name: Option<&str>) -> bool {
+        if self.tail.is_null() {
+            return false;
+        }
+        let Some(unit_name) = unit_name else {
+            self.unit_name.clear();
+            return !std::mem::take(&mut self.lines).is_empty();
+        };
+        let Ok(c_unit_name) = CString::new(unit_name) else { return false };
+
+        let added = unsafe { readJournalTail(self.tail, c_unit_name.as_ptr()) };
+        if added == 0 && self.unit_name == unit_name {
+            return false;
+        }
+
+        let mut lines: Vec<*const c_char> = vec![std::ptr::null(); JOURNAL_LINES];
+        let count = unsafe { journalTailLines(self.tail, c_unit_name.as_ptr(), lines.as_mut_ptr(), JOURNAL_LINES) };
+        self.lines = lines[..count]
+            .iter()
+            .map(|&line| unsafe { CStr::from_ptr(line) }.to_string_lossy().into_owned())
+            .collect();
+        self.unit_name = unit_name.to_string();
+        true
+    }
+}
+
+#[cfg(target_os = "linux")]
+impl Drop for Journal {
+    fn drop(&mut self) {
+        if !self.tail.is_null() {
+            unsafe { closeJournalTail(self.tail) };
+        }
+    }
+}
+
+#[cfg(target_os = "linux")]
+mod backend;
+
+/// What the UI is waiting on from the backend.
+#[cfg(target_os = "linux")]
+#[derive(Default)]
+struct Loading {
+    list: bool,
+    /// Units whose details were asked for and have not arrived.
+    details: std::collections::HashSet<String>,
 }
 
 #[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash)]
@@ -135,127 +1393,343 @@ enum Status {
     Inactive,
 }
 
-fn get_service_details() -> Vec<(Status, String, String)> {
-    let mut services_: Vec<(Status, String, String)> = Vec::new();
+/// Keeps the list live from systemd's signals; offline roots have nothing to watch.
+#[cfg(target_os = "linux")]
+fn start_service_watch() {
+    if OPTIONS.lock().unwrap().root.is_some() {
+        return;
+    }
 
-    fn char_array_to_string(c_array: *mut std::os::raw::c_char) -> Option<String> {
-        if c_array.is_null() {
-            return None;
+    let query = SERVICES.lock().unwrap();
+    let patterns: Vec<CString> = query.unit_patterns().iter().filter_map(|p| CString::new(*p).ok()).collect();
+    let pattern_ptrs: Vec<*const c_char> = patterns.iter().map(|p| p.as_ptr()).collect();
+
+    if !unsafe { startServiceWatch(pattern_ptrs.as_ptr(), pattern_ptrs.len()) } {
+        eprintln!("failed to watch services, press r to refresh manually.");
+    }
+}
+
+/// Builds the list; on a running systemd this is a single enumeration, details come later.
+fn load_status_items() -> Vec<StatusItem> {
+    let mut items: Vec<StatusItem> = Vec::new();
+
+    let query = SERVICES.lock().unwrap();
+
+    // Unit files alone say nothing about states, so offline roots go by the patterns only.
+    #[cfg(target_os = "linux")]
+    if let Some(root) = OPTIONS.lock().unwrap().root.as_deref() {
+        let patterns: Vec<String> = query.unit_patterns().iter().map(|p| p.to_string()).collect();
+        items.extend(query_offline_services(root, &patterns));
+        return items;
+    }
+
+    // systemd does the matching, so units outside the query never cross the bus.
+    #[cfg(target_os = "linux")]
+    {
+        let states: Vec<&str> = query.states.iter().map(String::as_str).collect();
+        items.extend(list_service_units(&query.unit_patterns(), &states).into_iter().map(StatusItem::from));
+    }
+
+    #[cfg(not(target_os = "linux"))]
+    {
+        let mut services = query.patterns.clone();
+
+        if query.all_services {
+            #[cfg(f)]
+            unsafe {
+                let mut service_names: *mut *mut wchar_t = std::ptr::null_mut();
+                let mut count: c_int = 0;
+
+                let success = EnumerateServiceNames(&mut service_names, &mut count);
+                if success {
+                    services.clear();
+
+                    for i in 0..count {
+                        let name = *service_names.add(i as usize);
+                        let name_str = wchar_to_string(name);
+                        println!("service name: {}", &name_str);
+                        services.push(name_str);
+                    }
+
+                    FreeServiceNamesArray(service_names, count);
+                } else {
+                    eprintln!("failed to enumerate service names.");
+                }
+            }
         }
-    
-        unsafe {
-            let c_str = CStr::from_ptr(c_array);
-            Some(c_str.to_string_lossy().into_owned())
+
+        for service in services.iter() {
+            let c_service_string = CString::new(service.clone()).unwrap();
+            let result = unsafe { doesServiceExist(c_service_string.as_ptr()) };
+
+            if result {
+                let get_status = unsafe { isServiceRunning(c_service_string.as_ptr()) };
+
+                let details = unsafe { getServiceDetails(c_service_string.as_ptr()) };
+
+                if let Some(details_ref) = unsafe { details.as_ref() } {
+                    items.push(StatusItem::loaded(get_status, service, details_ref));
+                    unsafe { freeServiceDetails(details) };
+                }
+            }
         }
     }
 
-    loop {
-        let mut services: std::sync::MutexGuard<Vec<String>> = SERVICES.lock().unwrap();
+    items
+}
 
-        if let Some(_) = services.iter().position(|s| s == ":all_services") {
-            unsafe {
-                #[cfg(target_os = "linux")]
-                {
-                    let mut count: usize = 0;
-                    let c_array = serviceNamesArray(&mut count);
+/// A unit as listed by `listServiceUnits`, copied out of the C records.
+#[cfg(target_os = "linux")]
+struct ServiceUnit {
+    name: String,
+    description: String,
+    active_state: String,
+    object_path: String,
+}
 
-                    if !c_array.is_null() {
-                        let mut rust_strings: Vec<String> = Vec::with_capacity(count);
+/// Lists units matching any of `patterns` and `states` with a single bus call.
+#[cfg(target_os = "linux")]
+fn list_service_units(patterns: &[&str], states: &[&str]) -> Vec<ServiceUnit> {
+    let c_patterns: Vec<CString> = patterns.iter().filter_map(|p| CString::new(*p).ok()).collect();
+    let c_states: Vec<CString> = states.iter().filter_map(|s| CString::new(*s).ok()).collect();
+    let c_pattern_ptrs: Vec<*const c_char> = c_patterns.iter().map(|p| p.as_ptr()).collect();
+    let c_state_ptrs: Vec<*const c_char> = c_states.iter().map(|s| s.as_ptr()).collect();
+
+    let mut count: usize = 0;
+    let records = unsafe {
+        listServiceUnits(c_pattern_ptrs.as_ptr(), c_pattern_ptrs.len(), c_state_ptrs.as_ptr(), c_state_ptrs.len(), &mut count)
+    };
 
-                        for i in 0..count {
-                            let c_str = *c_array.add(i);
-                            let rust_string = c_char_to_string(c_str);
-                            rust_strings.push(rust_string);
-                        }
+    if records.is_null() {
+        eprintln!("failed to enumerate service names.");
+        return Vec::new();
+    }
 
-                        freeServiceNameArray(c_array, count);
+    let units = unsafe { slice::from_raw_parts(records, count) }
+        .iter()
+        .map(|record| ServiceUnit {
+            name: c_char_to_string(record.name),
+            description: c_char_to_string(record.description),
+            active_state: c_char_to_string(record.active_state),
+            object_path: c_char_to_string(record.object_path),
+        })
+        .collect();
 
-                        services.clear();
+    unsafe { freeServiceUnitRecords(records, count) };
 
-                        for string in rust_strings {
-                            println!("{}", string);
-                            services.push(string);
-                        }
-                    } else {
-                        eprintln!("failed to enumerate service names.");
-                    }
+    units
+}
 
-                    
-                }
-                #[cfg(f)]
-                {
-                    let mut service_names: *mut *mut wchar_t = std::ptr::null_mut();
-                    let mut count: c_int = 0;
+/// Queries all services in one pipelined batch instead of three blocking calls each.
+/// `unit_paths`, if known, must be parallel to `services`; so is the result, with
+/// `None` for units that could not be queried.
+#[cfg(target_os = "linux")]
+fn query_services(services: &[&str], unit_paths: Option<&[&str]>) -> Vec<Option<ServiceEntry>> {
+    let mut entries = Vec::with_capacity(services.len());
+    query_services_with(services, unit_paths, |_, running, details| entries.push(details.map(|details| service_entry(running, details))));
+    entries
+}
+
+/// Like `query_services`, but hands `each` the index, running state and raw details of
+/// every unit while the batch is still alive, so nothing is formatted or kept.
+#[cfg(target_os = "linux")]
+fn query_services_with(services: &[&str], unit_paths: Option<&[&str]>, mut each: impl FnMut(usize, bool, Option<&ServiceDetails>)) {
+    let to_c_strings = |strings: &[&str]| -> Vec<CString> {
+        strings.iter().map(|s| CString::new(*s).unwrap_or_default()).collect()
+    };
+    let c_services = to_c_strings(services);
+    let c_service_ptrs: Vec<*const c_char> = c_services.iter().map(|s| s.as_ptr()).collect();
+    let c_paths = unit_paths.map(to_c_strings);
+    // An empty path means unknown; the batch then looks it up with GetUnit.
+    let c_path_ptrs: Option<Vec<*const c_char>> = c_paths
+        .as_ref()
+        .map(|paths| paths.iter().map(|p| if p.as_bytes().is_empty() { std::ptr::null() } else { p.as_ptr() }).collect());
+
+    let mut results: Vec<ServiceQueryResult> = (0..c_service_ptrs.len()).map(|_| ServiceQueryResult::empty()).collect();
+
+    let path_ptr = c_path_ptrs.as_ref().map_or(std::ptr::null(), |paths| paths.as_ptr());
+    if !unsafe { queryServices(c_service_ptrs.as_ptr(), path_ptr, c_service_ptrs.len(), results.as_mut_ptr()) } {
+        eprintln!("failed to query some services.");
+    }
+
+    for (i, result) in results.iter().enumerate() {
+        each(i, result.running, unsafe { result.details.as_ref() });
+    }
+
+    unsafe { freeServiceQueryResults(results.as_mut_ptr(), results.len()) };
+}
+
+/// Reads units from the unit files under `root`; nothing is running there, so all are inactive.
+#[cfg(target_os = "linux")]
+fn query_offline_services(root: &str, patterns: &[String]) -> Vec<StatusItem> {
+    let mut items = Vec::new();
+    let mut execs = Vec::new();
+    let checked = integrity::enabled();
+    query_offline_services_with(root, patterns, |details| {
+        items.push(StatusItem::loaded(false, &details.str(details.service_name), details));
+        if checked {
+            execs.push(integrity::Exec::of(details));
+        }
+    });
 
-                    let success = EnumerateServiceNames(&mut service_names, &mut count);
-                    if success {
+    if checked {
+        let execs: Vec<&integrity::Exec> = execs.iter().collect();
+        for (item, check) in items.iter_mut().zip(integrity::check(&execs)) {
+            if let (Some(description), Some(check)) = (item.description.as_mut(), check) {
+                description.push_str(&check.lines());
+            }
+        }
+    }
+    items
+}
 
-                        for i in 0..count {
-                            let name = *service_names.add(i as usize);
-                        }
-    
-                        services.clear();
-    
-                        for i in 0..count {
-                            let name = *service_names.add(i as usize);
-                            let name_str = wchar_to_string(name);
-                            println!("service name: {}", &name_str);
-                            services.push(name_str);
-                        }
+/// Units parsed per `readOfflineServices` call, and so the most details held at once.
+#[cfg(target_os = "linux")]
+const OFFLINE_BATCH: usize = 256;
 
-                        FreeServiceNamesArray(service_names, count);
-                    } else {
-                        eprintln!("failed to enumerate service names.");
-                    }
-                }
+/// Like `query_offline_services`, but hands `each` the raw details of every unit found,
+/// a batch at a time, so memory stays bounded however many units the root has.
+#[cfg(target_os = "linux")]
+fn query_offline_services_with(root: &str, patterns: &[String], mut each: impl FnMut(&ServiceDetails)) {
+    let c_root = CString::new(root).unwrap_or_default();
+    let c_patterns: Vec<CString> = patterns.iter().filter_map(|p| CString::new(p.as_str()).ok()).collect();
+    let c_pattern_ptrs: Vec<*const c_char> = c_patterns.iter().map(|p| p.as_ptr()).collect();
+
+    let query = unsafe { openOfflineQuery(c_root.as_ptr(), c_pattern_ptrs.as_ptr(), c_pattern_ptrs.len()) };
+    if query.is_null() {
+        eprintln!("failed to scan unit files under {}.", root);
+        return;
+    }
 
+    let mut results: Vec<ServiceQueryResult> = (0..OFFLINE_BATCH).map(|_| ServiceQueryResult::empty()).collect();
+    loop {
+        let count = unsafe { readOfflineServices(query, results.as_mut_ptr(), results.len()) };
+        if count == 0 {
+            break;
+        }
+        for result in &results[..count] {
+            if let Some(details) = unsafe { result.details.as_ref() } {
+                each(details);
             }
-
-            continue; 
-            
-            
         }
-        
-
-        for service in services.iter() {
-            let c_service_string = CString::new(service.clone()).unwrap();
-            let result = unsafe { doesServiceExist(c_service_string.as_ptr()) };
+        unsafe { freeServiceQueryResults(results.as_mut_ptr(), count) };
+    }
 
-            if result {
-                let get_status = unsafe { isServiceRunning(c_service_string.as_ptr()) };
+    unsafe { closeOfflineQuery(query) };
+}
 
-                let mut details = ServiceDetails {
-                    service_name: [0; 256],
-                    service_display_name: [0; 256],
-                    executable_path: [0; 1024],
-                    description: [0; 4192],
-                    service_type: [0; 256],
-                    service_account: [0; 256],
-                };
+/// What the list needs from a unit's details.
+struct ServiceEntry {
+    status: Status,
+    display_name: String,
+    details: String,
+    /// The unit's cgroup, e.g. `/system.slice/foo.service`; empty while it has none.
+    control_group: String,
+    /// ExecStart, for `--integrity`.
+    #[cfg(target_os = "linux")]
+    exec: integrity::Exec,
+}
 
-                unsafe { getServiceDetails(c_service_string.as_ptr(), &mut details) };
+fn service_entry(running: bool, details: &ServiceDetails) -> ServiceEntry {
+    let service_display_name = details.str(details.service_display_name).into_owned();
+    let service_name = details.str(details.service_name);
+    let executable_path = details.str(details.executable_path);
+    let description = details.str(details.description);
+    let service_type = details.str(details.service_type);
+    let service_account = details.str(details.service_account);
+
+    let mut service_details = format!("Service Name: {}\nService Display Name: {}\nService Type: {}\nService Executable Path: {}\nService Description: {}\nService Account: {}", service_name, service_display_name, service_type, executable_path, description, service_account);
+    service_details.push_str(&format_runtime_details(details));
+
+    ServiceEntry {
+        status: if running { Status::Active } else { Status::Inactive },
+        display_name: service_display_name,
+        details: service_details,
+        control_group: details.str(details.control_group).into_owned(),
+        #[cfg(target_os = "linux")]
+        exec: integrity::Exec::of(details),
+    }
+}
 
-                let service_display_name = unsafe { CStr::from_ptr(details.service_display_name.as_ptr()).to_string_lossy().to_string() };
-                let service_name = unsafe { CStr::from_ptr(details.service_name.as_ptr()).to_string_lossy().to_string() };
-                let executable_path = unsafe { CStr::from_ptr(details.executable_path.as_ptr()).to_string_lossy().to_string() };
-                let description = unsafe { CStr::from_ptr(details.description.as_ptr()).to_string_lossy().to_string() };
-                let service_type = unsafe { CStr::from_ptr(details.service_type.as_ptr()).to_string_lossy().to_string() };
-                let service_account = unsafe { CStr::from_ptr(details.service_account.as_ptr()).to_string_lossy().to_string() };
+/// Extra lines for the fields only the systemd backend fills in.
+fn format_runtime_details(details: &ServiceDetails) -> String {
+    let active_state = details.str(details.active_state);
+    if active_state.is_empty() {
+        return String::new();
+    }
+    let sub_state = details.str(details.sub_state);
 
-                let service_details = format!("Service Name: {}\nService Display Name: {}\nService Type: {}\nService Executable Path: {}\nService Description: {}\nService Account: {}", service_name, service_display_name, service_type, executable_path, description, service_account);
+    let mut lines = format!("\nState: {} ({})", active_state, sub_state);
+    if details.main_pid != 0 {
+        lines.push_str(&format!("\nMain PID: {}", details.main_pid));
+    }
+    lines.push_str(&format!("\nRestarts: {}", details.restart_count));
+    lines.push_str(&format!("\nMemory: {}", format_bytes(details.memory_current)));
+    lines.push_str(&format!("\nCPU Time: {}", format_nsec(details.cpu_usage_nsec)));
+    if active_state == "active" {
+        lines.push_str(&format!("\nActive Since: {}", format_timestamp(details.active_enter_timestamp)));
+    } else {
+        lines.push_str(&format!("\nInactive Since: {}", format_timestamp(details.active_exit_timestamp)));
+    }
+    lines.push_str(&format!("\nLast State Change: {}", format_timestamp(details.state_change_timestamp)));
+    lines
+}
 
-                if get_status {
-                    services_.push((Status::Active, service_display_name, service_details));
-                } else {
-                    services_.push((Status::Inactive, service_display_name, service_details));
-                }
-            }
-        }
+/// systemd reports unset counters as u64::MAX.
+fn format_bytes(bytes: u64) -> String {
+    if bytes == u64::MAX {
+        return "n/a".to_string();
+    }
+    const UNITS: [&str; 5] = ["B", "K", "M", "G", "T"];
+    let mut value = bytes as f64;
+    let mut unit = 0;
+    while value >= 1024.0 && unit < UNITS.len() - 1 {
+        value /= 1024.0;
+        unit += 1;
+    }
+    if unit == 0 {
+        format!("{}{}", bytes, UNITS[0])
+    } else {
+        format!("{:.1}{}", value, UNITS[unit])
+    }
+}
 
-        break;
+fn format_nsec(nsec: u64) -> String {
+    if nsec == u64::MAX {
+        return "n/a".to_string();
+    }
+    let msec = nsec / 1_000_000;
+    if msec < 1000 {
+        format!("{}ms", msec)
+    } else {
+        format!("{}.{:03}s", msec / 1000, msec % 1000)
     }
+}
 
-    services_
+/// Formats a CLOCK_REALTIME timestamp in microseconds as UTC.
+fn format_timestamp(usec: u64) -> String {
+    if usec == 0 || usec == u64::MAX {
+        return "n/a".to_string();
+    }
+    let secs = usec / 1_000_000;
+    let days = (secs / 86_400) as i64;
+    let rem = secs % 86_400;
+
+    // Civil-from-days, see http://howardhinnant.github.io/date_algorithms.html
+    let z = days + 719_468;
+    let era = z.div_euclid(146_097);
+    let doe = z.rem_euclid(146_097);
+    let yoe = (doe - doe / 1460 + doe / 36_524 - doe / 146_096) / 365;
+    let doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    let mp = (5 * doy + 2) / 153;
+    let day = doy - (153 * mp + 2) / 5 + 1;
+    let month = if mp < 10 { mp + 3 } else { mp - 9 };
+    let year = yoe + era * 400 + if month <= 2 { 1 } else { 0 };
+
+    format!(
+        "{:04}-{:02}-{:02} {:02}:{:02}:{:02} UTC",
+        year, month, day, rem / 3600, (rem % 3600) / 60, rem % 60
+    )
 }
 
 fn wchar_to_string(wchar_ptr: *const wchar_t) -> String {
@@ -283,63 +1757,493 @@ fn c_char_to_string(cstr: *const c_char) -> String {
 
 impl App {
     fn new() -> Self {
+        // On Linux the list starts empty and arrives from the backend.
+        #[cfg(target_os = "linux")]
+        let (items, backend) = (Vec::new(), backend::Worker::start());
+        #[cfg(target_os = "linux")]
+        backend.reload();
+        #[cfg(not(target_os = "linux"))]
+        let items = load_status_items();
 
-        let services = get_service_details();
+        Self {
+            should_exit: false,
+            show_stats: false,
+            status_list: StatusList::from_iter(items),
+            details: DetailsCache::default(),
+            metrics: Metrics::default(),
+            #[cfg(target_os = "linux")]
+            dependencies: Dependencies::default(),
+            #[cfg(target_os = "linux")]
+            journal: Journal::open(),
+            #[cfg(target_os = "linux")]
+            backend,
+            #[cfg(target_os = "linux")]
+            loading: Loading { list: true, ..Loading::default() },
+            search: search::Search::default(),
+            list_height: 0,
+        }
+    }
 
+    /// An app over `items` that loads nothing: no listing, no journal, no requests until asked.
+    #[cfg(all(feature = "bench", target_os = "linux"))]
+    fn with_items(items: Vec<StatusItem>) -> Self {
         Self {
             should_exit: false,
-            status_list: StatusList::from_iter(services)
+            show_stats: false,
+            status_list: StatusList::from_iter(items),
+            details: DetailsCache::default(),
+            metrics: Metrics::default(),
+            dependencies: Dependencies::default(),
+            journal: Journal { tail: std::ptr::null_mut(), unit_name: String::new(), lines: Vec::new() },
+            backend: backend::Worker::start(),
+            loading: Loading::default(),
+            search: search::Search::default(),
+            list_height: 0,
+        }
+    }
+
+    /// Lists the units again. On Linux the current list stays up until the new one
+    /// arrives; anything still loading for it is cancelled.
+    fn reload(&mut self) {
+        #[cfg(target_os = "linux")]
+        {
+            self.backend.reload();
+            self.loading = Loading { list: true, ..Loading::default() };
+            self.dependencies.clear();
+        }
+        #[cfg(not(target_os = "linux"))]
+        self.set_items(load_status_items());
+    }
+
+    fn set_items(&mut self, items: Vec<StatusItem>) {
+        let selected = self.selected_unit_name();
+        self.status_list = StatusList::from_iter(items);
+        self.details.clear();
+        self.search.invalidate();
+        if self.search.active() {
+            self.refilter(selected);
+        } else if let Some(unit_name) = selected {
+            // A list that arrives while browsing keeps the cursor on the same unit.
+            let row = self.status_list.items.iter().position(|item| item.unit_name == unit_name);
+            self.status_list.state.select(row);
+        }
+    }
+
+    /// Applies the search query, keeping `keep` selected if it is still shown.
+    fn refilter(&mut self, keep: Option<String>) {
+        self.status_list.rows = self.search.filter(&self.status_list.items);
+
+        let list = &self.status_list;
+        let row = keep
+            .and_then(|unit_name| (0..list.len()).find(|&row| list.items[list.item_index(row)].unit_name == unit_name))
+            .or(if list.len() > 0 { Some(0) } else { None });
+        self.status_list.state = ListState::default().with_selected(row);
+    }
+
+    fn selected_unit_name(&self) -> Option<String> {
+        self.status_list.selected_item().map(|item| item.unit_name.clone())
+    }
+}
+
+impl StatusList {
+    /// Number of rows shown.
+    fn len(&self) -> usize {
+        self.rows.as_ref().map_or(self.items.len(), Vec::len)
+    }
+
+    fn item_index(&self, row: usize) -> usize {
+        self.rows.as_ref().map_or(row, |rows| rows[row])
+    }
+
+    fn selected_item(&self) -> Option<&StatusItem> {
+        self.state.selected().filter(|&row| row < self.len()).map(|row| &self.items[self.item_index(row)])
+    }
+
+    /// Updates the status of `unit_name` in place, or appends it for a new unit.
+    #[cfg(target_os = "linux")]
+    fn upsert(&mut self, unit_name: &str, entry: &ServiceEntry) {
+        let item = match self.items.iter().position(|item| item.unit_name == unit_name) {
+            Some(index) => &mut self.items[index],
+            None => {
+                self.items.push(StatusItem::new(entry.status, &entry.display_name, unit_name, ""));
+                self.items.last_mut().unwrap()
+            }
+        };
+        item.set_status(entry.status);
+        item.control_group.clone_from(&entry.control_group);
+    }
+
+    /// Removes the item for `unit_name`, keeping the selection on the same item where possible.
+    #[cfg(target_os = "linux")]
+    fn remove(&mut self, unit_name: &str) {
+        let Some(index) = self.items.iter().position(|item| item.unit_name == unit_name) else {
+            return;
+        };
+        self.items.remove(index);
+
+        match self.state.selected() {
+            Some(selected) if selected > index => self.state.select(Some(selected - 1)),
+            Some(selected) if selected >= self.items.len() => self.state.select(self.items.len().checked_sub(1)),
+            _ => {}
         }
     }
 }
 
-impl FromIterator<(Status, String, String)> for StatusList {
-    fn from_iter<I: IntoIterator<Item = (Status, String, String)>>(iter: I) -> Self {
-        let items = iter
-            .into_iter()
-            .map(|(status, service_name, description)| StatusItem::new(status, &service_name, &description))
-            .collect();
+impl FromIterator<StatusItem> for StatusList {
+    fn from_iter<I: IntoIterator<Item = StatusItem>>(iter: I) -> Self {
+        let items = iter.into_iter().collect();
         let state = ListState::default();
-        Self { items, state }
+        Self { items, state, rows: None }
     }
 }
 
 impl StatusItem {
-    fn new(status: Status, service_name: &str, description: &str) -> Self {
+    fn new(status: Status, service_name: &str, unit_name: &str, object_path: &str) -> Self {
         Self {
             status,
             service_name: service_name.to_string(),
-            description: description.to_string(),
+            unit_name: unit_name.to_string(),
+            object_path: object_path.to_string(),
+            summary: String::new(),
+            description: None,
+            control_group: String::new(),
+            label: StatusItem::label_for(status, service_name),
+        }
+    }
+
+    fn label_for(status: Status, service_name: &str) -> String {
+        match status {
+            Status::Inactive => format!(" x {}", service_name),
+            Status::Active => format!(" o {}", service_name),
+        }
+    }
+
+    fn set_status(&mut self, status: Status) {
+        if self.status != status {
+            self.status = status;
+            self.label = StatusItem::label_for(status, &self.service_name);
+        }
+    }
+
+    /// An item whose details come with it instead of being fetched later.
+    fn loaded(running: bool, unit_name: &str, details: &ServiceDetails) -> Self {
+        let entry = service_entry(running, details);
+        Self {
+            summary: details.str(details.description).into_owned(),
+            description: Some(entry.details),
+            ..Self::new(entry.status, &entry.display_name, unit_name, "")
         }
     }
 }
 
+#[cfg(target_os = "linux")]
+impl From<ServiceUnit> for StatusItem {
+    fn from(unit: ServiceUnit) -> Self {
+        let status = if unit.active_state == "active" { Status::Active } else { Status::Inactive };
+        // Only services drop their suffix; `foo.timer` next to `foo.service` must stay distinguishable.
+        let service_name = unit.name.strip_suffix(".service").unwrap_or(&unit.name);
+        StatusItem { summary: unit.description, ..StatusItem::new(status, service_name, &unit.name, &unit.object_path) }
+    }
+}
+
+/// How long the UI waits for a key before checking for live updates.
+const EVENT_POLL_INTERVAL: Duration = Duration::from_millis(250);
+
+/// The same while the backend is working, so its results show up as they stream in.
+#[cfg(target_os = "linux")]
+const LOADING_POLL_INTERVAL: Duration = Duration::from_millis(25);
+
+#[cfg(target_os = "linux")]
+const SERVICE_EVENT_BATCH: usize = 256;
+
 impl App {
     fn run(&mut self, mut terminal: Terminal<impl Backend>) -> io::Result<()> {
+        let mut dirty = true;
+
         while !self.should_exit {
-            terminal.draw(|f| f.render_widget(&mut *self, f.size()))?;
-            if let Event::Key(key) = event::read()? {
-                self.handle_key(key);
-            };
+            if dirty {
+                terminal.draw(|f| f.render_widget(&mut *self, f.size()))?;
+                dirty = false;
+
+                // The first frame only needs names; details follow for whatever is on screen.
+                #[cfg(target_os = "linux")]
+                {
+                    self.request_visible_details();
+                    if self.dependencies.needs_graph() {
+                        self.dependencies.graph = GraphState::Loading;
+                        self.backend.send(backend::Request::Graph);
+                    }
+                }
+            }
+
+            #[cfg(target_os = "linux")]
+            let timeout = if self.busy() { LOADING_POLL_INTERVAL } else { EVENT_POLL_INTERVAL };
+            #[cfg(not(target_os = "linux"))]
+            let timeout = EVENT_POLL_INTERVAL;
+
+            if event::poll(timeout)? {
+                if let Event::Key(key) = event::read()? {
+                    self.handle_key(key);
+                };
+                dirty = true;
+            }
+            #[cfg(target_os = "linux")]
+            {
+                dirty |= self.receive();
+                // Updates wait for a list being loaded, which would otherwise replace them.
+                if !self.loading.list {
+                    dirty |= self.apply_service_events();
+                }
+                dirty |= self.show_stats;
+                dirty |= self.journal.refresh(self.status_list.selected_item().map(|item| item.unit_name.as_str()));
+                if self.metrics.due() {
+                    self.metrics.sample(&self.status_list.items);
+                    dirty = true;
+                }
+            }
         }
         Ok(())
     }
 
+    /// Patches the items named in pending live updates; returns whether anything changed.
+    /// After the watch reconnected, updates may have been missed, so the list is reloaded.
+    #[cfg(target_os = "linux")]
+    fn apply_service_events(&mut self) -> bool {
+        let mut updates: Vec<(String, Option<ServiceEntry>)> = Vec::new();
+        let mut resync = false;
+        let query = SERVICES.lock().unwrap();
+
+        loop {
+            let mut events: Vec<ServiceEvent> = Vec::with_capacity(SERVICE_EVENT_BATCH);
+            let count = unsafe { pollServiceEvents(events.as_mut_ptr(), SERVICE_EVENT_BATCH) };
+            unsafe { events.set_len(count) };
+
+            for event in &events {
+                if event.kind == SERVICE_EVENT_RESYNC {
+                    resync = true;
+                    continue;
+                }
+                let entry = if event.kind == SERVICE_EVENT_REMOVED {
+                    None
+                } else if let Some(details) = unsafe { event.details.as_ref() } {
+                    // A unit that left the filtered states leaves the list, one that entered them joins it.
+                    if !query.matches_states(&details.str(details.load_state), &details.str(details.active_state), &details.str(details.sub_state)) {
+                        None
+                    } else {
+                        Some(service_entry(event.running, details))
+                    }
+                } else {
+                    continue;
+                };
+                updates.push((c_char_to_string(event.name), entry));
+            }
+
+            unsafe { freeServiceEvents(events.as_mut_ptr(), count) };
+
+            if count < SERVICE_EVENT_BATCH {
+                break;
+            }
+        }
+
+        drop(query);
+
+        if resync {
+            // The reload replaces every item, so the updates before it need not be applied.
+            self.reload();
+            return true;
+        }
+        if updates.is_empty() {
+            return false;
+        }
+
+        // Rows index into the items, so a search is set aside while they change and redone after.
+        let selected = self.selected_unit_name();
+        let searching = self.status_list.rows.take().is_some();
+        if searching {
+            self.status_list.state.select(None);
+        }
+
+        for (unit_name, entry) in updates {
+            match entry {
+                None => self.status_list.remove(&unit_name),
+                Some(entry) => {
+                    self.status_list.upsert(&unit_name, &entry);
+                    self.details.insert(&unit_name, entry.details);
+                }
+            }
+        }
+
+        self.search.invalidate();
+        if searching {
+            self.refilter(selected);
+        }
+        true
+    }
+
+    /// Whether anything asked of the backend is still outstanding.
+    #[cfg(target_os = "linux")]
+    fn busy(&self) -> bool {
+        self.loading.list || !self.loading.details.is_empty() || matches!(self.dependencies.graph, GraphState::Loading)
+    }
+
+    /// What the backend is working on, for the header.
+    #[cfg(target_os = "linux")]
+    fn progress(&self) -> Option<String> {
+        if self.loading.list {
+            Some("Loading units...".to_string())
+        } else if !self.loading.details.is_empty() {
+            Some(format!("Loading details of {} units...", self.loading.details.len()))
+        } else if matches!(self.dependencies.graph, GraphState::Loading) {
+            Some("Loading the dependency graph...".to_string())
+        } else {
+            None
+        }
+    }
+
+    /// Asks for details of the rows in and around the viewport that have none and are not
+    /// already on their way; they arrive in batches through `receive`.
+    #[cfg(target_os = "linux")]
+    fn request_visible_details(&mut self) {
+        // Rows of a list about to be replaced are not worth asking for.
+        if self.loading.list {
+            return;
+        }
+
+        let list = &self.status_list;
+        let items = &list.items;
+        let offset = list.state.offset();
+        let start = offset.saturating_sub(PREFETCH_ROWS);
+        let end = (offset + self.list_height + PREFETCH_ROWS).min(list.len());
+        let selected = list.state.selected().filter(|&row| row < list.len());
+
+        let mut missing: Vec<(usize, String, String)> = Vec::new();
+        for row in (start..end).chain(selected.filter(|&row| row < start || row >= end)) {
+            let i = list.item_index(row);
+            let item = &items[i];
+            if item.description.is_none() && !self.loading.details.contains(&item.unit_name) && !self.details.touch(&item.unit_name) {
+                missing.push((i, item.unit_name.clone(), item.object_path.clone()));
+            }
+        }
+        if missing.is_empty() {
+            return;
+        }
+
+        self.loading.details.extend(missing.iter().map(|(_, unit_name, _)| unit_name.clone()));
+        self.backend.send(backend::Request::Details(missing));
+    }
+
+    /// Applies what the backend sent since the last tick; returns whether anything changed.
+    #[cfg(target_os = "linux")]
+    fn receive(&mut self) -> bool {
+        let responses = self.backend.poll();
+        let changed = !responses.is_empty();
+
+        for response in responses {
+            match response {
+                backend::Response::Items(items) => {
+                    self.loading.list = false;
+                    self.set_items(items);
+                }
+                backend::Response::Details(batch) => {
+                    let mut status_changed = false;
+                    for (index, unit_name, entry) in batch {
+                        self.loading.details.remove(&unit_name);
+                        status_changed |= self.apply_details(index, &unit_name, entry);
+                    }
+                    // The search matches on state, so fresh states redo it, as live updates do.
+                    if status_changed {
+                        self.search.invalidate();
+                        if self.search.active() {
+                            self.refilter(self.selected_unit_name());
+                        }
+                    }
+                }
+                backend::Response::Graph(graph) => self.dependencies.set_graph(graph),
+            }
+        }
+        changed
+    }
+
+    /// Stores the details of the item at `index`, or wherever updates since moved it.
+    /// Returns whether the item's status changed.
+    #[cfg(target_os = "linux")]
+    fn apply_details(&mut self, index: usize, unit_name: &str, entry: Option<ServiceEntry>) -> bool {
+        let items = &mut self.status_list.items;
+        let index = match items.get(index) {
+            Some(item) if item.unit_name == unit_name => Some(index),
+            _ => items.iter().position(|item| item.unit_name == unit_name),
+        };
+
+        // Failures are cached too, so an unloadable unit is not asked for on every frame.
+        let mut status_changed = false;
+        let description = match entry {
+            Some(entry) => {
+                if let Some(item) = index.map(|index| &mut items[index]) {
+                    status_changed = item.status != entry.status;
+                    item.set_status(entry.status);
+                    item.control_group = entry.control_group;
+                }
+                entry.details
+            }
+            None => format!("Service Name: {}\nNo details available.", unit_name),
+        };
+        self.details.insert(unit_name, description);
+        status_changed
+    }
+
     fn handle_key(&mut self, key: KeyEvent) {
         if key.kind != KeyEventKind::Press {
             return;
         }
+        if self.search.editing {
+            self.handle_search_key(key);
+            return;
+        }
         match key.code {
+            KeyCode::Esc if self.search.active() => self.clear_search(),
             KeyCode::Char('q') | KeyCode::Char('Q') | KeyCode::Esc  => self.should_exit = true,
-            KeyCode::Char('r') | KeyCode::Char('R') => self.status_list = StatusList::from_iter(get_service_details()),
+            KeyCode::Char('/') => self.search.editing = true,
+            KeyCode::Char('r') | KeyCode::Char('R') => self.reload(),
             KeyCode::Char('h') | KeyCode::Left => self.select_none(),
             KeyCode::Char('j') | KeyCode::Down => self.select_next(),
             KeyCode::Char('k') | KeyCode::Up => self.select_previous(),
             KeyCode::Char('g') | KeyCode::Char('G') | KeyCode::Home => self.select_first(),
+            #[cfg(target_os = "linux")]
+            KeyCode::Char('s') | KeyCode::Char('S') => self.show_stats = !self.show_stats,
+            #[cfg(target_os = "linux")]
+            KeyCode::Char('d') | KeyCode::Char('D') => self.dependencies.cycle(),
             _ => {}
         }
     }
 
+    /// Keys while the search box has focus: text edits the query, the list still scrolls.
+    fn handle_search_key(&mut self, key: KeyEvent) {
+        match key.code {
+            KeyCode::Enter => self.search.editing = false,
+            KeyCode::Esc => self.clear_search(),
+            KeyCode::Down => self.select_next(),
+            KeyCode::Up => self.select_previous(),
+            KeyCode::Backspace => {
+                let selected = self.selected_unit_name();
+                self.search.query.pop();
+                self.refilter(selected);
+            }
+            KeyCode::Char(c) => {
+                let selected = self.selected_unit_name();
+                self.search.query.push(c);
+                self.refilter(selected);
+            }
+            _ => {}
+        }
+    }
+
+    fn clear_search(&mut self) {
+        let selected = self.selected_unit_name();
+        self.search.editing = false;
+        self.search.query.clear();
+        self.refilter(selected);
+    }
+
     fn select_none(&mut self) {
         self.status_list.state.select(None);
     }
@@ -370,28 +2274,159 @@ impl Widget for &mut App {
         let [list_area, item_area] =
             Layout::vertical([Constraint::Fill(1), Constraint::Fill(1)]).areas(main_area);
 
-        App::render_header(header_area, buf);
-        App::render_footer(footer_area, buf);
+        self.render_header(header_area, buf);
+        self.render_footer(footer_area, buf);
         self.render_list(list_area, buf);
+
+        #[cfg(target_os = "linux")]
+        let item_area = if self.journal.available() {
+            let [item_area, journal_area] =
+                Layout::vertical([Constraint::Fill(1), Constraint::Fill(1)]).areas(item_area);
+            self.render_journal(journal_area, buf);
+            item_area
+        } else {
+            item_area
+        };
+
+        #[cfg(target_os = "linux")]
+        if let (Some(view), Some(item)) = (self.dependencies.view, self.status_list.selected_item()) {
+            let lines = self.dependencies.lines(&item.unit_name);
+            App::render_dependencies(view, lines, item_area, buf);
+        } else {
+            self.render_selected_item(item_area, buf);
+        }
+        #[cfg(not(target_os = "linux"))]
         self.render_selected_item(item_area, buf);
+
+        #[cfg(target_os = "linux")]
+        if self.show_stats {
+            App::render_stats(main_area, buf);
+        }
     }
 }
 
 /// Rendering logic for the app
 impl App {
-    fn render_header(area: Rect, buf: &mut Buffer) {
-        Paragraph::new("Service Viewer List")
-            .bold()
+    fn render_header(&self, area: Rect, buf: &mut Buffer) {
+        // The second line says what the backend is still loading.
+        #[cfg(target_os = "linux")]
+        let progress = self.progress();
+        #[cfg(not(target_os = "linux"))]
+        let progress: Option<String> = None;
+
+        let title = Line::raw("Service Viewer List").bold();
+        Paragraph::new(Text::from_iter(std::iter::once(title).chain(progress.map(|progress| Line::raw(progress).italic()))))
             .centered()
             .render(area, buf);
     }
 
-    fn render_footer(area: Rect, buf: &mut Buffer) {
-        Paragraph::new("Use ↓↑ to move, ← to unselect, → to change status, g/G to go top/bottom, r/R to refresh, q/Q to exit.")
+    fn render_footer(&self, area: Rect, buf: &mut Buffer) {
+        if self.search.active() {
+            let cursor = if self.search.editing { "_" } else { "" };
+            let hint = if self.search.editing { "Enter to browse the matches" } else { "/ to edit" };
+            Paragraph::new(format!(
+                "/{}{}  ({} of {})  {}, Esc to clear.",
+                self.search.query,
+                cursor,
+                self.status_list.len(),
+                self.status_list.items.len(),
+                hint
+            ))
+            .render(area, buf);
+            return;
+        }
+
+        let text = if cfg!(target_os = "linux") {
+            "Use ↓↑ to move, ← to unselect, → to change status, g/G to go top/bottom, / to search, r/R to refresh, d/D for dependencies, s/S for call stats, q/Q to exit."
+        } else {
+            "Use ↓↑ to move, ← to unselect, → to change status, g/G to go top/bottom, / to search, r/R to refresh, q/Q to exit."
+        };
+        Paragraph::new(text)
             .centered()
             .render(area, buf);
     }
 
+    /// Overlay with the latency of every native call made so far.
+    #[cfg(target_os = "linux")]
+    fn render_stats(area: Rect, buf: &mut Buffer) {
+        let format_ns = |ns: u64| format!("{:.1?}", Duration::from_nanos(ns));
+        let mut lines = vec![Line::raw(format!(
+            "{:<24} {:>8} {:>6} {:>10} {:>10} {:>10} {:>10}",
+            "call", "calls", "errors", "mean", "p50", "p99", "max"
+        ))
+        .bold()];
+        for stat in service_viewer_stats().iter().filter(|stat| stat.calls > 0) {
+            lines.push(Line::raw(format!(
+                "{:<24} {:>8} {:>6} {:>10} {:>10} {:>10} {:>10}",
+                stat.name(),
+                stat.calls,
+                stat.errors,
+                format_ns(stat.mean_ns()),
+                format_ns(stat.percentile_ns(50)),
+                format_ns(stat.percentile_ns(99)),
+                format_ns(stat.max_ns)
+            )));
+        }
+
+        let width = area.width.min(88);
+        let height = area.height.min(lines.len() as u16 + 2);
+        let popup = Rect::new(area.x + (area.width - width) / 2, area.y + (area.height - height) / 2, width, height);
+
+        let block = Block::bordered()
+            .title(Line::raw("Call Stats").centered())
+            .border_style(TODO_HEADER_STYLE)
+            .bg(NORMAL_ROW_BG);
+
+        Clear.render(popup, buf);
+        Paragraph::new(lines)
+            .block(block)
+            .fg(TEXT_FG_COLOR)
+            .render(popup, buf);
+    }
+
+    /// The selected unit's dependency tree in place of its description.
+    #[cfg(target_os = "linux")]
+    fn render_dependencies(view: DependencyView, lines: &[String], area: Rect, buf: &mut Buffer) {
+        let block = Block::new()
+            .title(Line::raw(view.title()).centered())
+            .borders(Borders::TOP)
+            .border_set(symbols::border::EMPTY)
+            .border_style(TODO_HEADER_STYLE)
+            .bg(NORMAL_ROW_BG)
+            .padding(Padding::horizontal(1));
+
+        // Only what fits is drawn; a unit can pull in most of the system.
+        let height = block.inner(area).height as usize;
+        Paragraph::new(Text::from_iter(lines.iter().take(height).map(|line| Line::raw(line.as_str()))))
+            .block(block)
+            .fg(TEXT_FG_COLOR)
+            .render(area, buf);
+    }
+
+    /// The newest journal lines of the selected unit that fit, oldest at the top.
+    #[cfg(target_os = "linux")]
+    fn render_journal(&self, area: Rect, buf: &mut Buffer) {
+        let block = Block::new()
+            .title(Line::raw("Journal").centered())
+            .borders(Borders::TOP)
+            .border_set(symbols::border::EMPTY)
+            .border_style(TODO_HEADER_STYLE)
+            .bg(NORMAL_ROW_BG)
+            .padding(Padding::horizontal(1));
+
+        let height = block.inner(area).height as usize;
+        let lines = &self.journal.lines[self.journal.lines.len().saturating_sub(height)..];
+        let text = if lines.is_empty() && self.status_list.selected_item().is_some() {
+            Text::raw("No journal entries.")
+        } else {
+            Text::from_iter(lines.iter().map(|line| Line::raw(line.as_str())))
+        };
+        Paragraph::new(text)
+            .block(block)
+            .fg(TEXT_FG_COLOR)
+            .render(area, buf);
+    }
+
     fn render_list(&mut self, area: Rect, buf: &mut Buffer) {
         let block = Block::new()
             .title(Line::raw("Service List").centered())
@@ -399,44 +2434,79 @@ impl App {
             .border_set(symbols::border::EMPTY)
             .border_style(TODO_HEADER_STYLE)
             .bg(NORMAL_ROW_BG);
-
-        // Iterate through all elements in the `items` and stylize them.
-        let items: Vec<ListItem> = self
-            .status_list
-            .items
-            .iter()
-            .enumerate()
-            .map(|(i, todo_item)| {
-                let color = alternate_colors(i);
+        self.list_height = block.inner(area).height as usize;
+
+        // Only the rows in the viewport are built, so a frame costs the same for 100 or
+        // 100k units. Scrolling is done here, since `List` only ever sees the window.
+        let len = self.status_list.len();
+        let height = self.list_height.max(1);
+        let state = &mut self.status_list.state;
+        let selected = state.selected().map(|i| i.min(len.saturating_sub(1))).filter(|_| len > 0);
+        state.select(selected);
+
+        let mut offset = state.offset().min(len.saturating_sub(height));
+        if let Some(selected) = selected {
+            if selected < offset {
+                offset = selected;
+            } else if selected >= offset + height {
+                offset = selected + 1 - height;
+            }
+        }
+        *state.offset_mut() = offset;
+
+        let end = (offset + height).min(len);
+        let list = &self.status_list;
+        let items: Vec<ListItem> = (offset..end)
+            .map(|row| (row, &list.items[list.item_index(row)]))
+            .map(|(row, todo_item)| {
+                let color = alternate_colors(row);
+                let text: Cow<str> = match self.metrics.get(&todo_item.unit_name) {
+                    Some(usage) => Cow::Owned(format!("{:<48} {}", todo_item.label, usage.summary())),
+                    None => Cow::Borrowed(todo_item.label.as_str()),
+                };
                 let line = match todo_item.status {
-                    Status::Inactive => Line::styled(format!(" x {}", todo_item.service_name), INACTIVE_TEXT_FG_COLOR),
-                    Status::Active => Line::styled(format!(" o {}", todo_item.service_name), RUNNING_TEXT_FG_COLOR),
+                    Status::Inactive => Line::styled(text, INACTIVE_TEXT_FG_COLOR),
+                    Status::Active => Line::styled(text, RUNNING_TEXT_FG_COLOR),
                 };
                 ListItem::new(line.bg(color)) // Apply color styling here
             })
             .collect();
 
-        // Create a List from all list items and highlight the currently selected one
+        // Create a List from the visible items and highlight the currently selected one
         let list = List::new(items)
             .block(block)
             .highlight_style(SELECTED_STYLE)
             .highlight_symbol(">")
             .highlight_spacing(HighlightSpacing::Always);
 
+        let mut window_state = ListState::default().with_selected(selected.map(|i| i - offset));
+
         // We need to disambiguate this trait method as both `Widget` and `StatefulWidget` share the
         // same method name `render`.
-        StatefulWidget::render(list, area, buf, &mut self.status_list.state);
+        StatefulWidget::render(list, area, buf, &mut window_state);
     }
 
     fn render_selected_item(&self, area: Rect, buf: &mut Buffer) {
-        // We get the info depending on the item's state.
-        let info = if let Some(i) = self.status_list.state.selected() {
-            match self.status_list.items[i].status {
-                Status::Active => format!("o Active\n{}", self.status_list.items[i].description),
-                Status::Inactive => format!("x Inactive\n{}", self.status_list.items[i].description),
-            }
+        // We get the info depending on the item's state; the lines borrow the cached text.
+        let info = if let Some(item) = self.status_list.selected_item() {
+            let description = item
+                .description
+                .as_deref()
+                .or_else(|| self.details.get(&item.unit_name))
+                .unwrap_or("Loading details...");
+            let status = match item.status {
+                Status::Active => "o Active",
+                Status::Inactive => "x Inactive",
+            };
+            let usage = self.metrics.get(&item.unit_name).map(Usage::lines).into_iter().flatten();
+            Text::from_iter(
+                std::iter::once(status)
+                    .chain(description.lines())
+                    .map(Line::raw)
+                    .chain(usage.map(Line::raw)),
+            )
         } else {
-            "Nothing selected...".to_string()
+            Text::raw("Nothing selected...")
         };
 
         // We show the list item's info under the list in this paragraph
@@ -517,4 +2587,6 @@ mod tui {
         stdout().execute(LeaveAlternateScreen)?;
         disable_raw_mode()
     }
-}
\ No newline at end of file
+}
+
+mod search;
@@ -0,0 +1,501 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <fnmatch.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "service.h"
+#include "unit_file.h"
+#include "unit_cache.h"
+#include "stats.h"
+#include "util.h"
+#include "work_pool.h"
+
+/*
+ * Offline backend: reads the unit files of a root file system (a chroot or
+ * an unpacked container image) the way systemd would find them, without a
+ * running manager. The search directories are scanned and then the units
+ * parsed on the shared worker pool (work_pool.c), all sharing one UnitCache.
+ */
+
+/* System unit search path, highest priority first (see systemd.unit(5)). */
+static const char* const unit_search_paths[] = {
+    "/etc/systemd/system.control",
+    "/run/systemd/system.control",
+    "/run/systemd/transient",
+    "/etc/systemd/system",
+    "/run/systemd/system",
+    "/usr/local/lib/systemd/system",
+    "/usr/lib/systemd/system",
+    "/lib/systemd/system",
+};
+
+#define SEARCH_PATH_COUNT (sizeof(unit_search_paths) / sizeof(unit_search_paths[0]))
+#define OFFLINE_MAX_SYMLINKS 8
+
+/* One file or symlink found in a search directory. */
+typedef struct {
+    char *name;
+    char *path;         /* file to parse, NULL if masked */
+    char *target_name;  /* name of the file `path` points to; differs from name for aliases */
+    size_t priority;
+    bool masked;
+} FoundUnit;
+
+typedef struct {
+    const char *root;
+    size_t priority;
+    const char *dir;    /* inside root */
+    FoundUnit *units;
+    size_t count;
+    size_t capacity;
+} DirScan;
+
+static UnitCacheStats last_cache_stats;
+
+static void free_found_unit(FoundUnit* unit) {
+    free(unit->name);
+    free(unit->path);
+    free(unit->target_name);
+}
+
+static bool is_unit_name(const char* name) {
+    const char *dot = strrchr(name, '.');
+    return dot && dot != name && dot[1] != '\0' && strcmp(dot, ".d") != 0 && strcmp(dot, ".wants") != 0 &&
+        strcmp(dot, ".requires") != 0 && strcmp(dot, ".upholds") != 0;
+}
+
+/*
+ * Follows `path`, inside `root`, through symlinks. Its directory is looked
+ * up with resolveInRoot(), and absolute link targets start over at `root`,
+ * so nothing outside the image is read. Sets *masked for links to
+ * /dev/null and for empty files, which systemd both treats as masks.
+ */
+static char* resolve_unit_path(const char* root, const char* path, bool* masked) {
+    char current[PATH_MAX];
+    struct stat st;
+
+    *masked = false;
+    int written = snprintf(current, sizeof(current), "%s", path);
+    if (written < 0 || (size_t)written >= sizeof(current)) {
+        return NULL;
+    }
+
+    for (int hops = 0; hops <= OFFLINE_MAX_SYMLINKS; hops++) {
+        char parent[PATH_MAX];
+        char file[PATH_MAX];
+        char target[PATH_MAX];
+        const char *slash = strrchr(current, '/');
+        ssize_t length;
+
+        /* The last component is looked at here, so a link to /dev/null is seen as one. */
+        snprintf(parent, sizeof(parent), "%.*s", slash > current ? (int)(slash - current) : 1, current);
+        char *dir = resolveInRoot(root, parent);
+        if (dir == NULL) {
+            return NULL;
+        }
+        written = snprintf(file, sizeof(file), "%s/%s", dir, slash + 1);
+        free(dir);
+        if (written < 0 || (size_t)written >= sizeof(file)) {
+            return NULL;
+        }
+
+        if (lstat(file, &st) < 0) {
+            return NULL;
+        }
+
+        if (!S_ISLNK(st.st_mode)) {
+            if (S_ISREG(st.st_mode) && st.st_size == 0) {
+                *masked = true;
+                return NULL;
+            }
+            return S_ISREG(st.st_mode) ? strdup(file) : NULL;
+        }
+
+        length = readlink(file, target, sizeof(target) - 1);
+        if (length < 0) {
+            return NULL;
+        }
+        target[length] = '\0';
+
+        if (strcmp(target, "/dev/null") == 0) {
+            *masked = true;
+            return NULL;
+        }
+
+        char next[PATH_MAX];
+        if (target[0] == '/') {
+            written = snprintf(next, sizeof(next), "%s", target);
+        } else {
+            written = snprintf(next, sizeof(next), "%s/%s", parent, target);
+        }
+        if (written < 0 || (size_t)written >= sizeof(next)) {
+            return NULL;
+        }
+        memcpy(current, next, (size_t)written + 1);
+    }
+
+    fprintf(stderr, "Too many levels of symbolic links: %s%s\n", root, path);
+    return NULL;
+}
+
+static void scan_directory(void* context, size_t index) {
+    DirScan *scan = &((DirScan*)context)[index];
+    char *resolved = resolveInRoot(scan->root, scan->dir);
+    DIR *dir = resolved ? opendir(resolved) : NULL;
+    struct dirent *entry;
+
+    free(resolved);
+    if (dir == NULL) {
+        return;
+    }
+
+    while ((entry = readdir(dir)) != NULL) {
+        char path[PATH_MAX];
+        FoundUnit unit = {0};
+
+        if (entry->d_type == DT_DIR || !is_unit_name(entry->d_name)) {
+            continue;
+        }
+
+        int written = snprintf(path, sizeof(path), "%s/%s", scan->dir, entry->d_name);
+        if (written < 0 || (size_t)written >= sizeof(path)) {
+            continue;
+        }
+
+        unit.name = strdup(entry->d_name);
+        unit.priority = scan->priority;
+        unit.path = resolve_unit_path(scan->root, path, &unit.masked);
+
+        if (unit.path == NULL && !unit.masked) {
+            free(unit.name);
+            continue;
+        }
+        if (unit.path) {
+            const char *slash = strrchr(unit.path, '/');
+            unit.target_name = strdup(slash ? slash + 1 : unit.path);
+        }
+
+        if (scan->count == scan->capacity) {
+            size_t capacity = scan->capacity ? scan->capacity * 2 : 256;
+            FoundUnit *temp = realloc(scan->units, capacity * sizeof(FoundUnit));
+            if (temp == NULL) {
+                fprintf(stderr, "Memory allocation failed\n");
+                free_found_unit(&unit);
+                break;
+            }
+            scan->units = temp;
+            scan->capacity = capacity;
+        }
+
+        scan->units[scan->count++] = unit;
+    }
+
+    closedir(dir);
+}
+
+static int compare_found_units(const void* a, const void* b) {
+    const FoundUnit *left = a;
+    const FoundUnit *right = b;
+    int cmp = strcmp(left->name, right->name);
+
+    if (cmp != 0) {
+        return cmp;
+    }
+    return left->priority < right->priority ? -1 : left->priority > right->priority;
+}
+
+static bool name_matches(const char* name, const char* const* patterns, size_t pattern_count) {
+    if (pattern_count == 0) {
+        return true;
+    }
+    for (size_t i = 0; i < pattern_count; i++) {
+        if (fnmatch(patterns[i], name, 0) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static const FoundUnit* find_unit(const FoundUnit* units, size_t count, const char* name) {
+    size_t low = 0;
+    size_t high = count;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        int cmp = strcmp(units[mid].name, name);
+        if (cmp == 0) {
+            return &units[mid];
+        }
+        if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Scans all search directories in parallel and returns one entry per unit
+ * name, taken from the highest-priority directory that has it.
+ */
+static FoundUnit* scan_search_paths(const char* root, size_t* count) {
+    DirScan scans[SEARCH_PATH_COUNT];
+    FoundUnit *units = NULL;
+    size_t total = 0;
+
+    memset(scans, 0, sizeof(scans));
+
+    for (size_t i = 0; i < SEARCH_PATH_COUNT; i++) {
+        scans[i].root = root;
+        scans[i].priority = i;
+        scans[i].dir = unit_search_paths[i];
+    }
+
+    runWork(scan_directory, scans, SEARCH_PATH_COUNT);
+
+    for (size_t i = 0; i < SEARCH_PATH_COUNT; i++) {
+        total += scans[i].count;
+    }
+
+    units = malloc((total ? total : 1) * sizeof(FoundUnit));
+    if (units == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        total = 0;
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < SEARCH_PATH_COUNT; i++) {
+        for (size_t j = 0; j < scans[i].count; j++) {
+            if (units) {
+                units[n++] = scans[i].units[j];
+            } else {
+                free_found_unit(&scans[i].units[j]);
+            }
+        }
+        free(scans[i].units);
+    }
+
+    /* Sorted by name, then priority: the first of each run shadows the rest (e.g. /etc over /usr/lib). */
+    qsort(units, n, sizeof(FoundUnit), compare_found_units);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (kept > 0 && strcmp(units[kept - 1].name, units[i].name) == 0) {
+            free_found_unit(&units[i]);
+            continue;
+        }
+        units[kept++] = units[i];
+    }
+
+    *count = kept;
+    return units;
+}
+
+/* Joins every ExecStart= of the [Service] section, without the `-@:+!` prefixes. */
+static char* join_exec_start(const UnitFile* unit) {
+    size_t size = 1;
+    char *joined;
+
+    for (size_t i = 0; i < unit->count; i++) {
+        if (strcmp(unit->entries[i].key, "ExecStart") == 0 && strcmp(unit->entries[i].section, "Service") == 0) {
+            /* Sized from the string itself, which strcat below copies, not from value_length. */
+            size += strlen(unit->entries[i].value) + 2;
+        }
+    }
+
+    joined = malloc(size);
+    if (joined == NULL) {
+        return NULL;
+    }
+    joined[0] = '\0';
+
+    for (size_t i = 0; i < unit->count; i++) {
+        const char *value = unit->entries[i].value;
+
+        if (strcmp(unit->entries[i].key, "ExecStart") != 0 || strcmp(unit->entries[i].section, "Service") != 0) {
+            continue;
+        }
+
+        while (*value && strchr("-@:+!", *value)) {
+            value++;
+        }
+        if (joined[0]) {
+            strcat(joined, "; ");
+        }
+        strcat(joined, value);
+    }
+
+    return joined;
+}
+
+typedef struct {
+    const FoundUnit **units;
+    ServiceQueryResult *results;
+    size_t count;
+    UnitCache *cache;
+    const char *root;
+} ParseJob;
+
+static void parse_unit(void* context, size_t index) {
+    ParseJob *job = context;
+    const FoundUnit *found = job->units[index];
+    ServiceQueryResult *result = &job->results[index];
+    UnitFile *unit = parseUnitFile(job->cache, job->root, found->path, unit_search_paths, SEARCH_PATH_COUNT);
+
+    if (unit == NULL) {
+        return;
+    }
+
+    const char *type = unitFileGet(unit, "Service", "Type");
+    char *exec_start = join_exec_start(unit);
+
+    result->details = makeServiceDetails(
+        found->target_name,
+        unitFileGet(unit, "Unit", "Description"),
+        exec_start,
+        NULL, /* no systemd resolves the binary here; integrity.c guesses it from exec_start */
+        type ? type : "simple",
+        unitFileGet(unit, "Service", "User")
+    );
+    result->exists = result->details != NULL;
+
+    free(exec_start);
+    freeUnitFile(unit);
+}
+
+/* The units selected under a root, parsed a batch at a time by readOfflineServices(). */
+struct OfflineQuery {
+    FoundUnit *found;
+    size_t found_count;
+    const FoundUnit **selected;
+    size_t selected_count;
+    size_t next;
+    UnitCache *cache;
+    char root[PATH_MAX];
+};
+
+static OfflineQuery* open_offline_query(const char* root, const char* const* patterns, size_t pattern_count) {
+    OfflineQuery *query = calloc(1, sizeof(OfflineQuery));
+    if (query == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return NULL;
+    }
+
+    /* A trailing slash would double up in every joined path. */
+    snprintf(query->root, sizeof(query->root), "%s", root);
+    for (size_t length = strlen(query->root); length > 0 && query->root[length - 1] == '/'; length--) {
+        query->root[length - 1] = '\0';
+    }
+
+    query->found = scan_search_paths(query->root, &query->found_count);
+    if (query->found == NULL) {
+        free(query);
+        return NULL;
+    }
+
+    query->selected = malloc((query->found_count ? query->found_count : 1) * sizeof(FoundUnit*));
+    if (query->selected == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        closeOfflineQuery(query);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < query->found_count; i++) {
+        const FoundUnit *unit = &query->found[i];
+
+        /* Templates (foo@.service) have no instance to show. */
+        if (unit->masked || strstr(unit->name, "@.") || !name_matches(unit->target_name, patterns, pattern_count)) {
+            continue;
+        }
+
+        /* An alias is listed once, under the name of the unit it points to. */
+        if (strcmp(unit->name, unit->target_name) != 0) {
+            const FoundUnit *target = find_unit(query->found, query->found_count, unit->target_name);
+            if (target) {
+                continue;
+            }
+        }
+
+        query->selected[query->selected_count++] = unit;
+    }
+
+    query->cache = openUnitCache(NULL);
+    return query;
+}
+
+OfflineQuery* openOfflineQuery(const char* root, const char* const* patterns, size_t pattern_count) {
+    uint64_t start = statsNow();
+    OfflineQuery *query = open_offline_query(root, patterns, pattern_count);
+    statsRecord(STAT_OPEN_OFFLINE_QUERY, start, query == NULL);
+    return query;
+}
+
+size_t readOfflineServices(OfflineQuery* query, ServiceQueryResult* results, size_t capacity) {
+    uint64_t start = statsNow();
+    size_t kept = 0;
+
+    if (capacity == 0) {
+        return 0;
+    }
+
+    /* A batch whose files all fail to read is skipped rather than ending the query early. */
+    while (kept == 0 && query->next < query->selected_count) {
+        ParseJob job;
+        size_t count = query->selected_count - query->next;
+
+        if (count > capacity) {
+            count = capacity;
+        }
+        memset(results, 0, count * sizeof(ServiceQueryResult));
+        memset(&job, 0, sizeof(job));
+        job.units = query->selected + query->next;
+        job.count = count;
+        job.results = results;
+        job.cache = query->cache;
+        job.root = query->root;
+
+        runWork(parse_unit, &job, count);
+        query->next += count;
+
+        /* Drop units whose file could not be read, keeping the order by name. */
+        for (size_t i = 0; i < count; i++) {
+            if (results[i].exists) {
+                results[kept++] = results[i];
+            }
+        }
+    }
+
+    statsRecord(STAT_READ_OFFLINE_SERVICES, start, false);
+    return kept;
+}
+
+void closeOfflineQuery(OfflineQuery* query) {
+    if (query == NULL) {
+        return;
+    }
+    if (query->cache) {
+        saveUnitCache(query->cache);
+        getUnitCacheStats(query->cache, &last_cache_stats);
+        closeUnitCache(query->cache);
+    }
+    for (size_t i = 0; i < query->found_count; i++) {
+        free_found_unit(&query->found[i]);
+    }
+    free(query->found);
+    free(query->selected);
+    free(query);
+}
+
+void getOfflineCacheStats(UnitCacheStats* stats) {
+    *stats = last_cache_stats;
+}
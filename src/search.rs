@@ -0,0 +1,234 @@
+//! `/` search over the list. Every item's lowercased name and description are packed into
+//! one buffer, built once per change of the list, so a keystroke scans contiguous bytes
+//! instead of lowercasing 50k Strings. Each query prefix keeps its matches: typing narrows
+//! the previous matches, backspace goes back to them.
+
+use super::{Status, StatusItem};
+
+struct SearchIndex {
+    text: Vec<u8>,
+    /// Item i is `text[starts[i]..starts[i + 1]]`: its name, `\n`, its description.
+    starts: Vec<u32>,
+    name_ends: Vec<u32>,
+}
+
+impl SearchIndex {
+    fn build(items: &[StatusItem]) -> Self {
+        let size = items.iter().map(|item| item.service_name.len() + item.summary.len() + 1).sum();
+        let mut text = Vec::with_capacity(size);
+        let mut starts = Vec::with_capacity(items.len() + 1);
+        let mut name_ends = Vec::with_capacity(items.len());
+
+        for item in items {
+            starts.push(text.len() as u32);
+            text.extend(item.service_name.bytes().map(|b| b.to_ascii_lowercase()));
+            name_ends.push(text.len() as u32);
+            text.push(b'\n');
+            text.extend(item.summary.bytes().map(|b| b.to_ascii_lowercase()));
+        }
+        starts.push(text.len() as u32);
+
+        Self { text, starts, name_ends }
+    }
+
+    /// How well item `i` matches all `terms`, lower is better; None if one does not match.
+    /// A term matches a name prefix, a name or description substring, a state prefix,
+    /// or, loosest, the name as a subsequence.
+    fn score(&self, i: usize, status: Status, terms: &[Vec<u8>]) -> Option<u32> {
+        let name = &self.text[self.starts[i] as usize..self.name_ends[i] as usize];
+        let all = &self.text[self.starts[i] as usize..self.starts[i + 1] as usize];
+        let state: &[u8] = match status {
+            Status::Active => b"active",
+            Status::Inactive => b"inactive",
+        };
+
+        terms.iter().try_fold(0, |total, term| {
+            let tier = if name.starts_with(term) {
+                0
+            } else if contains(name, term) {
+                1
+            } else if contains(all, term) || state.starts_with(term) {
+                2
+            } else if is_subsequence(name, term) {
+                3
+            } else {
+                return None;
+            };
+            Some(total + tier)
+        })
+    }
+}
+
+fn contains(haystack: &[u8], needle: &[u8]) -> bool {
+    let first = needle[0];
+    haystack
+        .iter()
+        .enumerate()
+        .filter(|&(_, &b)| b == first)
+        .any(|(at, _)| haystack[at..].starts_with(needle))
+}
+
+fn is_subsequence(haystack: &[u8], needle: &[u8]) -> bool {
+    let mut rest = haystack.iter();
+    needle.iter().all(|b| rest.any(|h| h == b))
+}
+
+#[derive(Default)]
+pub struct Search {
+    pub query: String,
+    /// Whether keys go to the search box.
+    pub editing: bool,
+    index: Option<SearchIndex>,
+    /// Matches (item indices, in item order) of earlier prefixes of `query`.
+    steps: Vec<(String, Vec<usize>)>,
+}
+
+impl Search {
+    pub fn active(&self) -> bool {
+        self.editing || !self.query.is_empty()
+    }
+
+    /// Drops the index and the cached matches; needed whenever items or their status change.
+    pub fn invalidate(&mut self) {
+        self.index = None;
+        self.steps.clear();
+    }
+
+    /// The items to show for the current query, best matches first, or None to show all.
+    pub fn filter(&mut self, items: &[StatusItem]) -> Option<Vec<usize>> {
+        let terms: Vec<Vec<u8>> = self.query.split_whitespace().map(|term| term.to_ascii_lowercase().into_bytes()).collect();
+        if terms.is_empty() {
+            self.steps.clear();
+            return None;
+        }
+
+        let index = self.index.get_or_insert_with(|| SearchIndex::build(items));
+
+        // Appending to a query can only remove matches, so start from the longest cached prefix.
+        while self.steps.last().is_some_and(|(query, _)| !self.query.starts_with(query.as_str())) {
+            self.steps.pop();
+        }
+
+        let score = |i: usize| index.score(i, items[i].status, &terms).map(|score| (score, i));
+        let mut scored: Vec<(u32, usize)> = match self.steps.last() {
+            Some((_, matches)) => matches.iter().filter_map(|&i| score(i)).collect(),
+            None => (0..items.len()).filter_map(score).collect(),
+        };
+
+        if self.steps.last().map_or(true, |(query, _)| *query != self.query) {
+            self.steps.push((self.query.clone(), scored.iter().map(|&(_, i)| i).collect()));
+        }
+
+        scored.sort_unstable();
+        Some(scored.into_iter().map(|(_, i)| i).collect())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn item(name: &str, summary: &str, status: Status) -> StatusItem {
+        let mut item = StatusItem::new(status, name, &format!("{}.service", name), "");
+        item.summary = summary.to_string();
+        item
+    }
+
+    fn items() -> Vec<StatusItem> {
+        vec![
+            item("sshd", "OpenBSD Secure Shell server", Status::Active),
+            item("ssh-agent", "OpenSSH key agent", Status::Inactive),
+            item("nginx", "A high performance web server", Status::Active),
+            item("cron", "Regular background program processing daemon", Status::Inactive),
+            item("systemd-journald", "Journal Service", Status::Active),
+        ]
+    }
+
+    fn query(search: &mut Search, items: &[StatusItem], text: &str) -> Vec<usize> {
+        search.query = text.to_string();
+        search.filter(items).expect("a non-empty query filters")
+    }
+
+    fn sorted(mut matches: Vec<usize>) -> Vec<usize> {
+        matches.sort_unstable();
+        matches
+    }
+
+    #[test]
+    fn empty_query_shows_everything() {
+        let mut search = Search::default();
+        assert_eq!(search.filter(&items()), None);
+        search.query = "   ".to_string();
+        assert_eq!(search.filter(&items()), None);
+    }
+
+    #[test]
+    fn typing_narrows_the_matches() {
+        let items = items();
+        let mut search = Search::default();
+        let mut previous: Vec<usize> = (0..items.len()).collect();
+        for typed in ["s", "ss", "ssh", "sshd"] {
+            let matches = sorted(query(&mut search, &items, typed));
+            assert!(matches.iter().all(|i| previous.contains(i)), "{:?} is not within {:?} for {:?}", matches, previous, typed);
+            previous = matches;
+        }
+        assert_eq!(previous, vec![0]);
+    }
+
+    #[test]
+    fn backspace_restores_the_matches() {
+        let items = items();
+        let mut search = Search::default();
+        let wide = query(&mut search, &items, "ss");
+        assert_eq!(query(&mut search, &items, "ssh-"), vec![1]);
+        assert_eq!(query(&mut search, &items, "ss"), wide);
+        // Past the first cached prefix, the same as a search that never narrowed.
+        assert_eq!(query(&mut search, &items, "s"), query(&mut Search::default(), &items, "s"));
+    }
+
+    #[test]
+    fn every_term_has_to_match() {
+        let items = items();
+        let mut search = Search::default();
+        assert_eq!(sorted(query(&mut search, &items, "ssh")), vec![0, 1]);
+        assert_eq!(query(&mut search, &items, "ssh agent"), vec![1]);
+        assert_eq!(query(&mut search, &items, "ssh agent nginx"), Vec::<usize>::new());
+        // Terms are case-insensitive and may come from the description.
+        assert_eq!(query(&mut search, &items, "SSH Secure"), vec![0]);
+    }
+
+    #[test]
+    fn terms_match_state_prefixes() {
+        let items = items();
+        let mut search = Search::default();
+        assert_eq!(sorted(query(&mut search, &items, "inact")), vec![1, 3]);
+        assert_eq!(sorted(query(&mut search, &items, "inactive ssh")), vec![1]);
+        // "active" is not a prefix of "inactive".
+        assert_eq!(sorted(query(&mut search, &items, "active")), vec![0, 2, 4]);
+    }
+
+    #[test]
+    fn subsequences_rank_below_substrings() {
+        let items = vec![
+            item("a-x-b-x-c", "", Status::Active),
+            item("xabc", "", Status::Active),
+            item("abcd", "", Status::Active),
+            item("unrelated", "mentions abc", Status::Active),
+        ];
+        let mut search = Search::default();
+        // Name prefix, then name substring, then description, then subsequence.
+        assert_eq!(query(&mut search, &items, "abc"), vec![2, 1, 3, 0]);
+    }
+
+    #[test]
+    fn invalidate_picks_up_changed_items() {
+        let mut search = Search::default();
+        let before = vec![item("foo", "", Status::Active), item("bar", "", Status::Active)];
+        assert_eq!(query(&mut search, &before, "foo"), vec![0]);
+
+        let after = vec![item("bar", "", Status::Active), item("baz", "", Status::Active), item("foo", "", Status::Inactive)];
+        search.invalidate();
+        assert_eq!(query(&mut search, &after, "foo"), vec![2]);
+        assert_eq!(query(&mut search, &after, "foo inactive"), vec![2]);
+    }
+}
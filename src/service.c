@@ -4,27 +4,154 @@
 #include <string.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <fnmatch.h>
+#include <stdatomic.h>
+
+#include "service.h"
+#include "stats.h"
+#include "work_pool.h"
 
 #define DESTINATION "org.freedesktop.systemd1"
 
+/*
+ * All entry points share one system bus connection instead of connecting and
+ * authenticating on every call. sd-bus connections must only be used by one
+ * thread at a time, so each thread lazily gets its own.
+ */
+static _Thread_local sd_bus *service_bus = NULL;
+static char *service_bus_address = NULL;
+
+bool setServiceBusAddress(const char* address) {
+    char *copy = NULL;
+
+    if (address) {
+        copy = strdup(address);
+        if (copy == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return false;
+        }
+    }
 
-bool isServiceRunning(const char* service_name) {
+    free(service_bus_address);
+    service_bus_address = copy;
+    return true;
+}
 
+int openServiceBus(sd_bus** ret) {
+    uint64_t start = statsNow();
     sd_bus *bus = NULL;
+    int r;
+
+    if (service_bus_address == NULL) {
+        r = sd_bus_open_system(ret);
+        statsRecord(STAT_BUS_CONNECT, start, r < 0);
+        return r;
+    }
+
+    r = sd_bus_new(&bus);
+    if (r >= 0) {
+        r = sd_bus_set_address(bus, service_bus_address);
+    }
+    if (r >= 0) {
+        /* A bus daemon, not a peer-to-peer connection: say Hello and get a unique name. */
+        r = sd_bus_set_bus_client(bus, 1);
+    }
+    if (r >= 0) {
+        r = sd_bus_start(bus);
+    }
+    statsRecord(STAT_BUS_CONNECT, start, r < 0);
+    if (r < 0) {
+        sd_bus_unref(bus);
+        return r;
+    }
+
+    *ret = bus;
+    return r;
+}
+
+static void drop_service_bus(void) {
+    if (service_bus) {
+        sd_bus_flush_close_unref(service_bus);
+        service_bus = NULL;
+    }
+}
+
+static sd_bus* get_service_bus(void) {
+    int r;
+
+    if (service_bus && sd_bus_is_open(service_bus) > 0) {
+        return service_bus;
+    }
+
+    drop_service_bus();
+
+    r = openServiceBus(&service_bus);
+    if (r < 0) {
+        fprintf(stderr, "Failed to connect to %s: %s\n", service_bus_address ? service_bus_address : "system bus", strerror(-r));
+        service_bus = NULL;
+        return NULL;
+    }
+
+    return service_bus;
+}
+
+static bool is_disconnect_error(int r) {
+    return r == -ECONNRESET || r == -ENOTCONN || r == -EPIPE || r == -ESHUTDOWN || r == -ECONNREFUSED;
+}
+
+/*
+ * sd_bus_call_method on the shared connection. If the connection was lost
+ * (e.g. the bus daemon restarted) it is reopened and the call retried once.
+ */
+static int bus_call_method(const char *path, const char *interface, const char *member, sd_bus_error *error, sd_bus_message **reply, const char *types, ...) {
+    va_list ap;
+    int r = -ENOTCONN;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        sd_bus *bus = get_service_bus();
+        if (bus == NULL) {
+            return -ENOTCONN;
+        }
+
+        uint64_t start = statsNow();
+        va_start(ap, types);
+        r = sd_bus_call_methodv(bus, DESTINATION, path, interface, member, error, reply, types, ap);
+        va_end(ap);
+        statsRecord(statsBusMethod(member), start, r < 0);
+
+        if (r >= 0 || !is_disconnect_error(r)) {
+            return r;
+        }
+
+        sd_bus_error_free(error);
+        drop_service_bus();
+    }
+
+    return r;
+}
+
+/* A unit that is not loaded is an answer ("not running", "does not exist"), not a failure. */
+static bool is_no_such_unit(const sd_bus_error *error) {
+    return sd_bus_error_has_name(error, "org.freedesktop.systemd1.NoSuchUnit");
+}
+
+void closeServiceBus(void) {
+    drop_service_bus();
+}
+
+
+/* Whether the unit is active; `*failed` is set when the bus could not answer. */
+static bool is_service_running(const char* service_name, bool *failed) {
+
     sd_bus_message *msg = NULL;
     sd_bus_error error = SD_BUS_ERROR_NULL;
     int ret;
     bool is_running = false;
 
-    ret = sd_bus_open_system(&bus);
-    if (ret < 0) {
-        fprintf(stderr, "Failed to connect to system bus: %s\n", strerror(-ret));
-        return false;
-    }
-
-    ret = sd_bus_call_method(
-        bus,
-        "org.freedesktop.systemd1",
+    ret = bus_call_method(
         "/org/freedesktop/systemd1",
         "org.freedesktop.systemd1.Manager",
         "GetUnit",
@@ -35,8 +162,11 @@ bool isServiceRunning(const char* service_name) {
     );
 
     if (ret < 0) {
-        fprintf(stderr, "failed to connect to system bus: %s\n", strerror(-ret));
-        sd_bus_unref(bus);
+        *failed = !is_no_such_unit(&error);
+        if (*failed) {
+            fprintf(stderr, "Failed to get unit: %s\n", strerror(-ret));
+        }
+        sd_bus_error_free(&error);
         return false;
     }
 
@@ -45,14 +175,12 @@ bool isServiceRunning(const char* service_name) {
     if (ret < 0) {
         fprintf(stderr, "Failed to read unit object path: %s\n", strerror(-ret));
         sd_bus_message_unref(msg);
-        sd_bus_unref(bus);
+        *failed = true;
         return false;
     }
 
     sd_bus_message *status_msg = NULL;
-    ret = sd_bus_call_method(
-        bus,
-        "org.freedesktop.systemd1",
+    ret = bus_call_method(
         unit_path,
         "org.freedesktop.DBus.Properties",
         "Get",
@@ -68,7 +196,7 @@ bool isServiceRunning(const char* service_name) {
         fprintf(stderr, "Failed to get ActiveState property: %s\n", strerror(-ret));
         sd_bus_error_free(&error);
         sd_bus_message_unref(msg);
-        sd_bus_unref(bus);
+        *failed = true;
         return false;
     }
 
@@ -78,7 +206,7 @@ bool isServiceRunning(const char* service_name) {
         fprintf(stderr, "failed to read ActiveState: %s\n", strerror(-ret));
         sd_bus_message_unref(status_msg);
         sd_bus_message_unref(msg);
-        sd_bus_unref(bus);
+        *failed = true;
         return false;
     }
 
@@ -88,28 +216,27 @@ bool isServiceRunning(const char* service_name) {
 
     sd_bus_message_unref(status_msg);
     sd_bus_message_unref(msg);
-    sd_bus_unref(bus);
 
     return is_running;
 }
 
-bool doesServiceExist(const char* service_name) {
+bool isServiceRunning(const char* service_name) {
+    uint64_t start = statsNow();
+    bool failed = false;
+    bool running = is_service_running(service_name, &failed);
+    statsRecord(STAT_IS_SERVICE_RUNNING, start, failed);
+    return running;
+}
+
+/* Whether the unit is loaded; `*failed` is set when the bus could not answer. */
+static bool does_service_exist(const char* service_name, bool *failed) {
 
-    sd_bus *bus = NULL;
     sd_bus_message *msg = NULL;
     sd_bus_error error = SD_BUS_ERROR_NULL;
     int ret;
     bool exists = false;
 
-    ret = sd_bus_open_system(&bus);
-    if (ret < 0) {
-        fprintf(stderr, "failed to connect to system bus: %s\n", strerror(-ret));
-        return false;
-    }
-
-    ret = sd_bus_call_method(
-        bus,
-        DESTINATION,
+    ret = bus_call_method(
         "/org/freedesktop/systemd1",
         "org.freedesktop.systemd1.Manager",
         "GetUnit",
@@ -120,8 +247,11 @@ bool doesServiceExist(const char* service_name) {
     );
 
     if (ret < 0) {
-        fprintf(stderr, "Failed to call method: %s\n", strerror(-ret));
-        sd_bus_unref(bus);
+        *failed = !is_no_such_unit(&error);
+        if (*failed) {
+            fprintf(stderr, "Failed to call method: %s\n", strerror(-ret));
+        }
+        sd_bus_error_free(&error);
         return false;
     }
 
@@ -132,46 +262,138 @@ bool doesServiceExist(const char* service_name) {
         exists = false;
     }
 
-    sd_bus_unref(bus);
     return exists;
 }
 
-char** serviceNamesArray(size_t* count) {
+bool doesServiceExist(const char* service_name) {
+    uint64_t start = statsNow();
+    bool failed = false;
+    bool exists = does_service_exist(service_name, &failed);
+    statsRecord(STAT_DOES_SERVICE_EXIST, start, failed);
+    return exists;
+}
 
-    sd_bus *bus = NULL;
+void freeServiceUnitRecords(ServiceUnitRecord* records, size_t count) {
+    if (records) {
+        for (size_t i = 0; i < count; i++) {
+            free(records[i].name);
+            free(records[i].description);
+            free(records[i].load_state);
+            free(records[i].active_state);
+            free(records[i].sub_state);
+            free(records[i].object_path);
+        }
+        free(records);
+    }
+}
+
+/* NULL-terminated copy of the pointer array, as sd_bus_message_append_strv expects. */
+static char** strv_from_array(const char* const* array, size_t count) {
+    char **strv = calloc(count + 1, sizeof(char*));
+    if (strv == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        strv[i] = (char*)array[i];
+    }
+    return strv;
+}
+
+/* Calls a ListUnits* method whose arguments are zero to two string arrays. */
+static int call_list_units(const char* member, char** states, char** patterns, sd_bus_error* error, sd_bus_message** reply) {
+    int r = -ENOTCONN;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        sd_bus_message *msg = NULL;
+        sd_bus *bus = get_service_bus();
+        if (bus == NULL) {
+            return -ENOTCONN;
+        }
+
+        r = sd_bus_message_new_method_call(bus, &msg, DESTINATION, "/org/freedesktop/systemd1", "org.freedesktop.systemd1.Manager", member);
+        if (r >= 0 && states) {
+            r = sd_bus_message_append_strv(msg, states);
+        }
+        if (r >= 0 && patterns) {
+            r = sd_bus_message_append_strv(msg, patterns);
+        }
+        if (r >= 0) {
+            uint64_t start = statsNow();
+            r = sd_bus_call(bus, msg, 0, error, reply);
+            statsRecord(statsBusMethod(member), start, r < 0);
+        }
+        sd_bus_message_unref(msg);
+
+        if (r >= 0 || !is_disconnect_error(r)) {
+            return r;
+        }
+
+        sd_bus_error_free(error);
+        drop_service_bus();
+    }
+
+    return r;
+}
+
+/* Client-side equivalent of ListUnitsByPatterns, for managers that lack it. */
+static bool unit_matches(const char* name, const char* load_state, const char* active_state, const char* sub_state, char** states, char** patterns) {
+    bool matches = states[0] == NULL;
+    for (char **state = states; *state && !matches; state++) {
+        matches = strcmp(*state, load_state) == 0 || strcmp(*state, active_state) == 0 || strcmp(*state, sub_state) == 0;
+    }
+    if (!matches) {
+        return false;
+    }
+
+    matches = patterns[0] == NULL;
+    for (char **pattern = patterns; *pattern && !matches; pattern++) {
+        matches = fnmatch(*pattern, name, 0) == 0;
+    }
+    return matches;
+}
+
+/*
+ * Lists units matching any of `patterns` (shell globs, e.g. "*.service") and
+ * any of `states` (load, active or sub state). Empty lists match everything.
+ * Filtering happens in systemd via ListUnitsByPatterns, so unmatched units
+ * are never transferred. Returns NULL on failure.
+ */
+static ServiceUnitRecord* list_service_units(const char* const* patterns, size_t pattern_count, const char* const* states, size_t state_count, size_t* count) {
     sd_bus_message *reply = NULL;
+    sd_bus_error error = SD_BUS_ERROR_NULL;
+    bool filter_locally = false;
+    ServiceUnitRecord *array = NULL;
     int r;
 
-    r = sd_bus_open_system(&bus);
-    if (r < 0) {
-        fprintf(stderr, "failed to connect to bus: %s\n", strerror(-r));
-        sd_bus_unref(bus);
-        return NULL;
+    *count = 0;
+
+    char **pattern_strv = strv_from_array(patterns, pattern_count);
+    char **state_strv = strv_from_array(states, state_count);
+    if (pattern_strv == NULL || state_strv == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        goto finish;
     }
 
-    r = sd_bus_call_method(
-        bus, 
-        "org.freedesktop.systemd1",     
-        "/org/freedesktop/systemd1",    
-        "org.freedesktop.systemd1.Manager", 
-        "ListUnits",                     
-        NULL,                            
-        &reply,
-        NULL
-    );
+    r = call_list_units("ListUnitsByPatterns", state_strv, pattern_strv, &error, &reply);
+    if (r < 0 && sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_METHOD)) {
+        sd_bus_error_free(&error);
+        filter_locally = true;
+        r = call_list_units("ListUnitsFiltered", state_strv, NULL, &error, &reply);
+    }
+    if (r < 0 && sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_METHOD)) {
+        sd_bus_error_free(&error);
+        r = call_list_units("ListUnits", NULL, NULL, &error, &reply);
+    }
 
     if (r < 0) {
-        fprintf(stderr, "Failed to call ListUnits method: %s\n", strerror(-r));
-        sd_bus_unref(bus);
-        return NULL;
+        fprintf(stderr, "Failed to list units: %s\n", error.message ? error.message : strerror(-r));
+        goto finish;
     }
 
     r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(ssssssouso)");
     if (r < 0) {
         fprintf(stderr, "Failed to enter container: %s\n", strerror(-r));
-        sd_bus_message_unref(reply);
-        sd_bus_unref(bus);
-        return NULL;
+        goto finish;
     }
 
     const char *name;
@@ -180,76 +402,105 @@ char** serviceNamesArray(size_t* count) {
     const char *active_state;
     const char *sub_state;
     const char *following;
-    uint32_t unit_id;
     const char *object_path;
+    uint32_t job_id;
     const char *job_type;
     const char *job_path;
 
-    size_t capacity = 10;
-    char** array = (char**)malloc(capacity * sizeof(char*));
+    size_t capacity = 16;
+    array = malloc(capacity * sizeof(ServiceUnitRecord));
     if (array == NULL) {
         fprintf(stderr, "Memory allocation failed\n");
-        sd_bus_message_exit_container(reply);
-        sd_bus_message_unref(reply);
-        sd_bus_unref(bus);
-        return NULL;
+        goto finish;
     }
 
-    *count = 0;
-    
-    while ((r = sd_bus_message_read(reply, "(ssssssouso)", &name, &description, &load_state, &active_state, &sub_state, &following, &unit_id, &object_path, &job_type, &job_path)) > 0) {
-        if (strstr(name, ".service") != NULL) {
-            if (*count >= capacity) {
-                capacity *= 2;
-                char **temp = (char**)realloc(array, capacity * sizeof(char*));
-                if (temp == NULL) {
-                    fprintf(stderr, "Failed to reallocate memory for service names\n");
-                    for (size_t i = 0; i < *count; i++) {
-                        free(array[i]);
-                    }
-                    free(array);
-                    sd_bus_message_exit_container(reply);
-                    sd_bus_message_unref(reply);
-                    sd_bus_unref(bus);
-                    return NULL;
-                }
-                array = temp;
-            }
-            array[*count] = strdup(name);
-            if (array[*count] == NULL) {
-                fprintf(stderr, "Failed to deuplicate service name \n");
-                for (size_t i = 0; i < *count; i++) {
-                    free(array[i]);
-                }
-                free(array);
-                sd_bus_message_exit_container(reply);
-                sd_bus_message_unref(reply);
-                sd_bus_unref(bus);
-                return NULL;
+    while ((r = sd_bus_message_read(reply, "(ssssssouso)", &name, &description, &load_state, &active_state, &sub_state, &following, &object_path, &job_id, &job_type, &job_path)) > 0) {
+        if (filter_locally && !unit_matches(name, load_state, active_state, sub_state, state_strv, pattern_strv)) {
+            continue;
+        }
+
+        if (*count >= capacity) {
+            capacity *= 2;
+            ServiceUnitRecord *temp = realloc(array, capacity * sizeof(ServiceUnitRecord));
+            if (temp == NULL) {
+                fprintf(stderr, "Failed to reallocate memory for unit records\n");
+                r = -ENOMEM;
+                break;
             }
-            (*count)++;
+            array = temp;
+        }
+
+        ServiceUnitRecord *record = &array[*count];
+        record->name = strdup(name);
+        record->description = strdup(description);
+        record->load_state = strdup(load_state);
+        record->active_state = strdup(active_state);
+        record->sub_state = strdup(sub_state);
+        record->object_path = strdup(object_path);
+        (*count)++;
+
+        if (!record->name || !record->description || !record->load_state || !record->active_state || !record->sub_state || !record->object_path) {
+            fprintf(stderr, "Failed to duplicate unit record\n");
+            r = -ENOMEM;
+            break;
         }
     }
 
     if (r < 0) {
-        fprintf(stderr, "Failed to read message: %s\n", strerror(-r));
-        for (size_t i = 0; i < *count; i++) {
-            free(array[i]);
+        if (r != -ENOMEM) {
+            fprintf(stderr, "Failed to read message: %s\n", strerror(-r));
         }
-        free(array);
-        sd_bus_message_exit_container(reply);
-        sd_bus_message_unref(reply);
-        sd_bus_unref(bus);
-        return NULL;
+        freeServiceUnitRecords(array, *count);
+        array = NULL;
+        *count = 0;
     }
 
-    sd_bus_message_exit_container(reply);
+finish:
+    sd_bus_error_free(&error);
     sd_bus_message_unref(reply);
-    sd_bus_unref(bus);
+    free(pattern_strv);
+    free(state_strv);
+    return array;
+}
+
+ServiceUnitRecord* listServiceUnits(const char* const* patterns, size_t pattern_count, const char* const* states, size_t state_count, size_t* count) {
+    uint64_t start = statsNow();
+    ServiceUnitRecord *records = list_service_units(patterns, pattern_count, states, state_count, count);
+    statsRecord(STAT_LIST_SERVICE_UNITS, start, records == NULL);
+    return records;
+}
+
+static char** service_names_array(size_t* count) {
+    const char* patterns[] = { "*.service" };
 
+    ServiceUnitRecord *records = listServiceUnits(patterns, 1, NULL, 0, count);
+    if (records == NULL) {
+        return NULL;
+    }
+
+    char** array = (char**)malloc((*count > 0 ? *count : 1) * sizeof(char*));
+    if (array == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        freeServiceUnitRecords(records, *count);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < *count; i++) {
+        array[i] = records[i].name;
+        records[i].name = NULL;
+    }
+
+    freeServiceUnitRecords(records, *count);
     return array;
 }
 
+char** serviceNamesArray(size_t* count) {
+    uint64_t start = statsNow();
+    char **names = service_names_array(count);
+    statsRecord(STAT_SERVICE_NAMES_ARRAY, start, names == NULL);
+    return names;
+}
+
 void freeServiceNameArray(char** array, size_t count) {
     if (array) {
         for (size_t i = 0; i < count; i++) {
@@ -261,155 +512,737 @@ void freeServiceNameArray(char** array, size_t count) {
 
 
 
-#define COMMAND_BUFFER_SIZE 256
+#define UNIT_INTERFACE "org.freedesktop.systemd1.Unit"
+#define SERVICE_INTERFACE "org.freedesktop.systemd1.Service"
+#define SERVICE_SUFFIX ".service"
+
+/* Only .service units have the Service interface; timers, sockets etc. just get Unit properties. */
+static bool is_service_unit(const char* name) {
+    size_t length = strlen(name);
+    return length >= strlen(SERVICE_SUFFIX) && strcmp(name + length - strlen(SERVICE_SUFFIX), SERVICE_SUFFIX) == 0;
+}
 
-int execute_command(const char *command, char *output, size_t output_size) {
-    FILE *fp;
-    char buffer[COMMAND_BUFFER_SIZE];
+/* LoadUnit also resolves units that are installed but not currently loaded. */
+static char* load_unit_path(const char* service_name) {
+    sd_bus_message *msg = NULL;
+    sd_bus_error error = SD_BUS_ERROR_NULL;
+    const char *unit_path;
+    char *result;
+    int r;
+
+    r = bus_call_method(
+        "/org/freedesktop/systemd1",
+        "org.freedesktop.systemd1.Manager",
+        "LoadUnit",
+        &error,
+        &msg,
+        "s",
+        service_name
+    );
 
-    fp = popen(command, "r");
-    if (fp == NULL) {
-        perror("popen");
-        return -1;
+    if (r < 0) {
+        fprintf(stderr, "Failed to load unit %s: %s\n", service_name, error.message ? error.message : strerror(-r));
+        sd_bus_error_free(&error);
+        return NULL;
     }
 
-    if (fgets(buffer, sizeof(buffer), fp) != NULL) {
-        strncpy(output, buffer, output_size - 1);
-        output[output_size - 1] = '\0';
-    } else {
-        output[0] = '\0';
+    r = sd_bus_message_read(msg, "o", &unit_path);
+    if (r < 0) {
+        fprintf(stderr, "Failed to read unit object path: %s\n", strerror(-r));
+        sd_bus_message_unref(msg);
+        return NULL;
     }
 
-    if (pclose(fp) == -1) {
-        perror("pclose");
-        return -1;
+    result = strdup(unit_path);
+    sd_bus_message_unref(msg);
+    return result;
+}
+
+/*
+ * A ServiceDetails is built in place: the fixed fields first, then every
+ * string appended behind them, growing the one allocation as needed.
+ * Fields refer to strings by offset, so growing never invalidates them.
+ */
+#define DETAILS_INITIAL_CAPACITY 1024
+
+typedef struct {
+    ServiceDetails *details;
+    size_t capacity;
+} DetailsBuilder;
+
+static bool builder_reserve(DetailsBuilder* builder, size_t extra) {
+    size_t needed = (size_t)builder->details->size + extra;
+    if (needed <= builder->capacity) {
+        return true;
+    }
+    if (needed > UINT32_MAX) {
+        fprintf(stderr, "Service details too large\n");
+        return false;
     }
 
-    return 0;
+    size_t capacity = builder->capacity * 2;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+
+    ServiceDetails *temp = realloc(builder->details, SERVICE_DETAILS_SIZE(capacity));
+    if (temp == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return false;
+    }
+
+    builder->details = temp;
+    builder->capacity = capacity;
+    return true;
 }
 
+/* Appends bytes to the string currently being built. */
+static bool builder_append(DetailsBuilder* builder, const char* value, size_t length) {
+    if (!builder_reserve(builder, length + 1)) {
+        return false;
+    }
+    memcpy(builder->details->data + builder->details->size, value, length);
+    builder->details->size += length;
+    return true;
+}
 
-#define MAX_LINE_LENGTH 256
+/* Terminates the string that started at `start` and points the field at `field_offset` to it. */
+static bool builder_end_string(DetailsBuilder* builder, size_t field_offset, uint32_t start) {
+    if (!builder_reserve(builder, 1)) {
+        return false;
+    }
 
-typedef struct {
-    char type[1024];
-    char exec_start[1024];
-    char description[4192];
-    char user[MAX_LINE_LENGTH];
-} ServiceFileData;
+    ServiceDetails *details = builder->details;
+    ServiceString *field = (ServiceString*)((char*)details + field_offset);
 
-void parse_service_file(const char* file_path, ServiceFileData *data) {
-    FILE *file;
-    char line[MAX_LINE_LENGTH];
+    details->data[details->size++] = '\0';
+    field->offset = start;
+    field->length = details->size - 1 - start;
+    return true;
+}
 
-    memset(data, 0, sizeof(ServiceFileData));
+static bool builder_set_string(DetailsBuilder* builder, size_t field_offset, const char* value, size_t length) {
+    uint32_t start = builder->details->size;
+    return builder_append(builder, value, length) && builder_end_string(builder, field_offset, start);
+}
 
-    file = fopen(file_path, "r");
-    if (file == NULL) {
-        return;
-    } 
+static bool builder_init(DetailsBuilder* builder, const char* service_name) {
+    builder->capacity = DETAILS_INITIAL_CAPACITY;
+    builder->details = calloc(1, SERVICE_DETAILS_SIZE(builder->capacity));
+    if (builder->details == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return false;
+    }
 
-    while (fgets(line, sizeof(line), file)) {
-        char *key;
-        char *value;
+    /* data[0] stays NUL so that unset fields ({0, 0}) read as "". */
+    builder->details->size = 1;
 
-        line[strcspn(line, "\r\n")] = 0;
+    /* Services are shown without their suffix; other unit types keep it to tell them apart. */
+    size_t display_length = strlen(service_name);
+    if (is_service_unit(service_name)) {
+        display_length -= strlen(SERVICE_SUFFIX);
+    }
 
-        if (line[0] == '\0' || line[0] == '#') {
-            continue;
+    if (!builder_set_string(builder, offsetof(ServiceDetails, service_name), service_name, strlen(service_name)) ||
+        !builder_set_string(builder, offsetof(ServiceDetails, service_display_name), service_name, display_length)) {
+        free(builder->details);
+        builder->details = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+static void set_or_not_specified(DetailsBuilder* builder, size_t field_offset) {
+    ServiceString *field = (ServiceString*)((char*)builder->details + field_offset);
+    if (field->length == 0) {
+        builder_set_string(builder, field_offset, "Not specified", strlen("Not specified"));
+    }
+}
+
+/* Hands the finished details to the caller, trimmed to the bytes in use. */
+static ServiceDetails* builder_finish(DetailsBuilder* builder) {
+    set_or_not_specified(builder, offsetof(ServiceDetails, service_type));
+    set_or_not_specified(builder, offsetof(ServiceDetails, description));
+    set_or_not_specified(builder, offsetof(ServiceDetails, executable_path));
+    set_or_not_specified(builder, offsetof(ServiceDetails, service_account));
+
+    ServiceDetails *details = builder->details;
+    ServiceDetails *trimmed = realloc(details, SERVICE_DETAILS_SIZE(details->size));
+    builder->details = NULL;
+    return trimmed ? trimmed : details;
+}
+
+static bool details_string_equals(const ServiceDetails* details, ServiceString string, const char* value) {
+    return string.length == strlen(value) && memcmp(details->data + string.offset, value, string.length) == 0;
+}
+
+void freeServiceDetails(ServiceDetails* details) {
+    free(details);
+}
+
+/*
+ * Reads an exec command list (a(sasbttttuii), e.g. ExecStart) and joins each
+ * command line's argv with spaces; several lines are separated by "; ". The
+ * first command's path goes to the field behind, see DECLARE_EXEC.
+ */
+static int read_exec_command_list(sd_bus_message* msg, DetailsBuilder* builder, size_t field_offset) {
+    uint32_t start = builder->details->size;
+    const char *binary = NULL;
+    bool first_command = true;
+    int r;
+
+    r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_ARRAY, "(sasbttttuii)");
+
+    while (r >= 0 && (r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_STRUCT, "sasbttttuii")) > 0) {
+        const char *path;
+        const char *arg;
+        bool first_arg = true;
+
+        r = sd_bus_message_read(msg, "s", &path);
+        if (r >= 0 && binary == NULL) {
+            binary = path;
+        }
+        if (r >= 0) {
+            r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_ARRAY, "s");
+        }
+
+        while (r >= 0 && (r = sd_bus_message_read(msg, "s", &arg)) > 0) {
+            const char *separator = first_arg ? (first_command ? "" : "; ") : " ";
+            if (!builder_append(builder, separator, strlen(separator)) || !builder_append(builder, arg, strlen(arg))) {
+                return -ENOMEM;
+            }
+            first_arg = false;
+            first_command = false;
         }
 
-        key = strtok(line, "=");
-        value = strtok(NULL, "=");
+        if (r >= 0) {
+            r = sd_bus_message_exit_container(msg);
+        }
+        if (r >= 0) {
+            r = sd_bus_message_skip(msg, "bttttuii");
+        }
+        if (r >= 0) {
+            r = sd_bus_message_exit_container(msg);
+        }
+    }
+
+    if (r >= 0) {
+        r = sd_bus_message_exit_container(msg);
+    }
+
+    if (r >= 0 && !builder_end_string(builder, field_offset, start)) {
+        r = -ENOMEM;
+    }
+    /* The path points into `msg`, which outlives this call. */
+    if (r >= 0 && binary && !builder_set_string(builder, field_offset + sizeof(ServiceString), binary, strlen(binary))) {
+        r = -ENOMEM;
+    }
+
+    return r;
+}
+
+typedef enum {
+    PROPERTY_STRING,
+    PROPERTY_EXEC,
+    PROPERTY_U64,
+    PROPERTY_U32,
+} PropertyKind;
+
+typedef struct {
+    const char *interface;
+    const char *name;
+    PropertyKind kind;
+    size_t offset;
+} PropertyEntry;
+
+#define PROPERTY_ENTRY(iface, name, kind, field) \
+    { iface##_INTERFACE, name, PROPERTY_##kind, offsetof(ServiceDetails, field) },
+
+_Static_assert(offsetof(ServiceDetails, executable_path_binary) == offsetof(ServiceDetails, executable_path) + sizeof(ServiceString),
+               "DECLARE_EXEC puts the binary right behind the command lines");
+
+/* Decoder table generated from SERVICE_PROPERTIES in service.h. */
+static const PropertyEntry service_properties[] = {
+    SERVICE_PROPERTIES(PROPERTY_ENTRY)
+};
+
+static const char* property_signature(PropertyKind kind) {
+    switch (kind) {
+        case PROPERTY_STRING: return "s";
+        case PROPERTY_EXEC:   return "a(sasbttttuii)";
+        case PROPERTY_U64:    return "t";
+        case PROPERTY_U32:    return "u";
+    }
+    return "";
+}
+
+static const PropertyEntry* find_property(const char* interface, const char* name) {
+    for (size_t i = 0; i < sizeof(service_properties) / sizeof(service_properties[0]); i++) {
+        if (strcmp(service_properties[i].name, name) == 0 && strcmp(service_properties[i].interface, interface) == 0) {
+            return &service_properties[i];
+        }
+    }
+    return NULL;
+}
+
+/* Decodes the variant the message is positioned at into the entry's field. */
+static int read_property(sd_bus_message* msg, const PropertyEntry* entry, DetailsBuilder* builder) {
+    const char *contents;
+    const char *value;
+    int r;
+
+    r = sd_bus_message_peek_type(msg, NULL, &contents);
+    if (r < 0) {
+        return r;
+    }
+
+    if (strcmp(contents, property_signature(entry->kind)) != 0) {
+        return sd_bus_message_skip(msg, "v");
+    }
+
+    r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_VARIANT, contents);
+    if (r < 0) {
+        return r;
+    }
 
-        if (value) {
-            if (strcmp(key, "Type") == 0) {
-                strncpy(data->type, value, sizeof(data->type) - 1);
-            } else if (strcmp(key, "ExecStart") == 0) {
-                strncpy(data->exec_start, value, sizeof(data->exec_start) - 1);
-            } else if (strcmp(key, "Description") == 0) {
-                strncpy(data->description, value, sizeof(data->description) - 1);
-            } else if (strcmp(key, "User") == 0) {
-                strncpy(data->user, value, sizeof(data->user) - 1);
+    switch (entry->kind) {
+        case PROPERTY_STRING:
+            r = sd_bus_message_read(msg, "s", &value);
+            if (r >= 0 && !builder_set_string(builder, entry->offset, value, strlen(value))) {
+                r = -ENOMEM;
             }
+            break;
+        case PROPERTY_EXEC:
+            r = read_exec_command_list(msg, builder, entry->offset);
+            break;
+        case PROPERTY_U64:
+            r = sd_bus_message_read_basic(msg, SD_BUS_TYPE_UINT64, (char*)builder->details + entry->offset);
+            break;
+        case PROPERTY_U32:
+            r = sd_bus_message_read_basic(msg, SD_BUS_TYPE_UINT32, (char*)builder->details + entry->offset);
+            break;
+    }
+
+    if (r < 0) {
+        return r;
+    }
+
+    return sd_bus_message_exit_container(msg);
+}
+
+/* Decodes a GetAll reply (a{sv}), keeping only properties listed in SERVICE_PROPERTIES. */
+static int read_all_properties(sd_bus_message* msg, const char* interface, DetailsBuilder* builder) {
+    const char *name;
+    int r;
+
+    r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_ARRAY, "{sv}");
+    if (r < 0) {
+        return r;
+    }
+
+    while ((r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_DICT_ENTRY, "sv")) > 0) {
+        r = sd_bus_message_read(msg, "s", &name);
+        if (r < 0) {
+            return r;
+        }
+
+        const PropertyEntry *entry = find_property(interface, name);
+        if (entry) {
+            r = read_property(msg, entry, builder);
+        } else {
+            r = sd_bus_message_skip(msg, "v");
+        }
+        if (r < 0) {
+            return r;
+        }
+
+        r = sd_bus_message_exit_container(msg);
+        if (r < 0) {
+            return r;
         }
     }
+
+    if (r < 0) {
+        return r;
+    }
+
+    return sd_bus_message_exit_container(msg);
 }
 
-void remove_extension(char *str) {
-    char *last_dot = strrchr(str, '.');
-    if (last_dot != NULL) {
-        *last_dot = '\0';
+static int get_all_properties(const char* unit_path, const char* interface, DetailsBuilder* builder) {
+    sd_bus_message *msg = NULL;
+    sd_bus_error error = SD_BUS_ERROR_NULL;
+    int r;
+
+    r = bus_call_method(
+        unit_path,
+        "org.freedesktop.DBus.Properties",
+        "GetAll",
+        &error,
+        &msg,
+        "s",
+        interface
+    );
+
+    if (r < 0) {
+        fprintf(stderr, "Failed to get %s properties: %s\n", interface, error.message ? error.message : strerror(-r));
+        sd_bus_error_free(&error);
+        return r;
+    }
+
+    r = read_all_properties(msg, interface, builder);
+    if (r < 0) {
+        fprintf(stderr, "Failed to read %s properties: %s\n", interface, strerror(-r));
     }
+
+    sd_bus_message_unref(msg);
+    return r;
+}
+
+static ServiceDetails* get_service_details(const char* service_name) {
+    DetailsBuilder builder;
+
+    if (!builder_init(&builder, service_name)) {
+        return NULL;
+    }
+
+    char* unit_path = load_unit_path(service_name);
+    if (unit_path) {
+        get_all_properties(unit_path, UNIT_INTERFACE, &builder);
+        if (is_service_unit(service_name)) {
+            get_all_properties(unit_path, SERVICE_INTERFACE, &builder);
+        }
+        free(unit_path);
+    }
+
+    return builder_finish(&builder);
 }
 
+ServiceDetails* getServiceDetails(const char* service_name) {
+    uint64_t start = statsNow();
+    ServiceDetails *details = get_service_details(service_name);
+    statsRecord(STAT_GET_SERVICE_DETAILS, start, details == NULL);
+    return details;
+}
+
+/* Packs details that were gathered elsewhere, e.g. from unit files by the offline scanner. */
+ServiceDetails* makeServiceDetails(const char* service_name, const char* description, const char* executable_path,
+                                   const char* executable_binary, const char* service_type, const char* service_account) {
+    DetailsBuilder builder;
+    const struct {
+        size_t offset;
+        const char *value;
+    } fields[] = {
+        { offsetof(ServiceDetails, description), description },
+        { offsetof(ServiceDetails, executable_path), executable_path },
+        { offsetof(ServiceDetails, executable_path_binary), executable_binary },
+        { offsetof(ServiceDetails, service_type), service_type },
+        { offsetof(ServiceDetails, service_account), service_account },
+    };
+
+    if (!builder_init(&builder, service_name)) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        if (fields[i].value && !builder_set_string(&builder, fields[i].offset, fields[i].value, strlen(fields[i].value))) {
+            free(builder.details);
+            return NULL;
+        }
+    }
+
+    return builder_finish(&builder);
+}
+
+/*
+ * Batch queries: instead of three blocking calls per service, every GetUnit
+ * and GetAll is sent with sd_bus_call_method_async and the replies are
+ * drained by one event loop, so N services cost roughly one round trip.
+ * The number of outstanding GetUnit calls is capped because dbus-daemon
+ * limits pending replies per connection (128 by default on the system bus).
+ */
+#define BATCH_MAX_IN_FLIGHT 32
+
+typedef struct QueryBatch QueryBatch;
+
 typedef struct {
-    char service_name[256];
-    char service_display_name[256];
-    char executable_path[1024];
-    char description[4192];
-    char service_type[1024];
-    char service_account[256];
-} ServiceDetails;
-
-void getServiceDetails(const char* service_name, ServiceDetails* details) {
-    memset(details, 0, sizeof(ServiceDetails));
-    snprintf(details->service_name, sizeof(details->service_name), "%s", service_name);
-
-    char* service_name_copy = strdup(service_name);
-    if (service_name_copy == NULL) {
-        fprintf(stderr, "Memory allocation failed\n");
-        return;
+    QueryBatch *batch;
+    size_t index;
+    DetailsBuilder builder;
+    sd_bus_slot *slots[3];
+    uint64_t sent[3];
+} BatchUnit;
+
+struct QueryBatch {
+    sd_bus *bus;
+    const char* const* names;
+    const char* const* unit_paths;
+    ServiceQueryResult *results;
+    BatchUnit *units;
+    size_t count;
+    size_t next;
+    size_t in_flight;
+    int error;
+};
+
+static int on_unit_properties(sd_bus_message* reply, void* userdata, sd_bus_error* ret_error) {
+    (void)ret_error;
+    BatchUnit *unit = userdata;
+    ServiceQueryResult *result = &unit->batch->results[unit->index];
+    const char *name = unit->batch->names[unit->index];
+    int r;
+
+    unit->batch->in_flight--;
+    statsRecord(STAT_BUS_GET_ALL, unit->sent[1], sd_bus_message_is_method_error(reply, NULL));
+
+    if (sd_bus_message_is_method_error(reply, NULL)) {
+        fprintf(stderr, "Failed to get unit properties of %s: %s\n", name, strerror(sd_bus_message_get_errno(reply)));
+        return 0;
     }
-    
-    remove_extension(service_name_copy);
-    snprintf(details->service_display_name, sizeof(details->service_display_name), "%s", service_name_copy);
 
-    free(service_name_copy);
+    r = read_all_properties(reply, UNIT_INTERFACE, &unit->builder);
+    if (r < 0) {
+        fprintf(stderr, "Failed to read unit properties of %s: %s\n", name, strerror(-r));
+    }
 
-    char command[COMMAND_BUFFER_SIZE];
-    char output[COMMAND_BUFFER_SIZE];
-    char *path_start;
-    snprintf(command, sizeof(command), "systemctl show -p FragmentPath %s", service_name);
+    result->running = details_string_equals(unit->builder.details, unit->builder.details->active_state, "active");
+    return 0;
+}
 
-    if (execute_command(command, output, sizeof(output)) != 0) {
-        fprintf(stderr, "Failed to execute command.\n");
-        return;
+static int on_service_properties(sd_bus_message* reply, void* userdata, sd_bus_error* ret_error) {
+    (void)ret_error;
+    BatchUnit *unit = userdata;
+    const char *name = unit->batch->names[unit->index];
+    int r;
+
+    unit->batch->in_flight--;
+    statsRecord(STAT_BUS_GET_ALL, unit->sent[2], sd_bus_message_is_method_error(reply, NULL));
+
+    if (sd_bus_message_is_method_error(reply, NULL)) {
+        fprintf(stderr, "Failed to get service properties of %s: %s\n", name, strerror(sd_bus_message_get_errno(reply)));
+        return 0;
     }
 
-    if ((path_start = strstr(output, "FragmentPath=")) != NULL) {
-        path_start += strlen("FragmentPath=");
-        path_start[strcspn(path_start, "\r\n")] = '\0';
+    r = read_all_properties(reply, SERVICE_INTERFACE, &unit->builder);
+    if (r < 0) {
+        fprintf(stderr, "Failed to read service properties of %s: %s\n", name, strerror(-r));
+    }
 
-        ServiceFileData data;
+    return 0;
+}
 
-        parse_service_file(path_start, &data);
+static int issue_get_all(QueryBatch* batch, BatchUnit* unit, const char* unit_path) {
+    int r;
 
-        if (strcmp(data.type, "") == 0) {
-            snprintf(details->service_type, sizeof(details->service_type), "Not specified");
-        } else {
-            snprintf(details->service_type, sizeof(details->service_type), "%s", data.type);
+    unit->sent[1] = unit->sent[2] = statsNow();
+    r = sd_bus_call_method_async(batch->bus, &unit->slots[1], DESTINATION, unit_path,
+        "org.freedesktop.DBus.Properties", "GetAll", on_unit_properties, unit, "s", UNIT_INTERFACE);
+    if (r < 0) {
+        return r;
+    }
+    batch->in_flight++;
+
+    if (!is_service_unit(batch->names[unit->index])) {
+        return 0;
+    }
+
+    r = sd_bus_call_method_async(batch->bus, &unit->slots[2], DESTINATION, unit_path,
+        "org.freedesktop.DBus.Properties", "GetAll", on_service_properties, unit, "s", SERVICE_INTERFACE);
+    if (r < 0) {
+        return r;
+    }
+    batch->in_flight++;
+
+    return 0;
+}
+
+static int on_get_unit(sd_bus_message* reply, void* userdata, sd_bus_error* ret_error) {
+    (void)ret_error;
+    BatchUnit *unit = userdata;
+    QueryBatch *batch = unit->batch;
+    ServiceQueryResult *result = &batch->results[unit->index];
+    const char *unit_path;
+    int r;
+
+    batch->in_flight--;
+    statsRecord(STAT_BUS_GET_UNIT, unit->sent[0], sd_bus_message_is_method_error(reply, NULL));
+
+    /* A missing unit is an expected answer, not a failure of the batch. */
+    if (sd_bus_message_is_method_error(reply, NULL)) {
+        return 0;
+    }
+
+    r = sd_bus_message_read(reply, "o", &unit_path);
+    if (r < 0) {
+        fprintf(stderr, "Failed to read unit object path: %s\n", strerror(-r));
+        return 0;
+    }
+
+    result->exists = true;
+
+    r = issue_get_all(batch, unit, unit_path);
+    if (r < 0) {
+        batch->error = r;
+    }
+
+    return 0;
+}
+
+static int issue_get_unit(QueryBatch* batch) {
+    BatchUnit *unit = &batch->units[batch->next];
+    const char *name = batch->names[batch->next];
+    int r;
+
+    unit->batch = batch;
+    unit->index = batch->next;
+    batch->next++;
+
+    if (!builder_init(&unit->builder, name)) {
+        return -ENOMEM;
+    }
+
+    /* Paths from listServiceUnits already prove the unit exists. */
+    if (batch->unit_paths && batch->unit_paths[unit->index]) {
+        batch->results[unit->index].exists = true;
+        return issue_get_all(batch, unit, batch->unit_paths[unit->index]);
+    }
+
+    unit->sent[0] = statsNow();
+    r = sd_bus_call_method_async(batch->bus, &unit->slots[0], DESTINATION, "/org/freedesktop/systemd1",
+        "org.freedesktop.systemd1.Manager", "GetUnit", on_get_unit, unit, "s", name);
+    if (r < 0) {
+        return r;
+    }
+
+    batch->in_flight++;
+    return 0;
+}
+
+/*
+ * Fills results[i] for names[i]: whether the unit exists (GetUnit), whether
+ * it is active, and its details. `unit_paths` may be NULL; where it has an
+ * object path (e.g. from listServiceUnits) the GetUnit call is skipped.
+ * Returns false if the bus failed midway; results not reached by then
+ * report exists == false. Release the results with freeServiceQueryResults().
+ */
+static bool query_services(const char* const* service_names, const char* const* unit_paths, size_t count, ServiceQueryResult* results) {
+    QueryBatch batch = {0};
+    int r = 0;
+
+    memset(results, 0, count * sizeof(ServiceQueryResult));
+
+    batch.bus = get_service_bus();
+    if (batch.bus == NULL) {
+        return false;
+    }
+
+    batch.units = calloc(count, sizeof(BatchUnit));
+    if (batch.units == NULL && count > 0) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return false;
+    }
+
+    batch.names = service_names;
+    batch.unit_paths = unit_paths;
+    batch.results = results;
+    batch.count = count;
+
+    while (batch.error == 0 && (batch.in_flight > 0 || batch.next < batch.count)) {
+        while (batch.error == 0 && batch.in_flight < BATCH_MAX_IN_FLIGHT && batch.next < batch.count) {
+            batch.error = issue_get_unit(&batch);
         }
 
-        if (strcmp(data.description, "") == 0) {
-            snprintf(details->description, sizeof(details->description), "Not specified");
-        } else {
-            snprintf(details->description, sizeof(details->description), "%s", data.description);
+        r = sd_bus_process(batch.bus, NULL);
+        if (r < 0) {
+            batch.error = r;
+            break;
+        }
+        if (r > 0) {
+            continue;
         }
 
-        if (strcmp(data.exec_start, "") == 0) {
-            snprintf(details->executable_path, sizeof(details->executable_path), "Not specified");
-        } else {
-            snprintf(details->executable_path, sizeof(details->executable_path), "%s", data.exec_start);
+        r = sd_bus_wait(batch.bus, UINT64_MAX);
+        if (r < 0 && r != -EINTR) {
+            batch.error = r;
         }
+    }
+
+    /* Unref'ing a pending slot cancels its callback, so none can outlive `batch`. */
+    for (size_t i = 0; i < count; i++) {
+        BatchUnit *unit = &batch.units[i];
 
-        if (strcmp(data.user, "") == 0) {
-            snprintf(details->service_account, sizeof(details->service_account), "Not specified");
+        for (size_t j = 0; j < 3; j++) {
+            sd_bus_slot_unref(unit->slots[j]);
+        }
+
+        if (unit->builder.details == NULL) {
+            results[i].exists = false;
+        } else if (results[i].exists) {
+            results[i].details = builder_finish(&unit->builder);
         } else {
-            snprintf(details->service_account, sizeof(details->service_account), "%s", data.user);
+            free(unit->builder.details);
+        }
+    }
+    free(batch.units);
+
+    if (batch.error < 0) {
+        fprintf(stderr, "Failed to query services: %s\n", strerror(-batch.error));
+        if (is_disconnect_error(batch.error)) {
+            drop_service_bus();
         }
+        return false;
     }
 
-    
+    return true;
 }
 
+/*
+ * Large batches are split into chunks that the worker pool queries in
+ * parallel, each worker on its own connection, so one connection's
+ * in-flight cap and reply parsing no longer bound the whole batch.
+ */
+#define QUERY_CHUNK_SIZE (2 * BATCH_MAX_IN_FLIGHT)
+
+typedef struct {
+    const char* const* names;
+    const char* const* unit_paths;
+    size_t count;
+    ServiceQueryResult *results;
+    atomic_bool failed;
+} QueryChunks;
+
+static void query_chunk(void* context, size_t index) {
+    QueryChunks *chunks = context;
+    size_t first = index * QUERY_CHUNK_SIZE;
+    size_t count = chunks->count - first < QUERY_CHUNK_SIZE ? chunks->count - first : QUERY_CHUNK_SIZE;
+
+    if (!query_services(chunks->names + first, chunks->unit_paths ? chunks->unit_paths + first : NULL,
+                        count, chunks->results + first)) {
+        atomic_store(&chunks->failed, true);
+    }
+}
+
+bool queryServices(const char* const* service_names, const char* const* unit_paths, size_t count, ServiceQueryResult* results) {
+    uint64_t start = statsNow();
+    bool ok;
+
+    if (count <= QUERY_CHUNK_SIZE) {
+        ok = query_services(service_names, unit_paths, count, results);
+    } else {
+        QueryChunks chunks = { .names = service_names, .unit_paths = unit_paths, .count = count, .results = results };
+        atomic_init(&chunks.failed, false);
+        runWork(query_chunk, &chunks, (count + QUERY_CHUNK_SIZE - 1) / QUERY_CHUNK_SIZE);
+        ok = !atomic_load(&chunks.failed);
+    }
+
+    statsRecord(STAT_QUERY_SERVICES, start, !ok);
+    return ok;
+}
+
+void freeServiceQueryResults(ServiceQueryResult* results, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        freeServiceDetails(results[i].details);
+        results[i].details = NULL;
+    }
+}
@@ -4,6 +4,10 @@
 #include <memory>
 #include <vector>
 #include <cstring>
+#include <cstdlib>
+#include <utility>
+
+#include "service.h"
 
 extern "C" _declspec() bool isServiceRunning(const char* service_name) {
 
@@ -53,30 +57,18 @@ extern "C" _declspec() bool doesServiceExist(const char* service_name) {
 }
 
 
-extern "C" {
-    struct ServiceDetails {
-        char service_name[256];
-        char service_display_name[256];
-        char executable_path[1024];
-        char description[4192];
-        char service_type[1024];
-        char service_account[256];
-    };
-
-    __declspec(dllexport) void getServiceDetails(const char* service_name, ServiceDetails* details);
-
-    __declspec(dllexport) void freeServiceDetails(ServiceDetails* details);
-}
+/* Strings gathered for one service before they are packed into a ServiceDetails. */
+struct ServiceDetailStrings {
+    std::string service_name;
+    std::string service_display_name;
+    std::string executable_path;
+    std::string description;
+    std::string service_type;
+    std::string service_account;
+};
 
-void getServiceDetails(const char* service_name, ServiceDetails* details) {
-    memset(details, 0, sizeof(ServiceDetails));
-
-    strncpy_s(
-        details->service_name,
-        sizeof(details->service_name),
-        service_name,
-        sizeof(details->service_name)
-    );
+static void queryServiceDetails(const char* service_name, ServiceDetailStrings& details) {
+    details.service_name = service_name;
 
     SC_HANDLE sc_manager = OpenSCManager(NULL, NULL, SC_MANAGER_CONNECT);
     if (!sc_manager) {
@@ -96,12 +88,7 @@ void getServiceDetails(const char* service_name, ServiceDetails* details) {
 
     if (QueryServiceStatusEx(service, SC_STATUS_PROCESS_INFO, reinterpret_cast<LPBYTE>(&ssp), sizeof(SERVICE_STATUS_PROCESS), &bytesNeeded)) {
         std::string serviceType = (ssp.dwServiceType & SERVICE_WIN32_OWN_PROCESS) ? "Own Process" : "Shared Process";
-        strncpy_s(
-            details->service_type,
-            sizeof(details->service_type),
-            serviceType.c_str(),
-            sizeof(details->service_type) - 1
-        );
+        details.service_type = serviceType;
         
     } else {
         std::cerr << "Failed to query service status. Error: " << GetLastError() << std::endl;
@@ -125,35 +112,15 @@ void getServiceDetails(const char* service_name, ServiceDetails* details) {
     }
 
     if (pServiceConfig->lpBinaryPathName != NULL) {
-        strncpy_s(
-            details->executable_path,
-            sizeof(details->executable_path),
-            pServiceConfig->lpBinaryPathName,
-            sizeof(details->executable_path) - 1
-        );
+        details.executable_path = pServiceConfig->lpBinaryPathName;
     } else {
-        strncpy_s(
-            details->executable_path,
-            sizeof(details->executable_path),
-            "no executable path provided",
-            sizeof(details->executable_path) - 1
-        );
+        details.executable_path = "no executable path provided";
     }
 
     if (pServiceConfig->lpServiceStartName != NULL) {
-        strncpy_s(
-            details->service_account,
-            sizeof(details->service_account),
-            pServiceConfig->lpServiceStartName,
-            sizeof(details->service_account)
-        );
+        details.service_account = pServiceConfig->lpServiceStartName;
     } else {
-        strncpy_s(
-            details->service_account,
-            sizeof(details->service_account),
-            "no service account was provided",
-            sizeof(details->service_account)
-        );
+        details.service_account = "no service account was provided";
     }
 
     
@@ -179,26 +146,64 @@ void getServiceDetails(const char* service_name, ServiceDetails* details) {
     SERVICE_DESCRIPTION* description = reinterpret_cast<SERVICE_DESCRIPTION*>(descBuffer.data());
    
     if (description->lpDescription) {
-        strncpy_s(details->description, sizeof(details->description), description->lpDescription, _TRUNCATE);
+        details.description = description->lpDescription;
     } else {
-        strncpy_s(details->description, sizeof(details->description), "no description provided", _TRUNCATE);
+        details.description = "no description provided";
     }
 
     char displayName[256];
     DWORD displayNameSize = sizeof(displayName) / sizeof(displayName[0]);
     if (GetServiceDisplayNameA(sc_manager, service_name, displayName, &displayNameSize)) {
-        strncpy_s(
-            details->service_display_name,
-            sizeof(details->service_display_name),
-            displayName,
-            sizeof(details->service_display_name) - 1 
-        );
+        details.service_display_name = displayName;
         
     }
     CloseServiceHandle(sc_manager);
     CloseServiceHandle(service);
-} 
+}
 
+static void packString(ServiceDetails* details, ServiceString ServiceDetails::* field, const std::string& value) {
+    ServiceString& string = details->*field;
+    string.offset = details->size;
+    string.length = static_cast<uint32_t>(value.size());
+    memcpy(details->data + details->size, value.c_str(), value.size() + 1);
+    details->size += string.length + 1;
+}
+
+ServiceDetails* getServiceDetails(const char* service_name) {
+    ServiceDetailStrings strings;
+    queryServiceDetails(service_name, strings);
+
+    const std::pair<ServiceString ServiceDetails::*, const std::string*> fields[] = {
+        { &ServiceDetails::service_name, &strings.service_name },
+        { &ServiceDetails::service_display_name, &strings.service_display_name },
+        { &ServiceDetails::executable_path, &strings.executable_path },
+        { &ServiceDetails::description, &strings.description },
+        { &ServiceDetails::service_type, &strings.service_type },
+        { &ServiceDetails::service_account, &strings.service_account },
+    };
+
+    size_t data_size = 1;
+    for (const auto& field : fields) {
+        data_size += field.second->size() + 1;
+    }
+
+    ServiceDetails* details = static_cast<ServiceDetails*>(calloc(1, SERVICE_DETAILS_SIZE(data_size)));
+    if (!details) {
+        std::cerr << "failed to allocate service details\n";
+        return nullptr;
+    }
+
+    details->size = 1;
+    for (const auto& field : fields) {
+        packString(details, field.first, *field.second);
+    }
+
+    return details;
+}
+
+void freeServiceDetails(ServiceDetails* details) {
+    free(details);
+}
 
 std::wstring ConvertLPSTRToWString(const LPSTR ansiStr) {
     if (ansiStr == nullptr) {
@@ -0,0 +1,326 @@
+#ifndef SERVICE_VIEWER_SERVICE_H
+#define SERVICE_VIEWER_SERVICE_H
+
+/*
+ * Types shared by the native backends (service.c on Linux, service.cpp on
+ * Windows) and mirrored by the #[repr(C)] structs in main.rs. Keep all three
+ * in sync when changing a layout.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __linux__
+#include "unit_cache.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A NUL-terminated string of `length` bytes at `data + offset` of its
+ * ServiceDetails. Unset strings are {0, 0}; data[0] is always NUL.
+ */
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+} ServiceString;
+
+/*
+ * Unit properties shown in the details pane. On Linux each line also drives
+ * the GetAll decoder in service.c, so adding a column is a single line here
+ * (plus the Rust mirror).
+ *
+ * An EXEC property fills two strings: `field`, every command line's argv
+ * joined, and right behind it `field_binary`, the path systemd resolved for
+ * the first command (the tuple's own path, which argv[0] need not name).
+ *
+ * X(interface, D-Bus property, kind, field)
+ */
+#define SERVICE_PROPERTIES(X) \
+    X(SERVICE, "ExecStart",            EXEC,   executable_path)        \
+    X(UNIT,    "Description",          STRING, description)            \
+    X(SERVICE, "Type",                 STRING, service_type)           \
+    X(SERVICE, "User",                 STRING, service_account)        \
+    X(UNIT,    "LoadState",            STRING, load_state)             \
+    X(UNIT,    "ActiveState",          STRING, active_state)           \
+    X(UNIT,    "SubState",             STRING, sub_state)              \
+    X(SERVICE, "ControlGroup",         STRING, control_group)          \
+    X(UNIT,    "StateChangeTimestamp", U64,    state_change_timestamp) \
+    X(UNIT,    "ActiveEnterTimestamp", U64,    active_enter_timestamp) \
+    X(UNIT,    "ActiveExitTimestamp",  U64,    active_exit_timestamp)  \
+    X(SERVICE, "MemoryCurrent",        U64,    memory_current)         \
+    X(SERVICE, "CPUUsageNSec",         U64,    cpu_usage_nsec)         \
+    X(SERVICE, "MainPID",              U32,    main_pid)               \
+    X(SERVICE, "NRestarts",            U32,    restart_count)
+
+#define DECLARE_STRING(field) ServiceString field;
+#define DECLARE_EXEC(field)   ServiceString field; ServiceString field##_binary;
+#define DECLARE_U64(field)    uint64_t field;
+#define DECLARE_U32(field)    uint32_t field;
+#define DECLARE_PROPERTY(iface, name, kind, field) DECLARE_##kind(field)
+
+/*
+ * Details of one service in a single allocation: fixed fields followed by
+ * the string bytes they point into. Release with freeServiceDetails().
+ * `data` is declared with one element so the header stays valid C++;
+ * size allocations with SERVICE_DETAILS_SIZE, never sizeof.
+ */
+typedef struct {
+    ServiceString service_name;
+    ServiceString service_display_name;
+    SERVICE_PROPERTIES(DECLARE_PROPERTY)
+    uint32_t size;
+    char data[1];
+} ServiceDetails;
+
+#define SERVICE_DETAILS_SIZE(data_size) (offsetof(ServiceDetails, data) + (data_size))
+
+ServiceDetails* getServiceDetails(const char* service_name);
+void freeServiceDetails(ServiceDetails* details);
+
+#ifdef __linux__
+/*
+ * Details from strings gathered elsewhere; NULL or empty fields read "Not
+ * specified", except `executable_binary`, which stays empty.
+ */
+ServiceDetails* makeServiceDetails(const char* service_name, const char* description, const char* executable_path,
+                                   const char* executable_binary, const char* service_type, const char* service_account);
+#endif
+
+typedef struct {
+    bool exists;
+    bool running;
+    ServiceDetails *details;
+} ServiceQueryResult;
+
+/* One ListUnits record; all strings are owned by the record. */
+typedef struct {
+    char *name;
+    char *description;
+    char *load_state;
+    char *active_state;
+    char *sub_state;
+    char *object_path;
+} ServiceUnitRecord;
+
+#ifdef __linux__
+struct sd_bus;
+
+/*
+ * Connects to the bus at `address` (e.g. "unix:path=/run/test/bus") instead
+ * of the system bus; NULL goes back to the system bus. Call it before any
+ * other entry point: threads that are already connected keep their bus.
+ */
+bool setServiceBusAddress(const char* address);
+
+/* Opens a new connection to the configured bus. */
+int openServiceBus(struct sd_bus** bus);
+
+/* Closes the calling thread's shared bus connection. */
+void closeServiceBus(void);
+
+char** serviceNamesArray(size_t* count);
+void freeServiceNameArray(char** array, size_t count);
+
+ServiceUnitRecord* listServiceUnits(const char* const* patterns, size_t pattern_count, const char* const* states, size_t state_count, size_t* count);
+void freeServiceUnitRecords(ServiceUnitRecord* records, size_t count);
+bool queryServices(const char* const* service_names, const char* const* unit_paths, size_t count, ServiceQueryResult* results);
+void freeServiceQueryResults(ServiceQueryResult* results, size_t count);
+
+/*
+ * Offline backend (offline.c): units of the file system under `root`, read
+ * from the unit files instead of a running systemd. openOfflineQuery() finds
+ * and selects the unit files; each readOfflineServices() parses the next
+ * ones, ordered by unit file name, into at most `capacity` results and
+ * returns how many it filled, 0 once all are read. A caller thus holds no
+ * more than one batch of details at once. Release each batch with
+ * freeServiceQueryResults().
+ */
+typedef struct OfflineQuery OfflineQuery;
+OfflineQuery* openOfflineQuery(const char* root, const char* const* patterns, size_t pattern_count);
+size_t readOfflineServices(OfflineQuery* query, ServiceQueryResult* results, size_t capacity);
+void closeOfflineQuery(OfflineQuery* query);
+
+/* Unit cache hits and misses of the last offline query. */
+void getOfflineCacheStats(UnitCacheStats* stats);
+
+/*
+ * Live updates (watch.c). CHANGED covers both new and modified units and
+ * carries fresh details; REMOVED only the name. RESYNC, with neither,
+ * follows a reconnect: updates may have been missed, so load everything.
+ */
+typedef enum {
+    SERVICE_EVENT_CHANGED,
+    SERVICE_EVENT_REMOVED,
+    SERVICE_EVENT_RESYNC,
+} ServiceEventKind;
+
+typedef struct {
+    ServiceEventKind kind;
+    bool running;
+    char *name;
+    ServiceDetails *details;
+} ServiceEvent;
+
+/* Watches units matching any of `patterns` (all if none) from a background thread. */
+bool startServiceWatch(const char* const* patterns, size_t pattern_count);
+void stopServiceWatch(void);
+
+/* Whether the watch is subscribed right now; false while it reconnects, and without a watch. */
+bool isServiceWatchConnected(void);
+
+/* Moves up to `max` queued events into `events` without blocking; release them with freeServiceEvents(). */
+size_t pollServiceEvents(ServiceEvent* events, size_t max);
+void freeServiceEvents(ServiceEvent* events, size_t count);
+
+/*
+ * Resource use of one cgroup (cgroup.c), read from its cgroup v2 files.
+ * Counters of controllers that are not enabled for it stay 0.
+ */
+typedef struct {
+    bool valid;               /* the cgroup exists */
+    uint64_t memory_current;  /* memory.current, bytes */
+    uint64_t cpu_usage_usec;  /* usage_usec from cpu.stat */
+    uint64_t io_read_bytes;   /* rbytes from io.stat, summed over devices */
+    uint64_t io_write_bytes;  /* wbytes from io.stat, summed over devices */
+    uint64_t pids_current;    /* pids.current */
+} CgroupSample;
+
+/*
+ * Samples the cgroups at `control_groups` (ControlGroup property values;
+ * NULL or "" for units without one) into the parallel `samples`. Their
+ * files stay open until a call that does not ask for them, so sampling the
+ * same units on a tick is one pread() per file. False without a cgroup v2
+ * hierarchy.
+ */
+bool sampleCgroups(const char* const* control_groups, size_t count, CgroupSample* samples);
+
+/* Closes every file kept open by sampleCgroups(). */
+void closeCgroupSampler(void);
+
+/*
+ * Dependency graph of every loaded unit (graph.c), from Requires=, Wants=,
+ * BindsTo=, After= and Before=. Units are numbered 0 .. count - 1; units
+ * only named as dependencies get an id too. Read-only once loaded, so it
+ * may be queried from any thread.
+ */
+typedef struct ServiceGraph ServiceGraph;
+
+typedef enum {
+    SERVICE_GRAPH_PULLS_IN,        /* Requires=, BindsTo= and Wants=, transitively */
+    SERVICE_GRAPH_STOPS_WITH,      /* units that Require or BindsTo it, transitively */
+    SERVICE_GRAPH_CRITICAL_CHAIN,  /* the After= units each start waited for last */
+} ServiceGraphQuery;
+
+/* One row of a query result; rows are in tree preorder, the queried unit first at depth 0. */
+typedef struct {
+    uint32_t unit;
+    uint32_t depth;
+    uint64_t activating_usec;  /* InactiveExitTimestampMonotonic, 0 if unknown */
+    uint64_t active_usec;      /* ActiveEnterTimestampMonotonic, 0 if unknown */
+} ServiceGraphNode;
+
+/* Lists all units and loads their dependencies in one pipelined pass; NULL on failure. */
+ServiceGraph* loadServiceGraph(void);
+void freeServiceGraph(ServiceGraph* graph);
+
+size_t serviceGraphUnitCount(const ServiceGraph* graph);
+const char* serviceGraphUnitName(const ServiceGraph* graph, uint32_t unit);
+bool serviceGraphFindUnit(const ServiceGraph* graph, const char* name, uint32_t* unit);
+
+/* When userspace started (UserspaceTimestampMonotonic), for times relative to boot; 0 if unknown. */
+uint64_t serviceGraphUserspaceUsec(const ServiceGraph* graph);
+
+/*
+ * Writes up to `max` rows for `query` from `unit`. Every unit appears at
+ * most once, so serviceGraphUnitCount() rows always suffice.
+ */
+size_t queryServiceGraph(const ServiceGraph* graph, ServiceGraphQuery query, uint32_t unit, ServiceGraphNode* nodes, size_t max);
+
+/*
+ * Tails of single units' journals (journal.c). Each unit read keeps its
+ * cursor and its newest `capacity` lines, so reads on a tick only walk new
+ * entries. Not thread-safe; use a tail from one thread.
+ */
+typedef struct JournalTail JournalTail;
+
+/* Opens the local journal, or the journal files under `directory` if not NULL; NULL on failure. */
+JournalTail* openJournalTail(const char* directory, size_t capacity);
+void closeJournalTail(JournalTail* tail);
+
+/*
+ * Reads the entries of `unit` (by _SYSTEMD_UNIT=) added since its last
+ * read, the newest `capacity` on the first, and returns how many there
+ * were; -1 on failure.
+ */
+int readJournalTail(JournalTail* tail, const char* unit);
+
+/*
+ * Points `lines` at up to `max` of the newest buffered lines of `unit`,
+ * oldest first, and returns how many. They stay valid until the next
+ * readJournalTail() or closeJournalTail().
+ */
+size_t journalTailLines(JournalTail* tail, const char* unit, const char** lines, size_t max);
+
+/*
+ * SHA-256 of the binaries services run (integrity.c). Digests are cached
+ * in $XDG_CACHE_HOME/service_viewer/hashes.cache by (dev, inode, mtime,
+ * size), so only files changed since an earlier run are read again.
+ */
+#define EXECUTABLE_HASH_SIZE 32
+
+typedef struct {
+    char *path;        /* the binary as the unit names it, below the root; NULL if there is none */
+    int error;         /* errno if it could not be found or read, else 0 */
+    bool cached;       /* the digest came from the cache */
+    uint8_t sha256[EXECUTABLE_HASH_SIZE];
+} ExecutableHash;
+
+/*
+ * Hashes the binary of each unit: `binaries[i]` (executable_path_binary,
+ * as systemd resolved it) if set. Only below a `root`, where no systemd
+ * resolved one, is it guessed from `commands[i]` (executable_path): its
+ * first word, looked up in systemd's search path if not absolute. Below
+ * `root`, symlinks are followed inside it, as they would be in the image.
+ * Units with neither get a NULL path and no error. Distinct files are
+ * mapped and hashed in parallel on the work pool. Release the paths with
+ * freeExecutableHashes().
+ */
+bool hashExecutables(const char* root, const char* const* binaries, const char* const* commands, size_t count,
+                     ExecutableHash* hashes);
+void freeExecutableHashes(ExecutableHash* hashes, size_t count);
+
+/* SHA-256 of `length` bytes at `data`, as hashExecutables() computes it for a file. */
+void sha256Digest(const void* data, size_t length, uint8_t digest[EXECUTABLE_HASH_SIZE]);
+
+/* Frees the in-memory cache; the next call loads it again. */
+void closeHashCache(void);
+
+/*
+ * Call counts and latencies since start (stats.c), one entry per FFI entry
+ * point, bus method and parse step, including ones never called.
+ */
+#define SERVICE_STATS_BUCKETS 32
+
+typedef struct {
+    const char *name;
+    uint64_t calls;
+    uint64_t errors;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    /* buckets[i] counts calls that took [2^i, 2^(i+1)) ns; the last one also everything slower. */
+    uint64_t buckets[SERVICE_STATS_BUCKETS];
+} ServiceViewerStat;
+
+/* Fills up to `max` entries and returns how many there are in total. */
+size_t getServiceViewerStats(ServiceViewerStat* stats, size_t max);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,528 @@
+//! `--snapshot FILE` writes every selected unit to a compact binary file; `--diff A B`
+//! compares two of them. Records are sorted by unit name and strings are interned into
+//! one table, so a diff is a single merge-walk over two read-only mappings with no parsing.
+//!
+//! Layout, all integers little-endian:
+//! - header: magic (8 bytes), record count, string count and string bytes (u64 each)
+//! - records: `STRING_FIELDS` as u32 string ids, `NUMBER_FIELDS` as u64, u64 flags
+//! - string table: string count + 1 u32 offsets, then the string bytes
+
+use super::*;
+use std::cmp::Ordering;
+use std::fs::File;
+use std::io::BufWriter;
+use std::os::unix::io::AsRawFd;
+
+const MAGIC: &[u8; 8] = b"SVSNAP\x00\x01";
+const HEADER_SIZE: usize = 32;
+
+/// Units whose details are fetched and released together while collecting.
+const SNAPSHOT_CHUNK: usize = 256;
+
+/// The unit name comes first; records are sorted by it.
+const STRING_FIELDS: [&str; 8] = [
+    "unit", "description", "active_state", "sub_state", "type", "exec_start", "user", "control_group",
+];
+
+/// Counters and timestamps (u64::MAX where systemd has none). Only the marked ones are
+/// compared; the others change on their own between any two snapshots.
+const NUMBER_FIELDS: [(&str, bool); 7] = [
+    ("main_pid", false),
+    ("restarts", true),
+    ("memory_bytes", false),
+    ("cpu_nsec", false),
+    ("state_change_usec", false),
+    ("active_enter_usec", false),
+    ("active_exit_usec", false),
+];
+
+const FLAG_RUNNING: u64 = 1;
+/// Details were loaded; without them only the listing's strings are set.
+const FLAG_DETAILS: u64 = 2;
+
+const RECORD_SIZE: usize = STRING_FIELDS.len() * 4 + NUMBER_FIELDS.len() * 8 + 8;
+
+struct Record {
+    strings: [String; STRING_FIELDS.len()],
+    numbers: [u64; NUMBER_FIELDS.len()],
+    flags: u64,
+}
+
+impl Record {
+    fn new(unit_name: &str, description: &str, active_state: &str, running: bool, details: Option<&ServiceDetails>) -> Self {
+        let running = if running { FLAG_RUNNING } else { 0 };
+        match details {
+            Some(d) => Record {
+                strings: [
+                    unit_name.to_string(),
+                    d.str(d.description).into_owned(),
+                    d.str(d.active_state).into_owned(),
+                    d.str(d.sub_state).into_owned(),
+                    d.str(d.service_type).into_owned(),
+                    d.str(d.executable_path).into_owned(),
+                    d.str(d.service_account).into_owned(),
+                    d.str(d.control_group).into_owned(),
+                ],
+                numbers: [
+                    d.main_pid as u64,
+                    d.restart_count as u64,
+                    d.memory_current,
+                    d.cpu_usage_nsec,
+                    d.state_change_timestamp,
+                    d.active_enter_timestamp,
+                    d.active_exit_timestamp,
+                ],
+                flags: running | FLAG_DETAILS,
+            },
+            None => Record {
+                strings: [
+                    unit_name.to_string(),
+                    description.to_string(),
+                    active_state.to_string(),
+                    String::new(),
+                    String::new(),
+                    String::new(),
+                    String::new(),
+                    String::new(),
+                ],
+                numbers: [u64::MAX; NUMBER_FIELDS.len()],
+                flags: running,
+            },
+        }
+    }
+}
+
+/// The selected units, the same ones `--export` would write.
+fn collect(root: Option<&str>) -> Vec<Record> {
+    let mut records = Vec::new();
+    let query = SERVICES.lock().unwrap();
+
+    if let Some(root) = root {
+        let patterns: Vec<String> = query.unit_patterns().iter().map(|p| p.to_string()).collect();
+        query_offline_services_with(root, &patterns, |details| {
+            records.push(Record::new(&details.str(details.service_name), "", "", false, Some(details)));
+        });
+        return records;
+    }
+
+    let states: Vec<&str> = query.states.iter().map(String::as_str).collect();
+    let units = list_service_units(&query.unit_patterns(), &states);
+    drop(query);
+
+    records.reserve(units.len());
+    for chunk in units.chunks(SNAPSHOT_CHUNK) {
+        let names: Vec<&str> = chunk.iter().map(|unit| unit.name.as_str()).collect();
+        let paths: Vec<&str> = chunk.iter().map(|unit| unit.object_path.as_str()).collect();
+        query_services_with(&names, Some(&paths), |i, running, details| {
+            let unit = &chunk[i];
+            records.push(Record::new(&unit.name, &unit.description, &unit.active_state, running, details));
+        });
+    }
+    records
+}
+
+/// Deduplicated strings: `offsets[id] .. offsets[id + 1]` in `bytes`.
+struct Strings {
+    ids: HashMap<String, u32>,
+    offsets: Vec<u32>,
+    bytes: Vec<u8>,
+}
+
+impl Strings {
+    fn new() -> Self {
+        Strings { ids: HashMap::new(), offsets: vec![0], bytes: Vec::new() }
+    }
+
+    fn intern(&mut self, value: &str) -> io::Result<u32> {
+        if let Some(&id) = self.ids.get(value) {
+            return Ok(id);
+        }
+        let id = self.ids.len() as u32;
+        self.bytes.extend_from_slice(value.as_bytes());
+        let end = u32::try_from(self.bytes.len()).map_err(|_| io::Error::new(io::ErrorKind::InvalidData, "snapshot strings exceed 4 GiB"))?;
+        self.offsets.push(end);
+        self.ids.insert(value.to_string(), id);
+        Ok(id)
+    }
+}
+
+/// Writes the snapshot next to `path` and renames it into place; returns the unit count.
+pub fn write(path: &str, root: Option<&str>) -> io::Result<usize> {
+    write_records(path, collect(root))
+}
+
+fn write_records(path: &str, mut records: Vec<Record>) -> io::Result<usize> {
+    records.sort_unstable_by(|a, b| a.strings[0].cmp(&b.strings[0]));
+    records.dedup_by(|a, b| a.strings[0] == b.strings[0]);
+
+    let mut strings = Strings::new();
+    let mut body = Vec::with_capacity(records.len() * RECORD_SIZE);
+    for record in &records {
+        for value in &record.strings {
+            body.extend_from_slice(&strings.intern(value)?.to_le_bytes());
+        }
+        for value in record.numbers {
+            body.extend_from_slice(&value.to_le_bytes());
+        }
+        body.extend_from_slice(&record.flags.to_le_bytes());
+    }
+
+    let temporary = format!("{}.tmp", path);
+    let mut out = BufWriter::new(File::create(&temporary)?);
+    out.write_all(MAGIC)?;
+    for value in [records.len(), strings.offsets.len() - 1, strings.bytes.len()] {
+        out.write_all(&(value as u64).to_le_bytes())?;
+    }
+    out.write_all(&body)?;
+    for offset in &strings.offsets {
+        out.write_all(&offset.to_le_bytes())?;
+    }
+    out.write_all(&strings.bytes)?;
+    out.into_inner().map_err(|err| err.into_error())?.sync_all()?;
+    std::fs::rename(&temporary, path)?;
+    Ok(records.len())
+}
+
+/// A file mapped read-only for as long as this lives.
+struct Mapping {
+    address: *mut libc::c_void,
+    length: usize,
+}
+
+impl Mapping {
+    fn open(path: &str) -> io::Result<Self> {
+        let file = File::open(path)?;
+        let length = file.metadata()?.len() as usize;
+        if length < HEADER_SIZE {
+            return Err(invalid(path, "too short"));
+        }
+        let address = unsafe { libc::mmap(std::ptr::null_mut(), length, libc::PROT_READ, libc::MAP_PRIVATE, file.as_raw_fd(), 0) };
+        if address == libc::MAP_FAILED {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(Mapping { address, length })
+    }
+
+    fn bytes(&self) -> &[u8] {
+        unsafe { slice::from_raw_parts(self.address as *const u8, self.length) }
+    }
+}
+
+impl Drop for Mapping {
+    fn drop(&mut self) {
+        unsafe { libc::munmap(self.address, self.length) };
+    }
+}
+
+fn invalid(path: &str, reason: &str) -> io::Error {
+    io::Error::new(io::ErrorKind::InvalidData, format!("{} is not a valid snapshot: {}", path, reason))
+}
+
+fn u32_at(bytes: &[u8], at: usize) -> u32 {
+    u32::from_le_bytes(bytes[at..at + 4].try_into().unwrap())
+}
+
+fn u64_at(bytes: &[u8], at: usize) -> u64 {
+    u64::from_le_bytes(bytes[at..at + 8].try_into().unwrap())
+}
+
+/// A mapped snapshot; fields are read in place.
+struct Snapshot {
+    mapping: Mapping,
+    count: usize,
+    string_count: usize,
+    offsets_at: usize,
+    strings_at: usize,
+}
+
+impl Snapshot {
+    /// Maps `path` and checks that every record and string lies inside it.
+    fn open(path: &str) -> io::Result<Self> {
+        let mapping = Mapping::open(path)?;
+        let bytes = mapping.bytes();
+        if &bytes[..8] != MAGIC {
+            return Err(invalid(path, "bad magic"));
+        }
+
+        let count = u64_at(bytes, 8) as usize;
+        let string_count = u64_at(bytes, 16) as usize;
+        let string_bytes = u64_at(bytes, 24) as usize;
+        let offsets_at = count.checked_mul(RECORD_SIZE).and_then(|size| size.checked_add(HEADER_SIZE));
+        let strings_at = offsets_at.and_then(|at| string_count.checked_add(1)?.checked_mul(4)?.checked_add(at));
+        let (Some(offsets_at), Some(strings_at)) = (offsets_at, strings_at) else {
+            return Err(invalid(path, "bad header"));
+        };
+        if strings_at.checked_add(string_bytes) != Some(bytes.len()) {
+            return Err(invalid(path, "size does not match its header"));
+        }
+
+        let mut previous = 0;
+        for id in 0..=string_count {
+            let offset = u32_at(bytes, offsets_at + id * 4) as usize;
+            if offset < previous || offset > string_bytes {
+                return Err(invalid(path, "bad string table"));
+            }
+            previous = offset;
+        }
+        for record in 0..count {
+            for field in 0..STRING_FIELDS.len() {
+                if u32_at(bytes, HEADER_SIZE + record * RECORD_SIZE + field * 4) as usize >= string_count {
+                    return Err(invalid(path, "bad string id"));
+                }
+            }
+        }
+
+        Ok(Snapshot { mapping, count, string_count, offsets_at, strings_at })
+    }
+
+    fn string(&self, record: usize, field: usize) -> &[u8] {
+        let bytes = self.mapping.bytes();
+        let id = u32_at(bytes, HEADER_SIZE + record * RECORD_SIZE + field * 4) as usize;
+        debug_assert!(id < self.string_count);
+        let start = u32_at(bytes, self.offsets_at + id * 4) as usize;
+        let end = u32_at(bytes, self.offsets_at + id * 4 + 4) as usize;
+        &bytes[self.strings_at + start..self.strings_at + end]
+    }
+
+    fn number(&self, record: usize, field: usize) -> u64 {
+        u64_at(self.mapping.bytes(), HEADER_SIZE + record * RECORD_SIZE + STRING_FIELDS.len() * 4 + field * 8)
+    }
+
+    fn flags(&self, record: usize) -> u64 {
+        u64_at(self.mapping.bytes(), HEADER_SIZE + record * RECORD_SIZE + RECORD_SIZE - 8)
+    }
+
+    fn name(&self, record: usize) -> &[u8] {
+        self.string(record, 0)
+    }
+}
+
+fn text(bytes: &[u8]) -> Cow<'_, str> {
+    String::from_utf8_lossy(bytes)
+}
+
+fn number_text(value: u64) -> String {
+    if value == u64::MAX { "-".to_string() } else { value.to_string() }
+}
+
+/// One `~` line per changed field of a unit in both snapshots; returns whether any changed.
+fn write_changes(out: &mut impl Write, old: &Snapshot, i: usize, new: &Snapshot, j: usize) -> io::Result<bool> {
+    let name = text(old.name(i));
+    let mut changed = false;
+
+    let (old_running, new_running) = (old.flags(i) & FLAG_RUNNING != 0, new.flags(j) & FLAG_RUNNING != 0);
+    if old_running != new_running {
+        writeln!(out, "~ {} running: {} -> {}", name, old_running, new_running)?;
+        changed = true;
+    }
+    for (field, label) in STRING_FIELDS.iter().enumerate().skip(1) {
+        let (before, after) = (old.string(i, field), new.string(j, field));
+        if before != after {
+            writeln!(out, "~ {} {}: {:?} -> {:?}", name, label, text(before), text(after))?;
+            changed = true;
+        }
+    }
+    for (field, &(label, compared)) in NUMBER_FIELDS.iter().enumerate() {
+        let (before, after) = (old.number(i, field), new.number(j, field));
+        if compared && before != after {
+            writeln!(out, "~ {} {}: {} -> {}", name, label, number_text(before), number_text(after))?;
+            changed = true;
+        }
+    }
+    Ok(changed)
+}
+
+/// Prints units only in `new` (+), only in `old` (-) and the fields that changed (~);
+/// returns whether there were any differences.
+pub fn diff(old_path: &str, new_path: &str) -> io::Result<bool> {
+    let stdout = io::stdout();
+    let mut out = BufWriter::new(stdout.lock());
+    let differ = diff_to(&mut out, old_path, new_path)?;
+    out.flush()?;
+    Ok(differ)
+}
+
+fn diff_to(out: &mut impl Write, old_path: &str, new_path: &str) -> io::Result<bool> {
+    let old = Snapshot::open(old_path)?;
+    let new = Snapshot::open(new_path)?;
+    let state = |snapshot: &Snapshot, record: usize| {
+        format!("{}/{}", text(snapshot.string(record, 2)), text(snapshot.string(record, 3)))
+    };
+
+    let (mut i, mut j) = (0, 0);
+    let mut differ = false;
+    while i < old.count || j < new.count {
+        let order = if i == old.count {
+            Ordering::Greater
+        } else if j == new.count {
+            Ordering::Less
+        } else {
+            old.name(i).cmp(new.name(j))
+        };
+        match order {
+            Ordering::Less => {
+                writeln!(out, "- {} {}", text(old.name(i)), state(&old, i))?;
+                differ = true;
+                i += 1;
+            }
+            Ordering::Greater => {
+                writeln!(out, "+ {} {}", text(new.name(j)), state(&new, j))?;
+                differ = true;
+                j += 1;
+            }
+            Ordering::Equal => {
+                differ |= write_changes(out, &old, i, &new, j)?;
+                i += 1;
+                j += 1;
+            }
+        }
+    }
+    Ok(differ)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// A path in the temp dir that is removed when dropped.
+    struct TempFile(String);
+
+    impl TempFile {
+        fn new(name: &str) -> Self {
+            TempFile(std::env::temp_dir().join(format!("snapshot_test.{}.{}", std::process::id(), name)).to_string_lossy().into_owned())
+        }
+    }
+
+    impl Drop for TempFile {
+        fn drop(&mut self) {
+            let _ = std::fs::remove_file(&self.0);
+        }
+    }
+
+    fn record(name: &str, sub_state: &str, restarts: u64) -> Record {
+        let mut record = Record::new(name, "Test unit", "active", true, None);
+        record.strings[3] = sub_state.to_string();
+        record.numbers[1] = restarts;
+        record
+    }
+
+    fn written(name: &str, records: Vec<Record>) -> TempFile {
+        let file = TempFile::new(name);
+        write_records(&file.0, records).unwrap();
+        file
+    }
+
+    fn diff_text(old: &TempFile, new: &TempFile) -> (bool, String) {
+        let mut out = Vec::new();
+        let differ = diff_to(&mut out, &old.0, &new.0).unwrap();
+        (differ, String::from_utf8(out).unwrap())
+    }
+
+    fn open_error(name: &str, bytes: &[u8]) -> String {
+        let file = TempFile::new(name);
+        std::fs::write(&file.0, bytes).unwrap();
+        match Snapshot::open(&file.0) {
+            Ok(_) => String::new(),
+            Err(err) => err.to_string(),
+        }
+    }
+
+    #[test]
+    fn round_trip() {
+        let mut first = record("b.service", "running", 3);
+        first.strings[5] = "/usr/bin/b".to_string();
+        first.numbers[0] = 42;
+        first.flags |= FLAG_DETAILS;
+        // Out of order and with a duplicate: written sorted and deduplicated.
+        let records = vec![first, record("a.service", "dead", 0), record("b.service", "exited", 9)];
+        let file = TempFile::new("round_trip");
+        assert_eq!(write_records(&file.0, records).unwrap(), 2);
+
+        let snapshot = Snapshot::open(&file.0).unwrap();
+        assert_eq!(snapshot.count, 2);
+        assert_eq!(snapshot.name(0), b"a.service");
+        assert_eq!(snapshot.string(0, 3), b"dead");
+        assert_eq!(snapshot.flags(0), FLAG_RUNNING);
+        assert_eq!(snapshot.name(1), b"b.service");
+        assert_eq!(snapshot.string(1, 1), b"Test unit");
+        assert_eq!(snapshot.string(1, 3), b"running");
+        assert_eq!(snapshot.string(1, 5), b"/usr/bin/b");
+        assert_eq!(snapshot.string(1, 6), b"");
+        assert_eq!(snapshot.number(1, 0), 42);
+        assert_eq!(snapshot.number(1, 1), 3);
+        assert_eq!(snapshot.number(1, 2), u64::MAX);
+        assert_eq!(snapshot.flags(1), FLAG_RUNNING | FLAG_DETAILS);
+    }
+
+    #[test]
+    fn round_trip_empty() {
+        let file = written("empty", Vec::new());
+        assert_eq!(Snapshot::open(&file.0).unwrap().count, 0);
+    }
+
+    #[test]
+    fn diff_identical() {
+        let old = written("identical_old", vec![record("a.service", "running", 0), record("b.service", "dead", 1)]);
+        let new = written("identical_new", vec![record("b.service", "dead", 1), record("a.service", "running", 0)]);
+        assert_eq!(diff_text(&old, &new), (false, String::new()));
+    }
+
+    #[test]
+    fn diff_added_and_removed() {
+        let old = written("added_old", vec![record("a.service", "running", 0), record("b.service", "running", 0)]);
+        let new = written("added_new", vec![record("b.service", "running", 0), record("c.service", "dead", 0)]);
+        let (differ, text) = diff_text(&old, &new);
+        assert!(differ);
+        assert_eq!(text, "- a.service active/running\n+ c.service active/dead\n");
+    }
+
+    #[test]
+    fn diff_changed() {
+        let mut moved = record("a.service", "exited", 2);
+        moved.flags = 0;
+        // Not a compared number: main_pid changes on every restart.
+        moved.numbers[0] = 7;
+        let old = written("changed_old", vec![record("a.service", "running", 1)]);
+        let new = written("changed_new", vec![moved]);
+        let (differ, text) = diff_text(&old, &new);
+        assert!(differ);
+        assert_eq!(
+            text,
+            "~ a.service running: true -> false\n~ a.service sub_state: \"running\" -> \"exited\"\n~ a.service restarts: 1 -> 2\n"
+        );
+    }
+
+    fn valid_bytes() -> Vec<u8> {
+        let file = written("valid", vec![record("a.service", "running", 0), record("b.service", "dead", 0)]);
+        std::fs::read(&file.0).unwrap()
+    }
+
+    #[test]
+    fn rejects_bad_magic() {
+        let mut bytes = valid_bytes();
+        bytes[0] = b'X';
+        assert!(open_error("bad_magic", &bytes).ends_with("bad magic"));
+    }
+
+    #[test]
+    fn rejects_bad_version() {
+        let mut bytes = valid_bytes();
+        bytes[7] = 2;
+        assert!(open_error("bad_version", &bytes).ends_with("bad magic"));
+    }
+
+    #[test]
+    fn rejects_truncated() {
+        let bytes = valid_bytes();
+        assert!(open_error("truncated_header", &bytes[..HEADER_SIZE - 1]).ends_with("too short"));
+        assert!(open_error("truncated_body", &bytes[..HEADER_SIZE + RECORD_SIZE]).ends_with("size does not match its header"));
+        assert!(open_error("truncated_strings", &bytes[..bytes.len() - 1]).ends_with("size does not match its header"));
+    }
+
+    #[test]
+    fn rejects_bad_string_id() {
+        let mut bytes = valid_bytes();
+        bytes[HEADER_SIZE..HEADER_SIZE + 4].copy_from_slice(&u32::MAX.to_le_bytes());
+        assert!(open_error("bad_string_id", &bytes).ends_with("bad string id"));
+    }
+}
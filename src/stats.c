@@ -0,0 +1,91 @@
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+#include "stats.h"
+
+typedef struct {
+    atomic_uint_fast64_t calls;
+    atomic_uint_fast64_t errors;
+    atomic_uint_fast64_t total_ns;
+    atomic_uint_fast64_t max_ns;
+    atomic_uint_fast64_t buckets[SERVICE_STATS_BUCKETS];
+} StatCounters;
+
+#define DECLARE_STAT_NAME(id, name) name,
+
+static const char *const stat_names[STAT_COUNT] = { SERVICE_STATS(DECLARE_STAT_NAME) };
+
+static StatCounters stat_counters[STAT_COUNT];
+
+uint64_t statsNow(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* Bucket i holds durations in [2^i, 2^(i+1)) ns; the last one everything longer. */
+static size_t bucket_of(uint64_t ns) {
+    if (ns < 2) {
+        return 0;
+    }
+    size_t bucket = 63 - (size_t)__builtin_clzll(ns);
+    return bucket < SERVICE_STATS_BUCKETS ? bucket : SERVICE_STATS_BUCKETS - 1;
+}
+
+void statsRecord(ServiceStat stat, uint64_t start, bool failed) {
+    StatCounters *counters = &stat_counters[stat];
+    uint64_t ns = statsNow() - start;
+
+    atomic_fetch_add_explicit(&counters->calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&counters->total_ns, ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&counters->buckets[bucket_of(ns)], 1, memory_order_relaxed);
+    if (failed) {
+        atomic_fetch_add_explicit(&counters->errors, 1, memory_order_relaxed);
+    }
+
+    uint_fast64_t max = atomic_load_explicit(&counters->max_ns, memory_order_relaxed);
+    while (ns > max && !atomic_compare_exchange_weak_explicit(&counters->max_ns, &max, ns,
+                                                              memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+ServiceStat statsBusMethod(const char* member) {
+    static const struct {
+        const char *member;
+        ServiceStat stat;
+    } methods[] = {
+        { "GetUnit", STAT_BUS_GET_UNIT },
+        { "LoadUnit", STAT_BUS_LOAD_UNIT },
+        { "Get", STAT_BUS_GET },
+        { "GetAll", STAT_BUS_GET_ALL },
+        { "ListUnitsByPatterns", STAT_BUS_LIST_UNITS_BY_PATTERNS },
+        { "ListUnitsFiltered", STAT_BUS_LIST_UNITS_FILTERED },
+        { "ListUnits", STAT_BUS_LIST_UNITS },
+        { "Subscribe", STAT_BUS_SUBSCRIBE },
+    };
+
+    for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++) {
+        if (strcmp(methods[i].member, member) == 0) {
+            return methods[i].stat;
+        }
+    }
+    return STAT_BUS_OTHER;
+}
+
+size_t getServiceViewerStats(ServiceViewerStat* stats, size_t max) {
+    for (size_t i = 0; i < STAT_COUNT && i < max; i++) {
+        StatCounters *counters = &stat_counters[i];
+
+        stats[i].name = stat_names[i];
+        stats[i].calls = atomic_load_explicit(&counters->calls, memory_order_relaxed);
+        stats[i].errors = atomic_load_explicit(&counters->errors, memory_order_relaxed);
+        stats[i].total_ns = atomic_load_explicit(&counters->total_ns, memory_order_relaxed);
+        stats[i].max_ns = atomic_load_explicit(&counters->max_ns, memory_order_relaxed);
+        for (size_t j = 0; j < SERVICE_STATS_BUCKETS; j++) {
+            stats[i].buckets[j] = atomic_load_explicit(&counters->buckets[j], memory_order_relaxed);
+        }
+    }
+    return STAT_COUNT;
+}
@@ -0,0 +1,68 @@
+#ifndef SERVICE_VIEWER_STATS_H
+#define SERVICE_VIEWER_STATS_H
+
+/*
+ * Call counters and latency histograms behind getServiceViewerStats().
+ * Recording one call is a clock read and a few relaxed atomic adds, so it
+ * is always on.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "service.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* FFI entry points, bus methods and local work, in reporting order. */
+#define SERVICE_STATS(X) \
+    X(STAT_IS_SERVICE_RUNNING, "isServiceRunning") \
+    X(STAT_DOES_SERVICE_EXIST, "doesServiceExist") \
+    X(STAT_LIST_SERVICE_UNITS, "listServiceUnits") \
+    X(STAT_SERVICE_NAMES_ARRAY, "serviceNamesArray") \
+    X(STAT_GET_SERVICE_DETAILS, "getServiceDetails") \
+    X(STAT_QUERY_SERVICES, "queryServices") \
+    X(STAT_OPEN_OFFLINE_QUERY, "openOfflineQuery") \
+    X(STAT_READ_OFFLINE_SERVICES, "readOfflineServices") \
+    X(STAT_SAMPLE_CGROUPS, "sampleCgroups") \
+    X(STAT_LOAD_SERVICE_GRAPH, "loadServiceGraph") \
+    X(STAT_QUERY_SERVICE_GRAPH, "queryServiceGraph") \
+    X(STAT_READ_JOURNAL_TAIL, "readJournalTail") \
+    X(STAT_HASH_EXECUTABLES, "hashExecutables") \
+    X(STAT_BUS_CONNECT, "bus.connect") \
+    X(STAT_BUS_GET_UNIT, "bus.GetUnit") \
+    X(STAT_BUS_LOAD_UNIT, "bus.LoadUnit") \
+    X(STAT_BUS_GET, "bus.Get") \
+    X(STAT_BUS_GET_ALL, "bus.GetAll") \
+    X(STAT_BUS_LIST_UNITS_BY_PATTERNS, "bus.ListUnitsByPatterns") \
+    X(STAT_BUS_LIST_UNITS_FILTERED, "bus.ListUnitsFiltered") \
+    X(STAT_BUS_LIST_UNITS, "bus.ListUnits") \
+    X(STAT_BUS_SUBSCRIBE, "bus.Subscribe") \
+    X(STAT_BUS_OTHER, "bus.other") \
+    X(STAT_PARSE_UNIT_FILE, "parseUnitFile") \
+    X(STAT_WATCH_FLUSH, "watch.flush") \
+    X(STAT_WATCH_RECONNECT, "watch.reconnect")
+
+#define DECLARE_STAT_ID(id, name) id,
+
+typedef enum {
+    SERVICE_STATS(DECLARE_STAT_ID)
+    STAT_COUNT
+} ServiceStat;
+
+/* Monotonic time in nanoseconds, to pass to statsRecord() as `start`. */
+uint64_t statsNow(void);
+
+/* Records one call of `stat` that began at `start`. */
+void statsRecord(ServiceStat stat, uint64_t start, bool failed);
+
+/* The bus stat for a method name, e.g. "GetUnit"; STAT_BUS_OTHER if it has none. */
+ServiceStat statsBusMethod(const char* member);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,682 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "unit_cache.h"
+#include "util.h"
+
+/*
+ * Cache file layout, native endian:
+ *
+ *   CacheHeader
+ *   CacheRecord[record_count]   sorted by path, for binary search
+ *   CacheEntry[entry_count]     each record's directives, in file order
+ *   char strings[string_size]   NUL-terminated, each distinct string once
+ *
+ * All references are offsets into `strings`, so the file is used straight
+ * from the mapping.
+ */
+#define CACHE_MAGIC "SVUCACHE"
+#define CACHE_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_count;
+    uint32_t entry_count;
+    uint32_t string_size;
+} CacheHeader;
+
+typedef struct {
+    uint64_t dev;
+    uint64_t inode;
+    uint64_t mtime_nsec;
+    uint64_t size;
+    uint32_t path;
+    uint32_t first_entry;
+    uint32_t entry_count;
+    uint32_t reserved;
+} CacheRecord;
+
+typedef struct {
+    uint32_t section;
+    uint32_t key;
+    uint32_t value;
+    uint32_t key_length;
+    uint32_t value_length;
+} CacheEntry;
+
+enum {
+    RECORD_UNTOUCHED,
+    RECORD_HIT,
+    RECORD_STALE,
+};
+
+/* A file parsed during this run; entries point into `strings`. */
+typedef struct {
+    char *path;
+    uint64_t dev;
+    uint64_t inode;
+    uint64_t mtime_nsec;
+    uint64_t size;
+    UnitFileEntry *entries;
+    size_t count;
+    char *strings;
+} AddedFile;
+
+struct UnitCache {
+    char *path;
+
+    void *map;
+    size_t map_length;
+    const CacheRecord *records;
+    const CacheEntry *entries;
+    const char *strings;
+    uint32_t record_count;
+    uint32_t entry_count;
+    uint32_t string_size;
+    uint8_t *record_state;
+
+    AddedFile *added;
+    size_t added_count;
+    size_t added_capacity;
+    uint32_t *added_slots;
+    size_t added_slot_count;
+
+    pthread_mutex_t lock;
+    UnitCacheStats stats;
+};
+
+static uint64_t mtime_nsec(const struct stat* st) {
+    return (uint64_t)st->st_mtim.tv_sec * 1000000000ULL + (uint64_t)st->st_mtim.tv_nsec;
+}
+
+static bool stat_matches(const struct stat* st, uint64_t dev, uint64_t inode, uint64_t mtime, uint64_t size) {
+    return (uint64_t)st->st_dev == dev && (uint64_t)st->st_ino == inode &&
+        mtime_nsec(st) == mtime && (uint64_t)st->st_size == size;
+}
+
+static bool load_cache_file(UnitCache* cache) {
+    struct stat st;
+    int fd = open(cache->path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(CacheHeader)) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed to map %s: %s\n", cache->path, strerror(errno));
+        return false;
+    }
+
+    const CacheHeader *header = map;
+    size_t length = (size_t)st.st_size;
+    size_t expected = sizeof(CacheHeader) +
+        (size_t)header->record_count * sizeof(CacheRecord) +
+        (size_t)header->entry_count * sizeof(CacheEntry) +
+        header->string_size;
+
+    if (memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0 || header->version != CACHE_VERSION) {
+        munmap(map, length);
+        return false;
+    }
+
+    if (expected != length || header->string_size == 0 || ((const char*)map)[length - 1] != '\0') {
+        fprintf(stderr, "Ignoring corrupt unit cache %s\n", cache->path);
+        munmap(map, length);
+        return false;
+    }
+
+    cache->map = map;
+    cache->map_length = length;
+    cache->record_count = header->record_count;
+    cache->entry_count = header->entry_count;
+    cache->string_size = header->string_size;
+    cache->records = (const CacheRecord*)(header + 1);
+    cache->entries = (const CacheEntry*)(cache->records + cache->record_count);
+    cache->strings = (const char*)(cache->entries + cache->entry_count);
+
+    cache->record_state = calloc(cache->record_count ? cache->record_count : 1, 1);
+    if (cache->record_state == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        munmap(map, length);
+        cache->map = NULL;
+        cache->record_count = 0;
+        return false;
+    }
+
+    cache->stats.records = cache->record_count;
+    return true;
+}
+
+UnitCache* openUnitCache(const char* path) {
+    UnitCache *cache = calloc(1, sizeof(UnitCache));
+    if (cache == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return NULL;
+    }
+
+    pthread_mutex_init(&cache->lock, NULL);
+
+    /* Without a usable location the cache still works for this run. */
+    cache->path = path ? strdup(path) : cacheFilePath("units.cache");
+    if (cache->path) {
+        load_cache_file(cache);
+    }
+
+    return cache;
+}
+
+void closeUnitCache(UnitCache* cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < cache->added_count; i++) {
+        free(cache->added[i].path);
+        free(cache->added[i].entries);
+        free(cache->added[i].strings);
+    }
+    free(cache->added);
+    free(cache->added_slots);
+    free(cache->record_state);
+    if (cache->map) {
+        munmap(cache->map, cache->map_length);
+    }
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->path);
+    free(cache);
+}
+
+void getUnitCacheStats(UnitCache* cache, UnitCacheStats* stats) {
+    pthread_mutex_lock(&cache->lock);
+    *stats = cache->stats;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+static long find_record(const UnitCache* cache, const char* path) {
+    size_t low = 0;
+    size_t high = cache->record_count;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        uint32_t offset = cache->records[mid].path;
+        int cmp = offset < cache->string_size ? strcmp(cache->strings + offset, path) : -1;
+
+        if (cmp == 0) {
+            return (long)mid;
+        }
+        if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return -1;
+}
+
+static const char* added_path(const void* context, uint32_t index) {
+    return ((const UnitCache*)context)->added[index].path;
+}
+
+static AddedFile* find_added(const UnitCache* cache, const char* path) {
+    uint32_t index;
+    return findSlot(cache->added_slots, cache->added_slot_count, path, added_path, cache, &index) ?
+        &cache->added[index] : NULL;
+}
+
+/* Copies a stored record's directives out as pointers into the mapping. */
+static bool record_entries(const UnitCache* cache, const CacheRecord* record, UnitFileEntry** entries, size_t* count) {
+    if ((uint64_t)record->first_entry + record->entry_count > cache->entry_count) {
+        return false;
+    }
+
+    UnitFileEntry *result = malloc((record->entry_count ? record->entry_count : 1) * sizeof(UnitFileEntry));
+    if (result == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < record->entry_count; i++) {
+        const CacheEntry *entry = &cache->entries[record->first_entry + i];
+
+        /* The lengths are trusted by callers, so each must end on the string's own NUL. */
+        if (entry->section >= cache->string_size ||
+            (uint64_t)entry->key + entry->key_length >= cache->string_size ||
+            (uint64_t)entry->value + entry->value_length >= cache->string_size ||
+            cache->strings[entry->key + entry->key_length] != '\0' ||
+            cache->strings[entry->value + entry->value_length] != '\0') {
+            free(result);
+            return false;
+        }
+
+        result[i] = (UnitFileEntry){
+            .section = cache->strings + entry->section,
+            .key = cache->strings + entry->key,
+            .value = cache->strings + entry->value,
+            .key_length = entry->key_length,
+            .value_length = entry->value_length,
+        };
+    }
+
+    *entries = result;
+    *count = record->entry_count;
+    return true;
+}
+
+bool unitCacheLookup(UnitCache* cache, const char* path, const struct stat* st, UnitFileEntry** entries, size_t* count) {
+    bool hit = false;
+
+    pthread_mutex_lock(&cache->lock);
+
+    AddedFile *added = find_added(cache, path);
+    if (added) {
+        if (stat_matches(st, added->dev, added->inode, added->mtime_nsec, added->size)) {
+            *entries = malloc((added->count ? added->count : 1) * sizeof(UnitFileEntry));
+            if (*entries) {
+                memcpy(*entries, added->entries, added->count * sizeof(UnitFileEntry));
+                *count = added->count;
+                hit = true;
+            }
+        }
+    } else {
+        long index = find_record(cache, path);
+        if (index >= 0) {
+            const CacheRecord *record = &cache->records[index];
+            if (stat_matches(st, record->dev, record->inode, record->mtime_nsec, record->size)) {
+                hit = record_entries(cache, record, entries, count);
+            }
+            if (hit) {
+                cache->record_state[index] = RECORD_HIT;
+            } else {
+                cache->record_state[index] = RECORD_STALE;
+                cache->stats.stale++;
+            }
+        }
+    }
+
+    if (hit) {
+        cache->stats.hits++;
+    } else {
+        cache->stats.misses++;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+    return hit;
+}
+
+static bool grow_added_slots(UnitCache* cache) {
+    size_t slot_count = cache->added_slot_count ? cache->added_slot_count * 2 : 256;
+    uint32_t *slots = calloc(slot_count, sizeof(uint32_t));
+    if (slots == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return false;
+    }
+
+    for (size_t i = 0; i < cache->added_count; i++) {
+        insertSlot(slots, slot_count, cache->added[i].path, (uint32_t)i);
+    }
+
+    free(cache->added_slots);
+    cache->added_slots = slots;
+    cache->added_slot_count = slot_count;
+    return true;
+}
+
+/* Copies `count` directives and their strings into one block owned by `added`. */
+static bool copy_entries(AddedFile* added, const UnitFileEntry* entries, size_t count) {
+    size_t size = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        size += strlen(entries[i].section) + entries[i].key_length + entries[i].value_length + 3;
+    }
+
+    added->entries = malloc((count ? count : 1) * sizeof(UnitFileEntry));
+    added->strings = malloc(size ? size : 1);
+    if (added->entries == NULL || added->strings == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        free(added->entries);
+        free(added->strings);
+        return false;
+    }
+
+    char *p = added->strings;
+    for (size_t i = 0; i < count; i++) {
+        size_t section_length = strlen(entries[i].section) + 1;
+
+        added->entries[i] = entries[i];
+        added->entries[i].section = memcpy(p, entries[i].section, section_length);
+        p += section_length;
+        added->entries[i].key = memcpy(p, entries[i].key, entries[i].key_length + 1);
+        p += entries[i].key_length + 1;
+        added->entries[i].value = memcpy(p, entries[i].value, entries[i].value_length + 1);
+        p += entries[i].value_length + 1;
+    }
+
+    added->count = count;
+    return true;
+}
+
+bool unitCacheStore(UnitCache* cache, const char* path, const struct stat* st, const UnitFileEntry* entries, size_t count) {
+    bool ok = false;
+
+    pthread_mutex_lock(&cache->lock);
+
+    /* Another thread may have parsed the same drop-in in the meantime. */
+    if (find_added(cache, path)) {
+        pthread_mutex_unlock(&cache->lock);
+        return true;
+    }
+
+    if ((cache->added_count + 1) * 2 > cache->added_slot_count && !grow_added_slots(cache)) {
+        goto out;
+    }
+
+    if (cache->added_count == cache->added_capacity) {
+        size_t capacity = cache->added_capacity ? cache->added_capacity * 2 : 64;
+        AddedFile *temp = realloc(cache->added, capacity * sizeof(AddedFile));
+        if (temp == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            goto out;
+        }
+        cache->added = temp;
+        cache->added_capacity = capacity;
+    }
+
+    AddedFile *added = &cache->added[cache->added_count];
+    memset(added, 0, sizeof(*added));
+    added->path = strdup(path);
+    added->dev = (uint64_t)st->st_dev;
+    added->inode = (uint64_t)st->st_ino;
+    added->mtime_nsec = mtime_nsec(st);
+    added->size = (uint64_t)st->st_size;
+
+    if (added->path == NULL || !copy_entries(added, entries, count)) {
+        free(added->path);
+        goto out;
+    }
+
+    insertSlot(cache->added_slots, cache->added_slot_count, added->path, (uint32_t)cache->added_count++);
+    ok = true;
+
+out:
+    pthread_mutex_unlock(&cache->lock);
+    return ok;
+}
+
+/* Output buffers for saveUnitCache, with strings interned through an open-addressing table. */
+typedef struct {
+    CacheRecord *records;
+    size_t record_count;
+    CacheEntry *entries;
+    size_t entry_count;
+    size_t entry_capacity;
+    char *strings;
+    size_t string_size;
+    size_t string_capacity;
+    uint32_t *slots;
+    size_t slot_count;
+    size_t interned;
+} CacheWriter;
+
+static const char* interned_string(const void* context, uint32_t offset) {
+    return ((const CacheWriter*)context)->strings + offset;
+}
+
+static bool grow_intern_slots(CacheWriter* writer) {
+    size_t slot_count = writer->slot_count ? writer->slot_count * 2 : 1024;
+    uint32_t *slots = calloc(slot_count, sizeof(uint32_t));
+    if (slots == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return false;
+    }
+
+    for (size_t i = 0; i < writer->slot_count; i++) {
+        if (writer->slots[i] != 0) {
+            uint32_t offset = writer->slots[i] - 1;
+            insertSlot(slots, slot_count, writer->strings + offset, offset);
+        }
+    }
+
+    free(writer->slots);
+    writer->slots = slots;
+    writer->slot_count = slot_count;
+    return true;
+}
+
+static bool intern_string(CacheWriter* writer, const char* value, uint32_t* offset) {
+    size_t length = strlen(value) + 1;
+
+    if ((writer->interned + 1) * 2 > writer->slot_count && !grow_intern_slots(writer)) {
+        return false;
+    }
+
+    if (findSlot(writer->slots, writer->slot_count, value, interned_string, writer, offset)) {
+        return true;
+    }
+
+    if (writer->string_size + length > UINT32_MAX) {
+        fprintf(stderr, "Unit cache too large\n");
+        return false;
+    }
+
+    if (writer->string_size + length > writer->string_capacity) {
+        size_t capacity = writer->string_capacity ? writer->string_capacity * 2 : 65536;
+        while (capacity < writer->string_size + length) {
+            capacity *= 2;
+        }
+        char *temp = realloc(writer->strings, capacity);
+        if (temp == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return false;
+        }
+        writer->strings = temp;
+        writer->string_capacity = capacity;
+    }
+
+    *offset = (uint32_t)writer->string_size;
+    memcpy(writer->strings + writer->string_size, value, length);
+    writer->string_size += length;
+    insertSlot(writer->slots, writer->slot_count, value, *offset);
+    writer->interned++;
+    return true;
+}
+
+static bool write_record(CacheWriter* writer, const char* path, uint64_t dev, uint64_t inode, uint64_t mtime, uint64_t size,
+                         const UnitFileEntry* entries, size_t count) {
+    CacheRecord *record = &writer->records[writer->record_count++];
+
+    memset(record, 0, sizeof(*record));
+    record->dev = dev;
+    record->inode = inode;
+    record->mtime_nsec = mtime;
+    record->size = size;
+    record->first_entry = (uint32_t)writer->entry_count;
+    record->entry_count = (uint32_t)count;
+
+    if (!intern_string(writer, path, &record->path)) {
+        return false;
+    }
+
+    if (writer->entry_count + count > writer->entry_capacity) {
+        size_t capacity = writer->entry_capacity ? writer->entry_capacity * 2 : 4096;
+        while (capacity < writer->entry_count + count) {
+            capacity *= 2;
+        }
+        CacheEntry *temp = realloc(writer->entries, capacity * sizeof(CacheEntry));
+        if (temp == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return false;
+        }
+        writer->entries = temp;
+        writer->entry_capacity = capacity;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        CacheEntry *entry = &writer->entries[writer->entry_count++];
+        entry->key_length = entries[i].key_length;
+        entry->value_length = entries[i].value_length;
+        if (!intern_string(writer, entries[i].section, &entry->section) ||
+            !intern_string(writer, entries[i].key, &entry->key) ||
+            !intern_string(writer, entries[i].value, &entry->value)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* One file to write: either a record of the loaded cache or one added this run. */
+typedef struct {
+    const char *path;
+    long record;
+    AddedFile *added;
+} SaveItem;
+
+static int compare_save_items(const void* a, const void* b) {
+    return strcmp(((const SaveItem*)a)->path, ((const SaveItem*)b)->path);
+}
+
+static bool write_cache_file(const char* path, const CacheWriter* writer) {
+    CacheHeader header;
+    char tmp_path[4096];
+    bool ok;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_VERSION;
+    header.record_count = (uint32_t)writer->record_count;
+    header.entry_count = (uint32_t)writer->entry_count;
+    header.string_size = (uint32_t)writer->string_size;
+
+    makeParentDirs(path);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path, (int)getpid());
+
+    FILE *file = fopen(tmp_path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to write %s: %s\n", tmp_path, strerror(errno));
+        return false;
+    }
+
+    ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(writer->records, sizeof(CacheRecord), writer->record_count, file) == writer->record_count &&
+        fwrite(writer->entries, sizeof(CacheEntry), writer->entry_count, file) == writer->entry_count &&
+        fwrite(writer->strings, 1, writer->string_size, file) == writer->string_size;
+    ok = fclose(file) == 0 && ok;
+
+    /* Readers never see a partial file: the old one stays mapped until the rename. */
+    if (!ok || rename(tmp_path, path) < 0) {
+        fprintf(stderr, "Failed to write %s: %s\n", path, strerror(errno));
+        unlink(tmp_path);
+        return false;
+    }
+
+    return true;
+}
+
+bool saveUnitCache(UnitCache* cache) {
+    CacheWriter writer;
+    SaveItem *items;
+    size_t item_count = 0;
+    bool ok = true;
+
+    if (cache->path == NULL || cache->added_count == 0) {
+        return true;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+
+    items = malloc((cache->record_count + cache->added_count) * sizeof(SaveItem));
+    if (items == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        pthread_mutex_unlock(&cache->lock);
+        return false;
+    }
+
+    /* Keep old records that were hit, or that nobody asked for but are still valid. */
+    for (uint32_t i = 0; i < cache->record_count; i++) {
+        const CacheRecord *record = &cache->records[i];
+        const char *path = cache->strings + record->path;
+        struct stat st;
+
+        if (record->path >= cache->string_size || find_added(cache, path)) {
+            continue;
+        }
+        if (cache->record_state[i] == RECORD_STALE) {
+            continue;
+        }
+        if (cache->record_state[i] == RECORD_UNTOUCHED &&
+            (stat(path, &st) < 0 || !stat_matches(&st, record->dev, record->inode, record->mtime_nsec, record->size))) {
+            continue;
+        }
+
+        items[item_count++] = (SaveItem){ .path = path, .record = (long)i, .added = NULL };
+    }
+
+    for (size_t i = 0; i < cache->added_count; i++) {
+        items[item_count++] = (SaveItem){ .path = cache->added[i].path, .record = -1, .added = &cache->added[i] };
+    }
+
+    qsort(items, item_count, sizeof(SaveItem), compare_save_items);
+
+    memset(&writer, 0, sizeof(writer));
+    writer.records = malloc((item_count ? item_count : 1) * sizeof(CacheRecord));
+    if (writer.records == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        ok = false;
+    }
+
+    for (size_t i = 0; ok && i < item_count; i++) {
+        if (items[i].added) {
+            AddedFile *added = items[i].added;
+            ok = write_record(&writer, added->path, added->dev, added->inode, added->mtime_nsec, added->size,
+                added->entries, added->count);
+        } else {
+            const CacheRecord *record = &cache->records[items[i].record];
+            UnitFileEntry *entries = NULL;
+            size_t count = 0;
+
+            if (!record_entries(cache, record, &entries, &count)) {
+                continue;
+            }
+            ok = write_record(&writer, items[i].path, record->dev, record->inode, record->mtime_nsec, record->size,
+                entries, count);
+            free(entries);
+        }
+    }
+
+    /* An empty strings section would read back as corrupt. */
+    if (ok && writer.string_size == 0) {
+        uint32_t offset;
+        ok = intern_string(&writer, "", &offset);
+    }
+
+    if (ok) {
+        ok = write_cache_file(cache->path, &writer);
+    }
+
+    free(items);
+    free(writer.records);
+    free(writer.entries);
+    free(writer.strings);
+    free(writer.slots);
+
+    pthread_mutex_unlock(&cache->lock);
+    return ok;
+}
@@ -0,0 +1,58 @@
+#ifndef SERVICE_VIEWER_UNIT_CACHE_H
+#define SERVICE_VIEWER_UNIT_CACHE_H
+
+/*
+ * Persistent cache of parsed unit files. Each file's directives are stored
+ * in a single memory-mapped file, valid as long as the file's
+ * (path, dev, inode, mtime, size) are unchanged, so warm starts skip the
+ * open/map/parse of every unit and drop-in.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "unit_file.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct UnitCache UnitCache;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stale;      /* misses where the file had changed since it was cached */
+    uint64_t records;    /* files in the loaded cache */
+} UnitCacheStats;
+
+/*
+ * Loads the cache at `path`, or $XDG_CACHE_HOME/service_viewer/units.cache
+ * (~/.cache/... without it) if NULL. A missing or invalid file gives an
+ * empty cache. UnitFiles parsed with a cache point into it, so close the
+ * cache after freeing them.
+ */
+UnitCache* openUnitCache(const char* path);
+
+/* Writes the cache back if anything was added; untouched entries are kept while still valid. */
+bool saveUnitCache(UnitCache* cache);
+void closeUnitCache(UnitCache* cache);
+
+void getUnitCacheStats(UnitCache* cache, UnitCacheStats* stats);
+
+/*
+ * Used by parseUnitFile. A hit returns the file's directives (a malloc'd
+ * array, strings owned by the cache); a miss returns false. Store copies
+ * the directives, so they may point into a mapping that goes away.
+ * Both are safe to call from several threads.
+ */
+bool unitCacheLookup(UnitCache* cache, const char* path, const struct stat* st, UnitFileEntry** entries, size_t* count);
+bool unitCacheStore(UnitCache* cache, const char* path, const struct stat* st, const UnitFileEntry* entries, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
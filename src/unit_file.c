@@ -0,0 +1,503 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "unit_file.h"
+#include "unit_cache.h"
+#include "stats.h"
+#include "util.h"
+
+/*
+ * Files are mapped MAP_PRIVATE and writable so the parser can terminate
+ * strings and join continuation lines in place. Only pages that are touched
+ * get copied; the file on disk is never modified.
+ */
+static bool map_source(const char* path, int fd, const struct stat* st, UnitFileSource* source) {
+    memset(source, 0, sizeof(*source));
+
+    source->length = (size_t)st->st_size;
+
+    /*
+     * The byte after the last line is overwritten with NUL. That byte is
+     * only addressable if the file does not end exactly on a page boundary;
+     * otherwise (and for empty or special files) read into a buffer instead.
+     */
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (source->length > 0 && S_ISREG(st->st_mode) && source->length % (size_t)page_size != 0) {
+        void *data = mmap(NULL, source->length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            source->data = data;
+            source->mapped = true;
+            return true;
+        }
+    }
+
+    source->data = malloc(source->length + 1);
+    if (source->data == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return false;
+    }
+
+    size_t total = 0;
+    while (total < source->length) {
+        ssize_t n = read(fd, source->data + total, source->length - total);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            fprintf(stderr, "Failed to read %s: %s\n", path, strerror(errno));
+            free(source->data);
+            source->data = NULL;
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+        total += (size_t)n;
+    }
+    source->length = total;
+    source->data[total] = '\0';
+
+    return true;
+}
+
+static void unmap_source(UnitFileSource* source) {
+    if (source->mapped) {
+        munmap(source->data, source->length);
+    } else {
+        free(source->data);
+    }
+}
+
+static bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static char* skip_blanks(char* p, char* end) {
+    while (p < end && is_blank(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static char* trim_blanks(char* start, char* end) {
+    while (end > start && is_blank(end[-1])) {
+        end--;
+    }
+    return end;
+}
+
+static bool is_comment(const char* p, const char* end) {
+    return p < end && (*p == '#' || *p == ';');
+}
+
+static bool append_entry(UnitFileEntry** entries, size_t* count, size_t* capacity, const UnitFileEntry* entry) {
+    if (*count == *capacity) {
+        size_t new_capacity = *capacity ? *capacity * 2 : 32;
+        UnitFileEntry *temp = realloc(*entries, new_capacity * sizeof(UnitFileEntry));
+        if (temp == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return false;
+        }
+        *entries = temp;
+        *capacity = new_capacity;
+    }
+
+    (*entries)[(*count)++] = *entry;
+    return true;
+}
+
+/* Drops earlier assignments of `key` in `section`; an empty `Key=` resets a list. */
+static void reset_entries(UnitFile* unit, const char* section, const char* key) {
+    size_t kept = 0;
+
+    for (size_t i = 0; i < unit->count; i++) {
+        UnitFileEntry *entry = &unit->entries[i];
+        if (strcmp(entry->key, key) == 0 && strcmp(entry->section, section) == 0) {
+            continue;
+        }
+        unit->entries[kept++] = *entry;
+    }
+
+    unit->count = kept;
+}
+
+/* Applies one file's directives on top of what earlier files set. */
+static bool merge_entries(UnitFile* unit, const UnitFileEntry* entries, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].value_length == 0) {
+            reset_entries(unit, entries[i].section, entries[i].key);
+        } else if (!append_entry(&unit->entries, &unit->count, &unit->capacity, &entries[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Parses one file in place into its directives, in file order and including
+ * empty resets. `data[length]` must be writable. A line ending in `\`
+ * continues on the next one, with the backslash replaced by a space;
+ * comment lines inside a continuation are skipped, as systemd does.
+ */
+static bool parse_source(const char* path, char* data, size_t length, UnitFileEntry** entries, size_t* count) {
+    const char *section = NULL;
+    char *end = data + length;
+    char *p = data;
+    unsigned line_number = 0;
+    size_t capacity = 0;
+
+    while (p < end) {
+        char *line = p;
+        char *eol = memchr(p, '\n', (size_t)(end - p));
+        if (eol == NULL) {
+            eol = end;
+        }
+        p = eol < end ? eol + 1 : end;
+        line_number++;
+
+        line = skip_blanks(line, eol);
+        char *line_end = trim_blanks(line, eol);
+
+        if (line == line_end || is_comment(line, line_end)) {
+            continue;
+        }
+
+        if (*line == '[') {
+            char *close = memchr(line, ']', (size_t)(line_end - line));
+            if (close == NULL) {
+                fprintf(stderr, "%s:%u: invalid section header\n", path, line_number);
+                section = NULL;
+                continue;
+            }
+            *close = '\0';
+            section = line + 1;
+            continue;
+        }
+
+        char *equals = memchr(line, '=', (size_t)(line_end - line));
+        char *value = equals ? skip_blanks(equals + 1, line_end) : line_end;
+        char *value_end = line_end;
+
+        /* Join continuation lines into the first one; the value only ever shrinks. */
+        while (value_end > value && value_end[-1] == '\\' && p < end) {
+            value_end[-1] = ' ';
+
+            char *next = p;
+            char *next_eol = memchr(p, '\n', (size_t)(end - p));
+            if (next_eol == NULL) {
+                next_eol = end;
+            }
+            p = next_eol < end ? next_eol + 1 : end;
+            line_number++;
+
+            char *next_start = skip_blanks(next, next_eol);
+            char *next_end = trim_blanks(next_start, next_eol);
+            if (is_comment(next_start, next_end)) {
+                /* Keep the continuation going past the comment. */
+                value_end[-1] = '\\';
+                continue;
+            }
+
+            memmove(value_end, next, (size_t)(next_end - next));
+            value_end += next_end - next;
+        }
+        if (value_end > value && value_end[-1] == '\\') {
+            value_end--;
+        }
+        value_end = trim_blanks(value, value_end);
+
+        if (equals == NULL) {
+            fprintf(stderr, "%s:%u: missing '='\n", path, line_number);
+            continue;
+        }
+        if (section == NULL) {
+            fprintf(stderr, "%s:%u: assignment outside of a section\n", path, line_number);
+            continue;
+        }
+
+        char *key_end = trim_blanks(line, equals);
+        if (key_end == line) {
+            fprintf(stderr, "%s:%u: missing key\n", path, line_number);
+            continue;
+        }
+
+        *key_end = '\0';
+        *value_end = '\0';
+
+        UnitFileEntry entry = {
+            .section = section,
+            .key = line,
+            .value = value,
+            .key_length = (uint32_t)(key_end - line),
+            .value_length = (uint32_t)(value_end - value),
+        };
+        if (!append_entry(entries, count, &capacity, &entry)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool add_source(UnitFile* unit, UnitCache* cache, const char* path) {
+    UnitFileEntry *entries = NULL;
+    size_t count = 0;
+    struct stat st;
+    bool ok;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        fprintf(stderr, "Failed to stat %s: %s\n", path, strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    if (cache && unitCacheLookup(cache, path, &st, &entries, &count)) {
+        close(fd);
+        ok = merge_entries(unit, entries, count);
+        free(entries);
+        return ok;
+    }
+
+    UnitFileSource source;
+    ok = map_source(path, fd, &st, &source);
+    close(fd);
+    if (!ok) {
+        return false;
+    }
+
+    UnitFileSource *temp = realloc(unit->sources, (unit->source_count + 1) * sizeof(UnitFileSource));
+    if (temp == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        unmap_source(&source);
+        return false;
+    }
+    unit->sources = temp;
+    unit->sources[unit->source_count++] = source;
+
+    ok = parse_source(path, source.data, source.length, &entries, &count);
+    if (ok && cache) {
+        unitCacheStore(cache, path, &st, entries, count);
+    }
+    ok = ok && merge_entries(unit, entries, count);
+
+    free(entries);
+    return ok;
+}
+
+typedef struct {
+    char *name;
+    char *path;
+} DropIn;
+
+static int compare_dropins(const void* a, const void* b) {
+    return strcmp(((const DropIn*)a)->name, ((const DropIn*)b)->name);
+}
+
+/*
+ * Adds the *.conf files of `dir`, unless a higher priority dir already had one with that name.
+ * With a `root`, `dir` is a path inside it, and the directory and each file are looked up there.
+ */
+static bool collect_dropins(const char* root, const char* dir, DropIn** dropins, size_t* count, size_t* capacity) {
+    char *resolved_dir = NULL;
+    DIR *d;
+    struct dirent *entry;
+
+    if (root) {
+        resolved_dir = resolveInRoot(root, dir);
+        if (resolved_dir == NULL) {
+            return true;
+        }
+    }
+    d = opendir(resolved_dir ? resolved_dir : dir);
+    free(resolved_dir);
+    if (d == NULL) {
+        return true;
+    }
+
+    while ((entry = readdir(d)) != NULL) {
+        size_t length = strlen(entry->d_name);
+        bool seen = false;
+
+        if (length <= 5 || strcmp(entry->d_name + length - 5, ".conf") != 0) {
+            continue;
+        }
+
+        for (size_t i = 0; i < *count && !seen; i++) {
+            seen = strcmp((*dropins)[i].name, entry->d_name) == 0;
+        }
+        if (seen) {
+            continue;
+        }
+
+        char *path = malloc(strlen(dir) + length + 2);
+        if (path == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            closedir(d);
+            return false;
+        }
+        sprintf(path, "%s/%s", dir, entry->d_name);
+        if (root) {
+            char *resolved = resolveInRoot(root, path);
+            free(path);
+            if (resolved == NULL) {
+                continue;
+            }
+            path = resolved;
+        }
+
+        if (*count == *capacity) {
+            size_t new_capacity = *capacity ? *capacity * 2 : 8;
+            DropIn *temp = realloc(*dropins, new_capacity * sizeof(DropIn));
+            if (temp == NULL) {
+                fprintf(stderr, "Memory allocation failed\n");
+                free(path);
+                closedir(d);
+                return false;
+            }
+            *dropins = temp;
+            *capacity = new_capacity;
+        }
+
+        DropIn *dropin = &(*dropins)[*count];
+        dropin->name = strdup(entry->d_name);
+        dropin->path = path;
+        if (dropin->name == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            free(dropin->path);
+            closedir(d);
+            return false;
+        }
+        (*count)++;
+    }
+
+    closedir(d);
+    return true;
+}
+
+/* `<unit>.d`, the template's `<prefix>@.<type>.d` and `<type>.d`, in that order. */
+static size_t dropin_dir_names(const char* unit_name, char names[3][512]) {
+    const char *dot = strrchr(unit_name, '.');
+    const char *at = strchr(unit_name, '@');
+    size_t count = 0;
+
+    snprintf(names[count++], 512, "%s.d", unit_name);
+
+    if (at && dot && at < dot && at + 1 != dot) {
+        snprintf(names[count++], 512, "%.*s%s.d", (int)(at - unit_name + 1), unit_name, dot);
+    }
+
+    if (dot) {
+        snprintf(names[count++], 512, "%s.d", dot + 1);
+    }
+
+    return count;
+}
+
+static bool apply_dropins(UnitFile* unit, UnitCache* cache, const char* root, const char* path, const char* const* dropin_dirs, size_t dropin_dir_count) {
+    const char *slash = strrchr(path, '/');
+    const char *unit_name = slash ? slash + 1 : path;
+    char own_dir[4096];
+    const char *default_dirs[1];
+    char dir_names[3][512];
+    size_t dir_name_count = dropin_dir_names(unit_name, dir_names);
+    DropIn *dropins = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    bool ok = true;
+
+    if (dropin_dir_count == 0) {
+        snprintf(own_dir, sizeof(own_dir), "%.*s", slash ? (int)(slash - path) : 1, slash ? path : ".");
+        default_dirs[0] = own_dir;
+        dropin_dirs = default_dirs;
+        dropin_dir_count = 1;
+    }
+
+    for (size_t i = 0; i < dropin_dir_count && ok; i++) {
+        for (size_t j = 0; j < dir_name_count && ok; j++) {
+            char dir[4096];
+            int length = snprintf(dir, sizeof(dir), "%s/%s", dropin_dirs[i], dir_names[j]);
+            if (length < 0 || (size_t)length >= sizeof(dir)) {
+                /* A cut path would name some other directory. */
+                fprintf(stderr, "Drop-in directory path too long: %s/%s\n", dropin_dirs[i], dir_names[j]);
+                continue;
+            }
+            ok = collect_dropins(root, dir, &dropins, &count, &capacity);
+        }
+    }
+
+    /* Drop-ins apply in filename order regardless of the directory they came from. */
+    if (count > 1) {
+        qsort(dropins, count, sizeof(DropIn), compare_dropins);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (ok && !add_source(unit, cache, dropins[i].path)) {
+            ok = false;
+        }
+        free(dropins[i].name);
+        free(dropins[i].path);
+    }
+    free(dropins);
+
+    return ok;
+}
+
+UnitFile* parseUnitFile(UnitCache* cache, const char* root, const char* path, const char* const* dropin_dirs, size_t dropin_dir_count) {
+    uint64_t start = statsNow();
+    UnitFile *unit = calloc(1, sizeof(UnitFile));
+    if (unit == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return NULL;
+    }
+
+    if (!add_source(unit, cache, path)) {
+        freeUnitFile(unit);
+        statsRecord(STAT_PARSE_UNIT_FILE, start, true);
+        return NULL;
+    }
+
+    /* A broken drop-in should not hide the unit; what was merged so far is kept. */
+    apply_dropins(unit, cache, root, path, dropin_dirs, dropin_dir_count);
+
+    statsRecord(STAT_PARSE_UNIT_FILE, start, false);
+    return unit;
+}
+
+void freeUnitFile(UnitFile* unit) {
+    if (unit == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < unit->source_count; i++) {
+        unmap_source(&unit->sources[i]);
+    }
+    free(unit->sources);
+    free(unit->entries);
+    free(unit);
+}
+
+const char* unitFileGet(const UnitFile* unit, const char* section, const char* key) {
+    for (size_t i = unit->count; i > 0; i--) {
+        const UnitFileEntry *entry = &unit->entries[i - 1];
+        if (strcmp(entry->key, key) == 0 && strcmp(entry->section, section) == 0) {
+            return entry->value;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,62 @@
+#ifndef SERVICE_VIEWER_UNIT_FILE_H
+#define SERVICE_VIEWER_UNIT_FILE_H
+
+/*
+ * Parser for systemd unit files (e.g. /usr/lib/systemd/system/foo.service)
+ * and their drop-ins. Files are mapped and parsed in place: every section,
+ * key and value below points into the mapping and is NUL-terminated there.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* One effective `Key=value` assignment, in file order. */
+typedef struct {
+    const char *section;
+    const char *key;
+    const char *value;
+    uint32_t key_length;
+    uint32_t value_length;
+} UnitFileEntry;
+
+typedef struct {
+    char *data;
+    size_t length;
+    bool mapped;
+} UnitFileSource;
+
+typedef struct {
+    UnitFileEntry *entries;
+    size_t count;
+    size_t capacity;
+    UnitFileSource *sources;
+    size_t source_count;
+} UnitFile;
+
+struct UnitCache;
+
+/*
+ * Parses `path` and merges its drop-ins (`*.conf` in `<unit>.d/`, the
+ * template's `<prefix>@.<type>.d/` and `<type>.d/`) found in `dropin_dirs`,
+ * highest priority first. With no dirs, the directory of `path` is used.
+ * With a `root` (may be NULL), the dirs are paths inside that root and
+ * are looked up below it, symlinks included; `path` is used as given.
+ * With a `cache` (may be NULL), files unchanged since they were cached are
+ * not read at all. Returns NULL if the unit file itself cannot be read.
+ */
+UnitFile* parseUnitFile(struct UnitCache* cache, const char* root, const char* path, const char* const* dropin_dirs, size_t dropin_dir_count);
+void freeUnitFile(UnitFile* unit);
+
+/* The last value assigned to `key` in `section`, or NULL. */
+const char* unitFileGet(const UnitFile* unit, const char* section, const char* key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "util.h"
+
+/* Symlinks followed per path below a root. */
+#define ROOT_MAX_SYMLINKS 8
+
+uint64_t hashString(const char* s) {
+    uint64_t hash = 14695981039346656037ULL;
+    while (*s) {
+        hash ^= (unsigned char)*s++;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void insertSlot(uint32_t* slots, size_t slot_count, const char* key, uint32_t value) {
+    size_t mask = slot_count - 1;
+    size_t i = hashString(key) & mask;
+    while (slots[i] != 0) {
+        i = (i + 1) & mask;
+    }
+    slots[i] = value + 1;
+}
+
+bool findSlot(const uint32_t* slots, size_t slot_count, const char* key,
+              SlotKeyFunc key_of, const void* context, uint32_t* value) {
+    if (slot_count == 0) {
+        return false;
+    }
+
+    size_t mask = slot_count - 1;
+    for (size_t i = hashString(key) & mask; slots[i] != 0; i = (i + 1) & mask) {
+        if (strcmp(key_of(context, slots[i] - 1), key) == 0) {
+            *value = slots[i] - 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+char* resolveInRoot(const char* root, const char* path) {
+    char resolved[PATH_MAX];
+    char pending[PATH_MAX];
+    size_t base = strlen(root);
+    int links = 0;
+
+    while (base > 0 && root[base - 1] == '/') {
+        base--;
+    }
+    if (base >= sizeof(resolved) || strlen(path) >= sizeof(pending)) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    memcpy(resolved, root, base);
+    resolved[base] = '\0';
+    strcpy(pending, path);
+
+    size_t length = base;
+    const char *next = pending;
+    while (*next) {
+        while (*next == '/') {
+            next++;
+        }
+        size_t component = strcspn(next, "/");
+        if (component == 0) {
+            break;
+        }
+        if (component == 1 && next[0] == '.') {
+            next++;
+            continue;
+        }
+        if (component == 2 && next[0] == '.' && next[1] == '.') {
+            while (length > base && resolved[length - 1] != '/') {
+                length--;
+            }
+            if (length > base) {
+                length--;
+            }
+            resolved[length] = '\0';
+            next += 2;
+            continue;
+        }
+
+        size_t parent = length;
+        if (length + 1 + component >= sizeof(resolved)) {
+            errno = ENAMETOOLONG;
+            return NULL;
+        }
+        resolved[length++] = '/';
+        memcpy(resolved + length, next, component);
+        length += component;
+        resolved[length] = '\0';
+        next += component;
+
+        struct stat st;
+        if (lstat(resolved, &st) < 0) {
+            return NULL;
+        }
+        if (!S_ISLNK(st.st_mode)) {
+            continue;
+        }
+        if (++links > ROOT_MAX_SYMLINKS) {
+            errno = ELOOP;
+            return NULL;
+        }
+
+        char target[PATH_MAX];
+        ssize_t target_length = readlink(resolved, target, sizeof(target) - 1);
+        if (target_length < 0) {
+            return NULL;
+        }
+        target[target_length] = '\0';
+
+        /* The target takes the link's place in what is left to walk. */
+        char rest[PATH_MAX];
+        int written = snprintf(rest, sizeof(rest), "%s/%s", target, next);
+        if (written < 0 || (size_t)written >= sizeof(rest)) {
+            errno = ENAMETOOLONG;
+            return NULL;
+        }
+        memcpy(pending, rest, (size_t)written + 1);
+        next = pending;
+        length = target[0] == '/' ? base : parent;
+        resolved[length] = '\0';
+    }
+
+    return strdup(length > 0 ? resolved : "/");
+}
+
+char* cacheFilePath(const char* name) {
+    const char *base = getenv("XDG_CACHE_HOME");
+    const char *prefix = "/service_viewer/";
+
+    if (base == NULL || base[0] != '/') {
+        base = getenv("HOME");
+        if (base == NULL || base[0] != '/') {
+            return NULL;
+        }
+        prefix = "/.cache/service_viewer/";
+    }
+
+    char *path = malloc(strlen(base) + strlen(prefix) + strlen(name) + 1);
+    if (path) {
+        sprintf(path, "%s%s%s", base, prefix, name);
+    }
+    return path;
+}
+
+void makeParentDirs(const char* path) {
+    char *copy = strdup(path);
+    if (copy == NULL) {
+        return;
+    }
+
+    for (char *p = strchr(copy + 1, '/'); p; p = strchr(p + 1, '/')) {
+        *p = '\0';
+        mkdir(copy, 0755);
+        *p = '/';
+    }
+
+    free(copy);
+}
@@ -0,0 +1,55 @@
+#ifndef SERVICE_VIEWER_UTIL_H
+#define SERVICE_VIEWER_UTIL_H
+
+/*
+ * Helpers shared by the C sources that have no better home of their own.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 64-bit FNV-1a of the string `s`. */
+uint64_t hashString(const char* s);
+
+/*
+ * Open-addressing tables keyed by string: `slot_count` is a power of two and
+ * each slot holds a value + 1, 0 marking it empty. Collisions probe linearly
+ * from hashString(key). Callers keep their tables at most half full.
+ */
+typedef const char* (*SlotKeyFunc)(const void* context, uint32_t value);
+
+void insertSlot(uint32_t* slots, size_t slot_count, const char* key, uint32_t value);
+
+/* Stores the value whose key_of(context, value) equals `key` in `value`; false if there is none. */
+bool findSlot(const uint32_t* slots, size_t slot_count, const char* key,
+              SlotKeyFunc key_of, const void* context, uint32_t* value);
+
+/*
+ * The file `path` (absolute) names inside `root`, as a malloc'd path below
+ * `root`. Every component is looked up below `root` and symlinks are
+ * followed as they would be inside the image: absolute targets start over
+ * at `root` and ".." stops there, so no link leads out of it. NULL with
+ * errno set if there is no such file.
+ */
+char* resolveInRoot(const char* root, const char* path);
+
+/*
+ * $XDG_CACHE_HOME/service_viewer/`name`, or ~/.cache/service_viewer/`name`
+ * when that is unset or relative, as a malloc'd path. NULL if neither
+ * variable gives an absolute directory.
+ */
+char* cacheFilePath(const char* name);
+
+/* Creates the missing directories above `path`, like mkdir -p on its dirname. */
+void makeParentDirs(const char* path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
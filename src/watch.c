@@ -0,0 +1,579 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <systemd/sd-bus.h>
+#include <systemd/sd-event.h>
+
+#include "service.h"
+#include "stats.h"
+
+/*
+ * Live updates: a background thread subscribes to the manager and turns
+ * UnitNew, UnitRemoved and PropertiesChanged signals into ServiceEvents
+ * that the UI picks up with pollServiceEvents(). Signals are coalesced for
+ * COALESCE_USEC after the first one arrives, so a burst of changes to one
+ * unit costs one batched re-query of that unit, not one per signal.
+ *
+ * If the bus connection drops (e.g. dbus-daemon or systemd restarts), or
+ * cannot be made at start, the thread reconnects with backoff and
+ * re-subscribes. Signals sent in between are lost, so a RESYNC event then
+ * tells the UI to load everything again.
+ */
+#define DESTINATION "org.freedesktop.systemd1"
+#define UNIT_PATH_PREFIX "/org/freedesktop/systemd1/unit"
+#define COALESCE_USEC (50 * 1000)
+#define RECONNECT_MIN_USEC (250 * 1000)
+#define RECONNECT_MAX_USEC (30 * 1000 * 1000)
+
+typedef struct {
+    char *name;
+    char *path;
+} PendingUnit;
+
+typedef struct {
+    pthread_t thread;
+    int stop_fd;
+    /* Subscribed and receiving signals; read by isServiceWatchConnected(). */
+    atomic_bool connected;
+    char **patterns;
+    size_t pattern_count;
+
+    /* Only touched by the watch thread. */
+    sd_event *event;
+    sd_bus *bus;
+    sd_event_source *flush_source;
+    sd_event_source *reconnect_source;
+    uint64_t reconnect_delay;
+    PendingUnit *pending;
+    size_t pending_count;
+    size_t pending_capacity;
+
+    /* Shared with pollServiceEvents(). */
+    pthread_mutex_t lock;
+    ServiceEvent *events;
+    size_t event_count;
+    size_t event_capacity;
+} ServiceWatch;
+
+static ServiceWatch *service_watch;
+
+static bool watch_matches(const ServiceWatch* watch, const char* name) {
+    if (watch->pattern_count == 0) {
+        return true;
+    }
+    for (size_t i = 0; i < watch->pattern_count; i++) {
+        if (fnmatch(watch->patterns[i], name, 0) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Takes ownership of `name` and `details`, also on failure. */
+static void push_event(ServiceWatch* watch, ServiceEventKind kind, char* name, bool running, ServiceDetails* details) {
+    pthread_mutex_lock(&watch->lock);
+
+    if (watch->event_count == watch->event_capacity) {
+        size_t capacity = watch->event_capacity ? watch->event_capacity * 2 : 64;
+        ServiceEvent *temp = realloc(watch->events, capacity * sizeof(ServiceEvent));
+        if (temp == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            pthread_mutex_unlock(&watch->lock);
+            free(name);
+            freeServiceDetails(details);
+            return;
+        }
+        watch->events = temp;
+        watch->event_capacity = capacity;
+    }
+
+    watch->events[watch->event_count++] = (ServiceEvent){
+        .kind = kind,
+        .running = running,
+        .name = name,
+        .details = details,
+    };
+
+    pthread_mutex_unlock(&watch->lock);
+}
+
+static void pending_remove(ServiceWatch* watch, const char* name) {
+    for (size_t i = 0; i < watch->pending_count; i++) {
+        if (strcmp(watch->pending[i].name, name) == 0) {
+            free(watch->pending[i].name);
+            free(watch->pending[i].path);
+            watch->pending[i] = watch->pending[--watch->pending_count];
+            i--;
+        }
+    }
+}
+
+/* Duplicates are fine here; they are dropped when the batch is flushed. */
+static void pending_add(ServiceWatch* watch, const char* name, const char* path) {
+    if (watch->pending_count == watch->pending_capacity) {
+        size_t capacity = watch->pending_capacity ? watch->pending_capacity * 2 : 64;
+        PendingUnit *temp = realloc(watch->pending, capacity * sizeof(PendingUnit));
+        if (temp == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return;
+        }
+        watch->pending = temp;
+        watch->pending_capacity = capacity;
+    }
+
+    PendingUnit *unit = &watch->pending[watch->pending_count];
+    unit->name = strdup(name);
+    unit->path = strdup(path);
+    if (unit->name == NULL || unit->path == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        free(unit->name);
+        free(unit->path);
+        return;
+    }
+    watch->pending_count++;
+
+    /* The first change of a burst arms the flush; later ones ride along. */
+    if (watch->pending_count == 1 && watch->flush_source) {
+        uint64_t now;
+        if (sd_event_now(watch->event, CLOCK_MONOTONIC, &now) >= 0 &&
+            sd_event_source_set_time(watch->flush_source, now + COALESCE_USEC) >= 0) {
+            sd_event_source_set_enabled(watch->flush_source, SD_EVENT_ONESHOT);
+        }
+    }
+}
+
+static int on_unit_new(sd_bus_message* msg, void* userdata, sd_bus_error* ret_error) {
+    (void)ret_error;
+    ServiceWatch *watch = userdata;
+    const char *name;
+    const char *path;
+
+    if (sd_bus_message_read(msg, "so", &name, &path) >= 0 && watch_matches(watch, name)) {
+        pending_add(watch, name, path);
+    }
+    return 0;
+}
+
+static int on_unit_removed(sd_bus_message* msg, void* userdata, sd_bus_error* ret_error) {
+    (void)ret_error;
+    ServiceWatch *watch = userdata;
+    const char *name;
+    const char *path;
+
+    if (sd_bus_message_read(msg, "so", &name, &path) < 0 || !watch_matches(watch, name)) {
+        return 0;
+    }
+
+    pending_remove(watch, name);
+
+    char *copy = strdup(name);
+    if (copy) {
+        push_event(watch, SERVICE_EVENT_REMOVED, copy, false, NULL);
+    }
+    return 0;
+}
+
+static int on_properties_changed(sd_bus_message* msg, void* userdata, sd_bus_error* ret_error) {
+    (void)ret_error;
+    ServiceWatch *watch = userdata;
+    const char *path = sd_bus_message_get_path(msg);
+    const char *interface;
+    char *name = NULL;
+
+    if (path == NULL || sd_bus_message_read(msg, "s", &interface) < 0) {
+        return 0;
+    }
+
+    /* Only the interfaces the details pane shows; e.g. Socket changes are not interesting. */
+    if (strcmp(interface, "org.freedesktop.systemd1.Unit") != 0 &&
+        strcmp(interface, "org.freedesktop.systemd1.Service") != 0) {
+        return 0;
+    }
+
+    if (sd_bus_path_decode(path, UNIT_PATH_PREFIX, &name) <= 0 || name == NULL) {
+        return 0;
+    }
+
+    if (watch_matches(watch, name)) {
+        pending_add(watch, name, path);
+    }
+
+    free(name);
+    return 0;
+}
+
+static int compare_pending(const void* a, const void* b) {
+    return strcmp(((const PendingUnit*)a)->name, ((const PendingUnit*)b)->name);
+}
+
+/* Re-queries every unit that changed since the last flush, once. */
+static int flush_pending(sd_event_source* source, uint64_t usec, void* userdata) {
+    (void)source;
+    (void)usec;
+    ServiceWatch *watch = userdata;
+    PendingUnit *pending = watch->pending;
+    size_t count = watch->pending_count;
+    size_t unique = 0;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t start = statsNow();
+    watch->pending = NULL;
+    watch->pending_count = 0;
+    watch->pending_capacity = 0;
+
+    qsort(pending, count, sizeof(PendingUnit), compare_pending);
+    for (size_t i = 0; i < count; i++) {
+        if (unique > 0 && strcmp(pending[unique - 1].name, pending[i].name) == 0) {
+            free(pending[i].name);
+            free(pending[i].path);
+            continue;
+        }
+        pending[unique++] = pending[i];
+    }
+
+    const char **names = malloc(unique * sizeof(char*));
+    const char **paths = malloc(unique * sizeof(char*));
+    ServiceQueryResult *results = calloc(unique, sizeof(ServiceQueryResult));
+
+    if (names && paths && results) {
+        for (size_t i = 0; i < unique; i++) {
+            names[i] = pending[i].name;
+            paths[i] = pending[i].path;
+        }
+
+        queryServices(names, paths, unique, results);
+
+        for (size_t i = 0; i < unique; i++) {
+            if (!results[i].exists || results[i].details == NULL) {
+                continue;
+            }
+            push_event(watch, SERVICE_EVENT_CHANGED, pending[i].name, results[i].running, results[i].details);
+            pending[i].name = NULL;
+            results[i].details = NULL;
+        }
+
+        freeServiceQueryResults(results, unique);
+    } else {
+        fprintf(stderr, "Memory allocation failed\n");
+    }
+
+    for (size_t i = 0; i < unique; i++) {
+        free(pending[i].name);
+        free(pending[i].path);
+    }
+    free(pending);
+    free(names);
+    free(paths);
+    free(results);
+    statsRecord(STAT_WATCH_FLUSH, start, false);
+    return 0;
+}
+
+static int on_stop(sd_event_source* source, int fd, uint32_t revents, void* userdata) {
+    (void)source;
+    (void)fd;
+    (void)revents;
+    ServiceWatch *watch = userdata;
+    return sd_event_exit(watch->event, 0);
+}
+
+static int subscribe(sd_bus* bus, ServiceWatch* watch) {
+    sd_bus_error error = SD_BUS_ERROR_NULL;
+    int r;
+
+    r = sd_bus_match_signal(bus, NULL, DESTINATION, "/org/freedesktop/systemd1",
+        "org.freedesktop.systemd1.Manager", "UnitNew", on_unit_new, watch);
+    if (r >= 0) {
+        r = sd_bus_match_signal(bus, NULL, DESTINATION, "/org/freedesktop/systemd1",
+            "org.freedesktop.systemd1.Manager", "UnitRemoved", on_unit_removed, watch);
+    }
+    if (r >= 0) {
+        r = sd_bus_add_match(bus, NULL,
+            "type='signal',"
+            "sender='" DESTINATION "',"
+            "interface='org.freedesktop.DBus.Properties',"
+            "member='PropertiesChanged',"
+            "path_namespace='" UNIT_PATH_PREFIX "'",
+            on_properties_changed, watch);
+    }
+    if (r < 0) {
+        fprintf(stderr, "Failed to add signal matches: %s\n", strerror(-r));
+        return r;
+    }
+
+    /* Without Subscribe, systemd only sends these signals to clients that asked for them. */
+    uint64_t start = statsNow();
+    r = sd_bus_call_method(bus, DESTINATION, "/org/freedesktop/systemd1",
+        "org.freedesktop.systemd1.Manager", "Subscribe", &error, NULL, "");
+    statsRecord(STAT_BUS_SUBSCRIBE, start, r < 0);
+    if (r < 0) {
+        fprintf(stderr, "Failed to subscribe to systemd: %s\n", error.message ? error.message : strerror(-r));
+        sd_bus_error_free(&error);
+    }
+
+    return r;
+}
+
+static void clear_pending(ServiceWatch* watch) {
+    for (size_t i = 0; i < watch->pending_count; i++) {
+        free(watch->pending[i].name);
+        free(watch->pending[i].path);
+    }
+    free(watch->pending);
+    watch->pending = NULL;
+    watch->pending_count = 0;
+    watch->pending_capacity = 0;
+}
+
+static void close_watch_bus(ServiceWatch* watch) {
+    if (watch->bus) {
+        sd_bus_detach_event(watch->bus);
+        sd_bus_flush_close_unref(watch->bus);
+        watch->bus = NULL;
+    }
+}
+
+static void schedule_reconnect(ServiceWatch* watch) {
+    uint64_t now;
+
+    if (sd_event_now(watch->event, CLOCK_MONOTONIC, &now) < 0 ||
+        sd_event_source_set_time(watch->reconnect_source, now + watch->reconnect_delay) < 0 ||
+        sd_event_source_set_enabled(watch->reconnect_source, SD_EVENT_ONESHOT) < 0) {
+        fprintf(stderr, "Failed to schedule a service watch reconnect\n");
+        sd_event_exit(watch->event, -EIO);
+    }
+}
+
+static int on_disconnected(sd_bus_message* msg, void* userdata, sd_bus_error* ret_error) {
+    (void)msg;
+    (void)ret_error;
+    ServiceWatch *watch = userdata;
+
+    fprintf(stderr, "Service watch lost the bus, reconnecting\n");
+    atomic_store(&watch->connected, false);
+
+    /* What was pending is covered by the resync after the reconnect. */
+    clear_pending(watch);
+    sd_event_source_set_enabled(watch->flush_source, SD_EVENT_OFF);
+
+    watch->reconnect_delay = RECONNECT_MIN_USEC;
+    schedule_reconnect(watch);
+    return 0;
+}
+
+/* Opens the watch's own connection, separate from the one queryServices uses on this thread. */
+static int connect_watch_bus(ServiceWatch* watch) {
+    int r = openServiceBus(&watch->bus);
+
+    if (r >= 0) {
+        r = sd_bus_attach_event(watch->bus, watch->event, 0);
+    }
+    if (r >= 0) {
+        /* sd-bus queues this local signal when the connection closes. */
+        r = sd_bus_match_signal(watch->bus, NULL, NULL, "/org/freedesktop/DBus/Local",
+            "org.freedesktop.DBus.Local", "Disconnected", on_disconnected, watch);
+    }
+    if (r >= 0) {
+        r = subscribe(watch->bus, watch);
+    }
+    if (r < 0) {
+        close_watch_bus(watch);
+    }
+    return r;
+}
+
+static int on_reconnect(sd_event_source* source, uint64_t usec, void* userdata) {
+    (void)source;
+    (void)usec;
+    ServiceWatch *watch = userdata;
+    uint64_t start = statsNow();
+
+    close_watch_bus(watch);
+    int r = connect_watch_bus(watch);
+    statsRecord(STAT_WATCH_RECONNECT, start, r < 0);
+
+    if (r < 0) {
+        watch->reconnect_delay = watch->reconnect_delay * 2 < RECONNECT_MAX_USEC ? watch->reconnect_delay * 2 : RECONNECT_MAX_USEC;
+        schedule_reconnect(watch);
+        return 0;
+    }
+
+    fprintf(stderr, "Service watch reconnected\n");
+    atomic_store(&watch->connected, true);
+    push_event(watch, SERVICE_EVENT_RESYNC, NULL, false, NULL);
+    return 0;
+}
+
+static void* watch_thread(void* arg) {
+    ServiceWatch *watch = arg;
+    int r;
+
+    r = sd_event_new(&watch->event);
+    if (r < 0) {
+        fprintf(stderr, "Failed to create event loop: %s\n", strerror(-r));
+        return NULL;
+    }
+
+    r = sd_event_add_io(watch->event, NULL, watch->stop_fd, EPOLLIN, on_stop, watch);
+    if (r >= 0) {
+        r = sd_event_add_time(watch->event, &watch->flush_source, CLOCK_MONOTONIC, 0, 0, flush_pending, watch);
+    }
+    if (r >= 0) {
+        r = sd_event_source_set_enabled(watch->flush_source, SD_EVENT_OFF);
+    }
+    if (r >= 0) {
+        r = sd_event_add_time(watch->event, &watch->reconnect_source, CLOCK_MONOTONIC, 0, 0, on_reconnect, watch);
+    }
+    if (r >= 0) {
+        r = sd_event_source_set_enabled(watch->reconnect_source, SD_EVENT_OFF);
+    }
+    if (r >= 0) {
+        /* A bus that is not up yet is waited for like a lost one. */
+        if (connect_watch_bus(watch) >= 0) {
+            atomic_store(&watch->connected, true);
+        } else {
+            watch->reconnect_delay = RECONNECT_MIN_USEC;
+            schedule_reconnect(watch);
+        }
+    }
+
+    if (r >= 0) {
+        r = sd_event_loop(watch->event);
+        if (r < 0) {
+            fprintf(stderr, "Service watch stopped: %s\n", strerror(-r));
+        }
+    } else {
+        fprintf(stderr, "Failed to start service watch: %s\n", strerror(-r));
+    }
+
+    atomic_store(&watch->connected, false);
+    close_watch_bus(watch);
+    closeServiceBus();
+    watch->flush_source = sd_event_source_unref(watch->flush_source);
+    watch->reconnect_source = sd_event_source_unref(watch->reconnect_source);
+    sd_event_unref(watch->event);
+    watch->event = NULL;
+
+    clear_pending(watch);
+
+    return NULL;
+}
+
+static void free_watch(ServiceWatch* watch) {
+    for (size_t i = 0; i < watch->pattern_count; i++) {
+        free(watch->patterns[i]);
+    }
+    free(watch->patterns);
+    freeServiceEvents(watch->events, watch->event_count);
+    free(watch->events);
+    if (watch->stop_fd >= 0) {
+        close(watch->stop_fd);
+    }
+    pthread_mutex_destroy(&watch->lock);
+    free(watch);
+}
+
+bool startServiceWatch(const char* const* patterns, size_t pattern_count) {
+    ServiceWatch *watch;
+
+    if (service_watch) {
+        return true;
+    }
+
+    watch = calloc(1, sizeof(ServiceWatch));
+    if (watch == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return false;
+    }
+
+    pthread_mutex_init(&watch->lock, NULL);
+    atomic_init(&watch->connected, false);
+    watch->stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    watch->patterns = calloc(pattern_count ? pattern_count : 1, sizeof(char*));
+
+    if (watch->stop_fd < 0 || watch->patterns == NULL) {
+        fprintf(stderr, "Failed to set up service watch: %s\n", strerror(errno));
+        free_watch(watch);
+        return false;
+    }
+
+    for (size_t i = 0; i < pattern_count; i++) {
+        watch->patterns[i] = strdup(patterns[i]);
+        if (watch->patterns[i] == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            free_watch(watch);
+            return false;
+        }
+        watch->pattern_count++;
+    }
+
+    if (pthread_create(&watch->thread, NULL, watch_thread, watch) != 0) {
+        fprintf(stderr, "Failed to start service watch thread\n");
+        free_watch(watch);
+        return false;
+    }
+
+    service_watch = watch;
+    return true;
+}
+
+void stopServiceWatch(void) {
+    ServiceWatch *watch = service_watch;
+    uint64_t one = 1;
+
+    if (watch == NULL) {
+        return;
+    }
+
+    if (write(watch->stop_fd, &one, sizeof(one)) < 0) {
+        fprintf(stderr, "Failed to stop service watch: %s\n", strerror(errno));
+    }
+    pthread_join(watch->thread, NULL);
+
+    service_watch = NULL;
+    free_watch(watch);
+}
+
+bool isServiceWatchConnected(void) {
+    ServiceWatch *watch = service_watch;
+    return watch != NULL && atomic_load(&watch->connected);
+}
+
+size_t pollServiceEvents(ServiceEvent* events, size_t max) {
+    ServiceWatch *watch = service_watch;
+    size_t count;
+
+    if (watch == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&watch->lock);
+
+    count = watch->event_count < max ? watch->event_count : max;
+    memcpy(events, watch->events, count * sizeof(ServiceEvent));
+    memmove(watch->events, watch->events + count, (watch->event_count - count) * sizeof(ServiceEvent));
+    watch->event_count -= count;
+
+    pthread_mutex_unlock(&watch->lock);
+    return count;
+}
+
+void freeServiceEvents(ServiceEvent* events, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(events[i].name);
+        freeServiceDetails(events[i].details);
+    }
+}
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "work_pool.h"
+#include "service.h"
+
+#define WORK_POOL_MAX_WORKERS 8
+
+typedef struct {
+    WorkFunction fn;
+    void *context;
+    size_t count;
+    atomic_size_t next;
+} WorkJob;
+
+/* Serializes runWork() callers; the pool runs one job at a time. */
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Everything below is protected by pool_lock. */
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_idle = PTHREAD_COND_INITIALIZER;
+static pthread_t workers[WORK_POOL_MAX_WORKERS];
+static size_t worker_count;
+static bool pool_started;
+static bool pool_stopping;
+static WorkJob *current_job;
+static uint64_t job_generation;
+static size_t busy_workers;
+
+/* Set while this thread runs a job's function; runWork() from there would wait on itself. */
+static _Thread_local bool in_job;
+
+static void drain_job(WorkJob* job) {
+    size_t index;
+
+    in_job = true;
+    while ((index = atomic_fetch_add(&job->next, 1)) < job->count) {
+        job->fn(job->context, index);
+    }
+    in_job = false;
+}
+
+static void* work_pool_worker(void* arg) {
+    uint64_t seen = 0;
+
+    (void)arg;
+
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        while (!pool_stopping && job_generation == seen) {
+            pthread_cond_wait(&pool_wake, &pool_lock);
+        }
+        if (pool_stopping) {
+            break;
+        }
+
+        /* A job that finished before this worker woke up is already gone. */
+        seen = job_generation;
+        WorkJob *job = current_job;
+        if (job == NULL) {
+            continue;
+        }
+
+        busy_workers++;
+        pthread_mutex_unlock(&pool_lock);
+
+        drain_job(job);
+
+        pthread_mutex_lock(&pool_lock);
+        if (--busy_workers == 0) {
+            pthread_cond_signal(&pool_idle);
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    closeServiceBus();
+    return NULL;
+}
+
+/* Called with pool_lock held. */
+static void start_workers(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t wanted = cpus > 0 ? (size_t)cpus : 1;
+
+    if (wanted > WORK_POOL_MAX_WORKERS) {
+        wanted = WORK_POOL_MAX_WORKERS;
+    }
+
+    pool_stopping = false;
+    worker_count = 0;
+    for (size_t i = 0; i < wanted; i++) {
+        if (pthread_create(&workers[worker_count], NULL, work_pool_worker, NULL) == 0) {
+            worker_count++;
+        }
+    }
+    if (worker_count < wanted) {
+        fprintf(stderr, "Started %zu of %zu worker threads\n", worker_count, wanted);
+    }
+    pool_started = true;
+}
+
+void runWork(WorkFunction fn, void* context, size_t count) {
+    WorkJob job = { .fn = fn, .context = context, .count = count };
+
+    atomic_init(&job.next, 0);
+    assert(!in_job && "runWork() called from inside a job");
+
+    /* Not worth waking anyone for. */
+    if (count <= 1) {
+        drain_job(&job);
+        return;
+    }
+
+    pthread_mutex_lock(&job_lock);
+
+    pthread_mutex_lock(&pool_lock);
+    if (!pool_started) {
+        start_workers();
+    }
+    current_job = &job;
+    job_generation++;
+    pthread_cond_broadcast(&pool_wake);
+    pthread_mutex_unlock(&pool_lock);
+
+    /* Whatever the workers (if any) do not get to is done here. */
+    drain_job(&job);
+
+    pthread_mutex_lock(&pool_lock);
+    while (busy_workers > 0) {
+        pthread_cond_wait(&pool_idle, &pool_lock);
+    }
+    current_job = NULL;
+    pthread_mutex_unlock(&pool_lock);
+
+    pthread_mutex_unlock(&job_lock);
+}
+
+void stopWorkPool(void) {
+    assert(!in_job && "stopWorkPool() called from inside a job");
+    pthread_mutex_lock(&job_lock);
+
+    pthread_mutex_lock(&pool_lock);
+    if (!pool_started) {
+        pthread_mutex_unlock(&pool_lock);
+        pthread_mutex_unlock(&job_lock);
+        return;
+    }
+    pool_stopping = true;
+    pthread_cond_broadcast(&pool_wake);
+    pthread_mutex_unlock(&pool_lock);
+
+    for (size_t i = 0; i < worker_count; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    worker_count = 0;
+    pool_started = false;
+    pthread_mutex_unlock(&pool_lock);
+
+    pthread_mutex_unlock(&job_lock);
+}
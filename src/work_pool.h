@@ -0,0 +1,39 @@
+#ifndef SERVICE_VIEWER_WORK_POOL_H
+#define SERVICE_VIEWER_WORK_POOL_H
+
+/*
+ * A fixed set of worker threads, started on first use and kept until
+ * stopWorkPool(). Workers keep their per-thread bus connection (see
+ * service.c) between jobs, so spreading bus work over them costs no
+ * reconnects after the first job.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*WorkFunction)(void* context, size_t index);
+
+/*
+ * Calls fn(context, i) exactly once for every i < count, spread over the
+ * workers and the calling thread, and returns when all calls are done.
+ * Indices are handed out in order from a shared atomic counter; callers
+ * write results into preallocated slots by index. Jobs from several
+ * threads run one after another.
+ *
+ * Not reentrant: fn must not call runWork() or stopWorkPool(). The outer
+ * call holds the pool until its job is done, so the nested one would wait
+ * forever; debug builds assert instead.
+ */
+void runWork(WorkFunction fn, void* context, size_t count);
+
+/* Joins the workers, each closing its bus connection. The next runWork() starts new ones. */
+void stopWorkPool(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "service.h"
+#include "native_tests.h"
+
+/*
+ * SHA-256 known answers and binary resolution of integrity.c, run by
+ * tests/native.rs. The resolution cases build a small image below a fresh
+ * temporary directory, with the hash cache kept there too.
+ */
+
+static int failures;
+
+#define CHECK(condition, ...) do {                                   \
+    if (!(condition)) {                                              \
+        fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);             \
+        fprintf(stderr, __VA_ARGS__);                                \
+        fprintf(stderr, "\n");                                       \
+        failures++;                                                  \
+    }                                                                \
+} while (0)
+
+static char root[] = "/tmp/integrity_test.XXXXXX";
+static char image[4096];
+
+static const char* hex(const uint8_t digest[EXECUTABLE_HASH_SIZE]) {
+    static char text[EXECUTABLE_HASH_SIZE * 2 + 1];
+    for (size_t i = 0; i < EXECUTABLE_HASH_SIZE; i++) {
+        sprintf(text + i * 2, "%02x", digest[i]);
+    }
+    return text;
+}
+
+/* `length` copies of `byte`, for the long and boundary-length messages. */
+static char* repeated(char byte, size_t length) {
+    char *data = malloc(length + 1);
+    if (data) {
+        memset(data, byte, length);
+        data[length] = '\0';
+    }
+    return data;
+}
+
+static void test_known_answers(void) {
+    /* FIPS 180-4 examples, then messages around the 56-byte padding boundary. */
+    static const struct {
+        const char *message;
+        size_t repeat;
+        const char *digest;
+    } cases[] = {
+        { "", 0, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+        { "abc", 0, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+        { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 0, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+        { "a", 1000000, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+        { "a", 55, "9f4390f8d30c2dd92ec9f095b65e2b9ae9b0a925a5258e241c9f1e910f734318" },
+        { "a", 56, "b35439a4ac6f0948b6d6f9e3c6af0f5f590ce20f1bde7090ef7970686ec6738a" },
+        { "a", 63, "7d3e74a05d7db15bce4ad9ec0658ea98e3f06eeecf16b4c6fff2da457ddc2f34" },
+        { "a", 64, "ffe054fe7ae0cb6dc65c3af9b61d5209f439851db43d0ba5997337df154668eb" },
+        { "a", 65, "635361c48bb9eab14198e76ea8ab7f1a41685d6ad62aa9146d301d4f17eb0ae0" },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        char *message = cases[i].repeat ? repeated(cases[i].message[0], cases[i].repeat) : strdup(cases[i].message);
+        uint8_t digest[EXECUTABLE_HASH_SIZE];
+
+        if (message == NULL) {
+            CHECK(false, "out of memory");
+            return;
+        }
+        sha256Digest(message, strlen(message), digest);
+        CHECK(strcmp(hex(digest), cases[i].digest) == 0, "SHA-256 of %zu bytes is %s", strlen(message), hex(digest));
+        free(message);
+    }
+}
+
+static bool write_file(const char* relative, const char* content, mode_t mode) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", root, relative);
+
+    /* Parent directories first, e.g. for "image/usr/bin/tool". */
+    for (char *slash = strchr(path + strlen(root) + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+            fprintf(stderr, "Failed to create %s: %s\n", path, strerror(errno));
+            return false;
+        }
+        *slash = '/';
+    }
+
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to create %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    fputs(content, file);
+    fclose(file);
+    return chmod(path, mode) == 0;
+}
+
+static bool write_link(const char* relative, const char* target) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", root, relative);
+    if (symlink(target, path) < 0) {
+        fprintf(stderr, "Failed to link %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+/* Hashes one unit's binary below the image, or on the host if `below_image` is false. */
+static ExecutableHash hash_one(bool below_image, const char* binary, const char* command) {
+    ExecutableHash hash;
+    if (!hashExecutables(below_image ? image : NULL, &binary, &command, 1, &hash)) {
+        memset(&hash, 0, sizeof(hash));
+        hash.error = -1;
+    }
+    return hash;
+}
+
+static bool shown_as(const ExecutableHash* hash, const char* relative) {
+    char expected[8192];
+    snprintf(expected, sizeof(expected), "%s%s", image, relative);
+    return hash->path != NULL && strcmp(hash->path, expected) == 0;
+}
+
+static void test_binary_over_command(void) {
+    /* The binary systemd resolved wins; argv[0] may name anything. */
+    ExecutableHash hash = hash_one(true, "/usr/bin/tool", "other --flag");
+    CHECK(hash.error == 0, "hashing /usr/bin/tool failed: %s", strerror(hash.error));
+    CHECK(shown_as(&hash, "/usr/bin/tool"), "the binary is shown as %s", hash.path ? hash.path : "(null)");
+    CHECK(hash.error != 0 || strcmp(hex(hash.sha256), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad") == 0,
+          "/usr/bin/tool hashed to %s", hex(hash.sha256));
+    freeExecutableHashes(&hash, 1);
+
+    /* Without a root the command is never guessed from. */
+    hash = hash_one(false, "", "/usr/bin/true --flag");
+    CHECK(hash.path == NULL && hash.error == 0, "a live unit without a binary was hashed from its command");
+    freeExecutableHashes(&hash, 1);
+}
+
+static void test_guessed_from_command(void) {
+    ExecutableHash hash = hash_one(true, "", "-tool --flag; other");
+    CHECK(hash.error == 0, "guessing tool failed: %s", strerror(hash.error));
+    CHECK(shown_as(&hash, "/usr/bin/tool"), "tool is shown as %s", hash.path ? hash.path : "(null)");
+    freeExecutableHashes(&hash, 1);
+
+    /* Not executable: the search goes on and finds nothing. */
+    hash = hash_one(true, "", "data");
+    CHECK(hash.path == NULL && hash.error == ENOENT, "a file that is not executable was taken for a command");
+    freeExecutableHashes(&hash, 1);
+}
+
+static void test_symlinks_stay_in_root(void) {
+    /* /bin -> /usr/bin and an absolute link to the binary, both resolved below the image. */
+    ExecutableHash hash = hash_one(true, "/bin/absolute", NULL);
+    CHECK(hash.error == 0, "/bin/absolute failed: %s", strerror(hash.error));
+    CHECK(shown_as(&hash, "/bin/absolute"), "/bin/absolute is shown as %s", hash.path ? hash.path : "(null)");
+    CHECK(hash.error != 0 || strcmp(hex(hash.sha256), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad") == 0,
+          "/bin/absolute hashed to %s", hex(hash.sha256));
+    freeExecutableHashes(&hash, 1);
+
+    /* Relative and absolute links to a file next to the image must not reach it. */
+    hash = hash_one(true, "/usr/bin/up", NULL);
+    CHECK(hash.error == ENOENT, "/usr/bin/up left the root: %s", hash.error ? strerror(hash.error) : "hashed");
+    freeExecutableHashes(&hash, 1);
+    hash = hash_one(true, "/usr/bin/out", NULL);
+    CHECK(hash.error == ENOENT, "/usr/bin/out left the root: %s", hash.error ? strerror(hash.error) : "hashed");
+    freeExecutableHashes(&hash, 1);
+
+    hash = hash_one(true, "/usr/bin/loop", NULL);
+    CHECK(hash.error == ELOOP, "/usr/bin/loop: %s", hash.error ? strerror(hash.error) : "hashed");
+    freeExecutableHashes(&hash, 1);
+}
+
+static void test_large_file(void) {
+    /* The million 'a's again, read from a mapped file. */
+    ExecutableHash hash = hash_one(true, "/usr/bin/large", NULL);
+    CHECK(hash.error == 0, "/usr/bin/large failed: %s", strerror(hash.error));
+    CHECK(hash.error != 0 || strcmp(hex(hash.sha256), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0") == 0,
+          "/usr/bin/large hashed to %s", hex(hash.sha256));
+    freeExecutableHashes(&hash, 1);
+}
+
+static bool build_image(void) {
+    char outside[4096];
+    char *large = repeated('a', 1000000);
+    bool ok = large != NULL &&
+        write_file("image/usr/bin/tool", "abc", 0755) &&
+        write_file("image/usr/bin/data", "", 0644) &&
+        write_file("image/usr/bin/large", large, 0755) &&
+        write_file("secret", "outside the image", 0755) &&
+        write_link("image/bin", "/usr/bin") &&
+        write_link("image/usr/bin/absolute", "/usr/bin/tool") &&
+        write_link("image/usr/bin/up", "../../../secret") &&
+        write_link("image/usr/bin/loop", "loop");
+
+    snprintf(outside, sizeof(outside), "%s/secret", root);
+    ok = ok && write_link("image/usr/bin/out", outside);
+    free(large);
+    return ok;
+}
+
+static void remove_tree(void) {
+    char command[4200];
+    snprintf(command, sizeof(command), "rm -rf '%s'", root);
+    if (system(command) != 0) {
+        fprintf(stderr, "Failed to remove %s\n", root);
+    }
+}
+
+int runIntegrityTests(void) {
+    char cache[4096];
+
+    failures = 0;
+    test_known_answers();
+
+    strcpy(root, "/tmp/integrity_test.XXXXXX");
+    if (mkdtemp(root) == NULL) {
+        fprintf(stderr, "Failed to create a temporary directory: %s\n", strerror(errno));
+        return failures + 1;
+    }
+    snprintf(image, sizeof(image), "%s/image", root);
+    snprintf(cache, sizeof(cache), "%s/cache", root);
+
+    /* The digests of the test files stay out of the user's cache. */
+    const char *saved = getenv("XDG_CACHE_HOME");
+    char *saved_cache = saved ? strdup(saved) : NULL;
+    setenv("XDG_CACHE_HOME", cache, 1);
+    closeHashCache();
+
+    if (build_image()) {
+        test_binary_over_command();
+        test_guessed_from_command();
+        test_symlinks_stay_in_root();
+        test_large_file();
+    } else {
+        failures++;
+    }
+
+    closeHashCache();
+    if (saved_cache) {
+        setenv("XDG_CACHE_HOME", saved_cache, 1);
+        free(saved_cache);
+    } else {
+        unsetenv("XDG_CACHE_HOME");
+    }
+    remove_tree();
+    return failures;
+}
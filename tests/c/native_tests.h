@@ -0,0 +1,13 @@
+#ifndef SERVICE_VIEWER_NATIVE_TESTS_H
+#define SERVICE_VIEWER_NATIVE_TESTS_H
+
+/*
+ * Entry points of the C tests under tests/c, built into libservice_tests by
+ * build.rs and run from tests/native.rs. Each returns the number of failed
+ * checks and prints what failed to stderr.
+ */
+
+int runUnitFileTests(void);
+int runIntegrityTests(void);
+
+#endif
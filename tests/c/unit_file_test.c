@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "unit_file.h"
+#include "native_tests.h"
+
+/*
+ * Parser cases of unit_file.c, run by tests/native.rs. Every case writes
+ * its files below a fresh temporary directory and parses them without a
+ * cache, so nothing depends on the host's units.
+ */
+
+static int failures;
+
+#define CHECK(condition, ...) do {                                   \
+    if (!(condition)) {                                              \
+        fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);             \
+        fprintf(stderr, __VA_ARGS__);                                \
+        fprintf(stderr, "\n");                                       \
+        failures++;                                                  \
+    }                                                                \
+} while (0)
+
+static char root[] = "/tmp/unit_file_test.XXXXXX";
+
+static bool write_file(const char* relative, const char* content) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", root, relative);
+
+    /* Parent directories first, e.g. for "etc/foo.service.d/10.conf". */
+    for (char *slash = strchr(path + strlen(root) + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+            fprintf(stderr, "Failed to create %s: %s\n", path, strerror(errno));
+            return false;
+        }
+        *slash = '/';
+    }
+
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to create %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    fputs(content, file);
+    fclose(file);
+    return true;
+}
+
+static UnitFile* parse(const char* relative, const char* const* dirs, size_t dir_count) {
+    char path[4096];
+    char absolute[4][4096];
+    const char *absolute_dirs[4];
+
+    snprintf(path, sizeof(path), "%s/%s", root, relative);
+    for (size_t i = 0; i < dir_count && i < 4; i++) {
+        snprintf(absolute[i], sizeof(absolute[i]), "%s/%s", root, dirs[i]);
+        absolute_dirs[i] = absolute[i];
+    }
+    return parseUnitFile(NULL, NULL, path, absolute_dirs, dir_count);
+}
+
+/* `value` with leading and trailing blanks dropped and inner runs folded into one space. */
+static const char* fold_blanks(const char* value) {
+    static char folded[4096];
+    size_t length = 0;
+
+    for (const char *p = value; *p && length + 2 < sizeof(folded); p++) {
+        if (!isspace((unsigned char)*p)) {
+            folded[length++] = *p;
+        } else if (length > 0 && folded[length - 1] != ' ') {
+            folded[length++] = ' ';
+        }
+    }
+    if (length > 0 && folded[length - 1] == ' ') {
+        length--;
+    }
+    folded[length] = '\0';
+    return folded;
+}
+
+static bool same_words(const char* value, const char* expected) {
+    return value != NULL && strcmp(fold_blanks(value), expected) == 0;
+}
+
+static bool equals(const char* value, const char* expected) {
+    return value != NULL && strcmp(value, expected) == 0;
+}
+
+/* Every value of `key` in `section`, in order, joined by '|'. */
+static const char* values_of(const UnitFile* unit, const char* section, const char* key) {
+    static char joined[4096];
+    size_t length = 0;
+
+    joined[0] = '\0';
+    for (size_t i = 0; i < unit->count; i++) {
+        const UnitFileEntry *entry = &unit->entries[i];
+        if (strcmp(entry->section, section) == 0 && strcmp(entry->key, key) == 0) {
+            length += (size_t)snprintf(joined + length, sizeof(joined) - length, "%s%s", length ? "|" : "", entry->value);
+        }
+    }
+    return joined;
+}
+
+static void test_continuations(void) {
+    write_file("continuation/foo.service",
+        "[Service]\n"
+        "ExecStart=/usr/bin/foo \\\n"
+        "    --first \\\n"
+        "# a comment inside the continuation\n"
+        "; and another one\n"
+        "    --second\n"
+        "Description=after the continuation\n"
+        "Environment=TRAILING=1 \\\n");
+
+    UnitFile *unit = parse("continuation/foo.service", NULL, 0);
+    CHECK(unit != NULL, "continuation/foo.service did not parse");
+    if (unit == NULL) {
+        return;
+    }
+
+    const char *exec_start = unitFileGet(unit, "Service", "ExecStart");
+    CHECK(same_words(exec_start, "/usr/bin/foo --first --second"), "ExecStart is \"%s\"", exec_start ? exec_start : "(null)");
+    CHECK(exec_start && strstr(exec_start, "comment") == NULL, "a comment was joined into ExecStart");
+    CHECK(exec_start && strchr(exec_start, '\\') == NULL, "a backslash was left in ExecStart");
+    CHECK(equals(unitFileGet(unit, "Service", "Description"), "after the continuation"), "the line after a continuation was lost");
+    /* A backslash on the last line has nothing to continue with. */
+    CHECK(equals(unitFileGet(unit, "Service", "Environment"), "TRAILING=1"), "Environment is \"%s\"", unitFileGet(unit, "Service", "Environment"));
+    freeUnitFile(unit);
+}
+
+static void test_empty_resets(void) {
+    write_file("reset/foo.service",
+        "[Service]\n"
+        "ExecStartPre=/bin/a\n"
+        "ExecStartPre=/bin/b\n"
+        "ExecStartPre=\n"
+        "ExecStartPre=/bin/c\n"
+        "Environment=KEEP=1\n"
+        "[Unit]\n"
+        "After=a.target\n");
+    write_file("reset/foo.service.d/10-override.conf",
+        "[Unit]\n"
+        "After=\n"
+        "After=b.target\n"
+        "[Service]\n"
+        "Environment=MORE=2\n");
+
+    UnitFile *unit = parse("reset/foo.service", NULL, 0);
+    CHECK(unit != NULL, "reset/foo.service did not parse");
+    if (unit == NULL) {
+        return;
+    }
+
+    CHECK(equals(values_of(unit, "Service", "ExecStartPre"), "/bin/c"), "ExecStartPre is \"%s\"", values_of(unit, "Service", "ExecStartPre"));
+    CHECK(equals(values_of(unit, "Unit", "After"), "b.target"), "After is \"%s\" after a drop-in reset", values_of(unit, "Unit", "After"));
+    CHECK(equals(values_of(unit, "Service", "Environment"), "KEEP=1|MORE=2"), "Environment is \"%s\"", values_of(unit, "Service", "Environment"));
+    freeUnitFile(unit);
+}
+
+static void test_equals_in_values(void) {
+    write_file("equals/foo.service",
+        "[Service]\n"
+        "Environment=A=b=c\n"
+        "  Description  =  x = y  \n"
+        "ExecStart=/bin/sh -c 'test \"$A\" = b=c'\n"
+        "=no key\n"
+        "no equals sign\n");
+
+    UnitFile *unit = parse("equals/foo.service", NULL, 0);
+    CHECK(unit != NULL, "equals/foo.service did not parse");
+    if (unit == NULL) {
+        return;
+    }
+
+    CHECK(equals(unitFileGet(unit, "Service", "Environment"), "A=b=c"), "Environment is \"%s\"", unitFileGet(unit, "Service", "Environment"));
+    CHECK(equals(unitFileGet(unit, "Service", "Description"), "x = y"), "Description is \"%s\"", unitFileGet(unit, "Service", "Description"));
+    CHECK(equals(unitFileGet(unit, "Service", "ExecStart"), "/bin/sh -c 'test \"$A\" = b=c'"), "ExecStart is \"%s\"", unitFileGet(unit, "Service", "ExecStart"));
+    CHECK(unit->count == 3, "%zu entries, the malformed lines should be skipped", unit->count);
+    freeUnitFile(unit);
+}
+
+static void test_dropin_precedence(void) {
+    write_file("usr/foo@bar.service",
+        "[Unit]\n"
+        "Description=unit file\n"
+        "[Service]\n"
+        "User=nobody\n");
+    /* Same name in the instance, template and type dirs: the instance's wins. */
+    write_file("usr/foo@bar.service.d/10-name.conf", "[Unit]\nDescription=instance\n");
+    write_file("usr/foo@.service.d/10-name.conf", "[Unit]\nDescription=template\n");
+    write_file("usr/service.d/10-name.conf", "[Unit]\nDescription=type\n");
+    /* Different names apply in filename order, whatever dir they are in. */
+    write_file("usr/service.d/05-user.conf", "[Service]\nUser=type\nGroup=type\n");
+    write_file("usr/foo@.service.d/20-user.conf", "[Service]\nUser=template\n");
+    /* A higher priority dir hides a drop-in of the same name in a lower one. */
+    write_file("etc/foo@.service.d/20-user.conf", "[Service]\nUser=admin\n");
+
+    const char *usr_only[] = { "usr" };
+    UnitFile *unit = parse("usr/foo@bar.service", usr_only, 1);
+    CHECK(unit != NULL, "usr/foo@bar.service did not parse");
+    if (unit != NULL) {
+        CHECK(equals(unitFileGet(unit, "Unit", "Description"), "instance"), "Description is \"%s\"", unitFileGet(unit, "Unit", "Description"));
+        CHECK(equals(values_of(unit, "Unit", "Description"), "unit file|instance"), "the masked drop-ins were applied: \"%s\"", values_of(unit, "Unit", "Description"));
+        CHECK(equals(unitFileGet(unit, "Service", "User"), "template"), "User is \"%s\"", unitFileGet(unit, "Service", "User"));
+        CHECK(equals(unitFileGet(unit, "Service", "Group"), "type"), "Group is \"%s\"", unitFileGet(unit, "Service", "Group"));
+        freeUnitFile(unit);
+    }
+
+    const char *both[] = { "etc", "usr" };
+    unit = parse("usr/foo@bar.service", both, 2);
+    CHECK(unit != NULL, "usr/foo@bar.service did not parse with two dirs");
+    if (unit != NULL) {
+        CHECK(equals(unitFileGet(unit, "Service", "User"), "admin"), "User is \"%s\" with etc first", unitFileGet(unit, "Service", "User"));
+        CHECK(equals(unitFileGet(unit, "Unit", "Description"), "instance"), "Description is \"%s\" with etc first", unitFileGet(unit, "Unit", "Description"));
+        freeUnitFile(unit);
+    }
+
+    /* Without dirs the unit file's own directory is searched. */
+    unit = parse("usr/foo@bar.service", NULL, 0);
+    CHECK(unit != NULL && equals(unitFileGet(unit, "Unit", "Description"), "instance"), "drop-ins next to the unit file were not found");
+    freeUnitFile(unit);
+}
+
+static void test_dropins_below_root(void) {
+    char image[64];
+    char image_host[64];
+    char link[4096];
+    char target[4096];
+    char path[4096];
+
+    /* The image links its drop-in dir to a path that also exists outside of it. */
+    snprintf(image, sizeof(image), "%s/image", root);
+    snprintf(image_host, sizeof(image_host), "image%s", root);
+    if (!write_file("image/etc/foo.service", "[Unit]\nDescription=unit\n")) {
+        failures++;
+        return;
+    }
+    for (int i = 0; i < 2; i++) {
+        const char *prefix = i ? image_host : ".";
+        const char *owner = i ? "inside" : "escaped";
+        char relative[256];
+        char content[64];
+
+        snprintf(relative, sizeof(relative), "%s/host.d/10.conf", prefix);
+        snprintf(content, sizeof(content), "[Unit]\nDescription=%s\n", owner);
+        write_file(relative, content);
+        snprintf(relative, sizeof(relative), "%s/host.conf", prefix);
+        snprintf(content, sizeof(content), "[Service]\nUser=%s\n", owner);
+        write_file(relative, content);
+    }
+
+    snprintf(link, sizeof(link), "%s/etc/foo.service.d", image);
+    snprintf(target, sizeof(target), "%s/host.d", root);
+    CHECK(symlink(target, link) == 0, "symlink %s: %s", link, strerror(errno));
+    snprintf(link, sizeof(link), "%s/%s/host.d/20.conf", root, image_host);
+    snprintf(target, sizeof(target), "../../../../../../../../../..%s/host.conf", root);
+    CHECK(symlink(target, link) == 0, "symlink %s: %s", link, strerror(errno));
+
+    const char *dirs[] = { "/etc" };
+    snprintf(path, sizeof(path), "%s/etc/foo.service", image);
+    UnitFile *unit = parseUnitFile(NULL, image, path, dirs, 1);
+    CHECK(unit != NULL, "foo.service below the root did not parse");
+    if (unit) {
+        CHECK(equals(unitFileGet(unit, "Unit", "Description"), "inside"),
+            "absolute drop-in dir link read \"%s\"", unitFileGet(unit, "Unit", "Description"));
+        CHECK(equals(unitFileGet(unit, "Service", "User"), "inside"),
+            "relative drop-in link read \"%s\"", unitFileGet(unit, "Service", "User"));
+        freeUnitFile(unit);
+    }
+}
+
+static void test_missing_file(void) {
+    CHECK(parse("missing/foo.service", NULL, 0) == NULL, "a missing unit file parsed");
+}
+
+static void remove_tree(void) {
+    char command[4200];
+    snprintf(command, sizeof(command), "rm -rf '%s'", root);
+    if (system(command) != 0) {
+        fprintf(stderr, "Failed to remove %s\n", root);
+    }
+}
+
+int runUnitFileTests(void) {
+    failures = 0;
+    strcpy(root, "/tmp/unit_file_test.XXXXXX");
+    if (mkdtemp(root) == NULL) {
+        fprintf(stderr, "Failed to create a temporary directory: %s\n", strerror(errno));
+        return 1;
+    }
+
+    test_continuations();
+    test_empty_resets();
+    test_equals_in_values();
+    test_dropin_precedence();
+    test_dropins_below_root();
+    test_missing_file();
+
+    remove_tree();
+    return failures;
+}
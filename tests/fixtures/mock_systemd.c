@@ -0,0 +1,491 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <fnmatch.h>
+#include <systemd/sd-bus.h>
+
+/*
+ * A stand-in for systemd's org.freedesktop.systemd1 with a fixed number of
+ * synthetic units, for benchmarks and tests that must not depend on the
+ * host's systemd. It implements what service_viewer calls: the Manager's
+ * GetUnit, LoadUnit, ListUnits* and Subscribe, and Properties.Get/GetAll on
+ * the Unit and Service interfaces.
+ *
+ *     mock_systemd ADDRESS UNITS [FRAGMENT_DIR]
+ *
+ * connects to the bus daemon at ADDRESS (see tests/fixtures/bus.conf),
+ * takes the name org.freedesktop.systemd1 and prints "ready" once it
+ * serves. Units are named fixture000000.service, ...; every tenth is a
+ * .socket. FragmentPath points into FRAGMENT_DIR (default
+ * /usr/lib/systemd/system).
+ */
+
+#define DESTINATION "org.freedesktop.systemd1"
+#define MANAGER_PATH "/org/freedesktop/systemd1"
+#define MANAGER_INTERFACE "org.freedesktop.systemd1.Manager"
+#define UNIT_INTERFACE "org.freedesktop.systemd1.Unit"
+#define SERVICE_INTERFACE "org.freedesktop.systemd1.Service"
+#define UNIT_PATH_PREFIX "/org/freedesktop/systemd1/unit"
+#define NAME_PREFIX "fixture"
+#define NAME_DIGITS 6
+#define MAX_UNITS 1000000
+#define NAME_SIZE 48
+
+static size_t unit_count;
+static const char *fragment_dir = "/usr/lib/systemd/system";
+
+static bool is_socket(size_t unit) {
+    return unit % 10 == 9;
+}
+
+static void unit_name(size_t unit, char name[NAME_SIZE]) {
+    snprintf(name, NAME_SIZE, NAME_PREFIX "%0*zu.%s", NAME_DIGITS, unit, is_socket(unit) ? "socket" : "service");
+}
+
+/* The unit a name stands for, or -1. */
+static long unit_by_name(const char* name) {
+    size_t prefix = strlen(NAME_PREFIX);
+    if (strncmp(name, NAME_PREFIX, prefix) != 0) {
+        return -1;
+    }
+
+    char *end;
+    errno = 0;
+    unsigned long unit = strtoul(name + prefix, &end, 10);
+    if (errno != 0 || end != name + prefix + NAME_DIGITS || unit >= unit_count) {
+        return -1;
+    }
+    return strcmp(end, is_socket(unit) ? ".socket" : ".service") == 0 ? (long)unit : -1;
+}
+
+static long unit_by_path(const char* path) {
+    char *name = NULL;
+    if (sd_bus_path_decode(path, UNIT_PATH_PREFIX, &name) <= 0) {
+        return -1;
+    }
+    long unit = unit_by_name(name);
+    free(name);
+    return unit;
+}
+
+static const char* active_state(size_t unit) {
+    if (unit % 3 == 0) {
+        return "inactive";
+    }
+    return unit % 7 == 0 ? "failed" : "active";
+}
+
+static const char* sub_state(size_t unit) {
+    if (strcmp(active_state(unit), "active") != 0) {
+        return strcmp(active_state(unit), "failed") == 0 ? "failed" : "dead";
+    }
+    return is_socket(unit) ? "listening" : "running";
+}
+
+/* 1 for an appended property, or the error. */
+static int appended(int r) {
+    return r < 0 ? r : 1;
+}
+
+/* The value of `property` as a variant; 0 if the unit has no such property. */
+static int append_property(sd_bus_message* m, size_t unit, const char* interface, const char* property) {
+    char name[NAME_SIZE];
+    unit_name(unit, name);
+    bool unit_interface = strcmp(interface, UNIT_INTERFACE) == 0;
+    bool running = strcmp(active_state(unit), "active") == 0;
+
+    if (unit_interface) {
+        if (strcmp(property, "Id") == 0) {
+            return appended(sd_bus_message_append(m, "v", "s", name));
+        }
+        if (strcmp(property, "Description") == 0) {
+            char description[64];
+            snprintf(description, sizeof(description), "Fixture unit %zu", unit);
+            return appended(sd_bus_message_append(m, "v", "s", description));
+        }
+        if (strcmp(property, "LoadState") == 0) {
+            return appended(sd_bus_message_append(m, "v", "s", "loaded"));
+        }
+        if (strcmp(property, "ActiveState") == 0) {
+            return appended(sd_bus_message_append(m, "v", "s", active_state(unit)));
+        }
+        if (strcmp(property, "SubState") == 0) {
+            return appended(sd_bus_message_append(m, "v", "s", sub_state(unit)));
+        }
+        if (strcmp(property, "FragmentPath") == 0) {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/%s", fragment_dir, name);
+            return appended(sd_bus_message_append(m, "v", "s", path));
+        }
+        if (strcmp(property, "StateChangeTimestamp") == 0 || strcmp(property, "ActiveEnterTimestamp") == 0) {
+            return appended(sd_bus_message_append(m, "v", "t", running ? UINT64_C(1700000000000000) + unit : 0));
+        }
+        if (strcmp(property, "ActiveExitTimestamp") == 0) {
+            return appended(sd_bus_message_append(m, "v", "t", running ? 0 : UINT64_C(1700000000000000) + unit));
+        }
+        if (strcmp(property, "InactiveExitTimestampMonotonic") == 0) {
+            return appended(sd_bus_message_append(m, "v", "t", running ? UINT64_C(1000000) * unit + 500000 : 0));
+        }
+        if (strcmp(property, "ActiveEnterTimestampMonotonic") == 0) {
+            return appended(sd_bus_message_append(m, "v", "t", running ? UINT64_C(1000000) * (unit + 1) : 0));
+        }
+        /* Each unit requires and is ordered after the one before it. */
+        if (strcmp(property, "Requires") == 0 || strcmp(property, "After") == 0) {
+            char previous[NAME_SIZE];
+            if (unit == 0) {
+                return appended(sd_bus_message_append(m, "v", "as", 0));
+            }
+            unit_name(unit - 1, previous);
+            return appended(sd_bus_message_append(m, "v", "as", 1, previous));
+        }
+        if (strcmp(property, "Wants") == 0 || strcmp(property, "BindsTo") == 0 || strcmp(property, "Before") == 0) {
+            return appended(sd_bus_message_append(m, "v", "as", 0));
+        }
+        return 0;
+    }
+
+    if (strcmp(interface, SERVICE_INTERFACE) != 0 || is_socket(unit)) {
+        return 0;
+    }
+    if (strcmp(property, "Type") == 0) {
+        return appended(sd_bus_message_append(m, "v", "s", unit % 2 ? "notify" : "simple"));
+    }
+    if (strcmp(property, "User") == 0) {
+        return appended(sd_bus_message_append(m, "v", "s", unit % 2 ? "nobody" : ""));
+    }
+    if (strcmp(property, "ControlGroup") == 0) {
+        char cgroup[NAME_SIZE + 16];
+        snprintf(cgroup, sizeof(cgroup), "/system.slice/%s", name);
+        return appended(sd_bus_message_append(m, "v", "s", running ? cgroup : ""));
+    }
+    if (strcmp(property, "MemoryCurrent") == 0) {
+        return appended(sd_bus_message_append(m, "v", "t", running ? UINT64_C(1048576) * (unit % 64 + 1) : UINT64_MAX));
+    }
+    if (strcmp(property, "CPUUsageNSec") == 0) {
+        return appended(sd_bus_message_append(m, "v", "t", running ? UINT64_C(1000000) * unit : UINT64_MAX));
+    }
+    if (strcmp(property, "MainPID") == 0) {
+        return appended(sd_bus_message_append(m, "v", "u", running ? (uint32_t)(1000 + unit) : 0));
+    }
+    if (strcmp(property, "NRestarts") == 0) {
+        return appended(sd_bus_message_append(m, "v", "u", (uint32_t)(unit % 4)));
+    }
+    if (strcmp(property, "ExecStart") == 0) {
+        /* a(sasbttttuii): path, argv, ignore failure, then times, pid and status. */
+        char config[64];
+        snprintf(config, sizeof(config), "--config=/etc/fixture/%zu.conf", unit);
+        int r = sd_bus_message_open_container(m, 'v', "a(sasbttttuii)");
+        if (r >= 0) {
+            r = sd_bus_message_append(m, "a(sasbttttuii)", 1, "/usr/bin/true", 2, "true", config, 0,
+                                      UINT64_C(0), UINT64_C(0), UINT64_C(0), UINT64_C(0), 0u, 0, 0);
+        }
+        if (r >= 0) {
+            r = sd_bus_message_close_container(m);
+        }
+        return r < 0 ? r : 1;
+    }
+    return 0;
+}
+
+static const char* const unit_properties[] = {
+    "Id", "Description", "LoadState", "ActiveState", "SubState", "FragmentPath",
+    "StateChangeTimestamp", "ActiveEnterTimestamp", "ActiveExitTimestamp",
+    "InactiveExitTimestampMonotonic", "ActiveEnterTimestampMonotonic",
+    "Requires", "Wants", "BindsTo", "After", "Before",
+};
+
+static const char* const service_properties[] = {
+    "Type", "User", "ControlGroup", "MemoryCurrent", "CPUUsageNSec", "MainPID", "NRestarts", "ExecStart",
+};
+
+static int append_all(sd_bus_message* reply, size_t unit, const char* interface, const char* const* properties, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        int r = sd_bus_message_open_container(reply, 'e', "sv");
+        if (r >= 0) {
+            r = sd_bus_message_append(reply, "s", properties[i]);
+        }
+        if (r >= 0) {
+            r = append_property(reply, unit, interface, properties[i]);
+        }
+        if (r >= 0) {
+            r = sd_bus_message_close_container(reply);
+        }
+        if (r < 0) {
+            return r;
+        }
+    }
+    return 0;
+}
+
+static int get_all(sd_bus_message* m, size_t unit) {
+    sd_bus_message *reply = NULL;
+    const char *interface;
+    int r = sd_bus_message_read(m, "s", &interface);
+    if (r < 0) {
+        return r;
+    }
+
+    /* "" asks for every interface, as systemctl show does. */
+    bool all = interface[0] == '\0';
+    r = sd_bus_message_new_method_return(m, &reply);
+    if (r >= 0) {
+        r = sd_bus_message_open_container(reply, 'a', "{sv}");
+    }
+    if (r >= 0 && (all || strcmp(interface, UNIT_INTERFACE) == 0)) {
+        r = append_all(reply, unit, UNIT_INTERFACE, unit_properties, sizeof(unit_properties) / sizeof(unit_properties[0]));
+    }
+    if (r >= 0 && (all || strcmp(interface, SERVICE_INTERFACE) == 0) && !is_socket(unit)) {
+        r = append_all(reply, unit, SERVICE_INTERFACE, service_properties, sizeof(service_properties) / sizeof(service_properties[0]));
+    }
+    if (r >= 0) {
+        r = sd_bus_message_close_container(reply);
+    }
+    if (r >= 0) {
+        r = sd_bus_send(NULL, reply, NULL);
+    }
+    sd_bus_message_unref(reply);
+    return r;
+}
+
+static int get(sd_bus_message* m, size_t unit) {
+    sd_bus_message *reply = NULL;
+    const char *interface;
+    const char *property;
+    int r = sd_bus_message_read(m, "ss", &interface, &property);
+    if (r < 0) {
+        return r;
+    }
+
+    r = sd_bus_message_new_method_return(m, &reply);
+    if (r >= 0) {
+        r = append_property(reply, unit, interface, property);
+    }
+    if (r == 0) {
+        sd_bus_message_unref(reply);
+        return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_UNKNOWN_PROPERTY, "Unknown property %s.%s", interface, property);
+    }
+    if (r > 0) {
+        r = sd_bus_send(NULL, reply, NULL);
+    }
+    sd_bus_message_unref(reply);
+    return r;
+}
+
+static bool matches_any(char** values, const char* const* candidates, size_t count) {
+    if (values == NULL || values[0] == NULL) {
+        return true;
+    }
+    for (char **value = values; *value; value++) {
+        for (size_t i = 0; i < count; i++) {
+            if (strcmp(*value, candidates[i]) == 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool matches_pattern(char** patterns, const char* name) {
+    if (patterns == NULL || patterns[0] == NULL) {
+        return true;
+    }
+    for (char **pattern = patterns; *pattern; pattern++) {
+        if (fnmatch(*pattern, name, 0) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* ListUnits and its filtered variants: states match the load, active or sub state, like systemd. */
+static int list_units(sd_bus_message* m, bool with_states, bool with_patterns) {
+    sd_bus_message *reply = NULL;
+    char **states = NULL;
+    char **patterns = NULL;
+    int r = 0;
+
+    if (with_states) {
+        r = sd_bus_message_read_strv(m, &states);
+    }
+    if (r >= 0 && with_patterns) {
+        r = sd_bus_message_read_strv(m, &patterns);
+    }
+    if (r >= 0) {
+        r = sd_bus_message_new_method_return(m, &reply);
+    }
+    if (r >= 0) {
+        r = sd_bus_message_open_container(reply, 'a', "(ssssssouso)");
+    }
+
+    for (size_t unit = 0; unit < unit_count && r >= 0; unit++) {
+        char name[NAME_SIZE];
+        char description[64];
+        char *path = NULL;
+        const char *unit_states[] = { "loaded", active_state(unit), sub_state(unit) };
+
+        unit_name(unit, name);
+        if (!matches_any(states, unit_states, 3) || !matches_pattern(patterns, name)) {
+            continue;
+        }
+        snprintf(description, sizeof(description), "Fixture unit %zu", unit);
+        r = sd_bus_path_encode(UNIT_PATH_PREFIX, name, &path);
+        if (r >= 0) {
+            r = sd_bus_message_append(reply, "(ssssssouso)", name, description, "loaded", active_state(unit),
+                                      sub_state(unit), "", path, 0u, "", "/");
+        }
+        free(path);
+    }
+
+    if (r >= 0) {
+        r = sd_bus_message_close_container(reply);
+    }
+    if (r >= 0) {
+        r = sd_bus_send(NULL, reply, NULL);
+    }
+    sd_bus_message_unref(reply);
+    for (char **s = states; s && *s; s++) {
+        free(*s);
+    }
+    for (char **s = patterns; s && *s; s++) {
+        free(*s);
+    }
+    free(states);
+    free(patterns);
+    return r;
+}
+
+static int get_unit(sd_bus_message* m) {
+    const char *name;
+    char *path = NULL;
+    int r = sd_bus_message_read(m, "s", &name);
+    if (r < 0) {
+        return r;
+    }
+    if (unit_by_name(name) < 0) {
+        return sd_bus_reply_method_errorf(m, "org.freedesktop.systemd1.NoSuchUnit", "Unit %s not loaded.", name);
+    }
+    r = sd_bus_path_encode(UNIT_PATH_PREFIX, name, &path);
+    if (r >= 0) {
+        r = sd_bus_reply_method_return(m, "o", path);
+    }
+    free(path);
+    return r;
+}
+
+static int on_manager(sd_bus_message* m, void* userdata, sd_bus_error* ret_error) {
+    (void)userdata;
+    (void)ret_error;
+
+    if (sd_bus_message_is_method_call(m, MANAGER_INTERFACE, "GetUnit") || sd_bus_message_is_method_call(m, MANAGER_INTERFACE, "LoadUnit")) {
+        return get_unit(m);
+    }
+    if (sd_bus_message_is_method_call(m, MANAGER_INTERFACE, "ListUnits")) {
+        return list_units(m, false, false);
+    }
+    if (sd_bus_message_is_method_call(m, MANAGER_INTERFACE, "ListUnitsFiltered")) {
+        return list_units(m, true, false);
+    }
+    if (sd_bus_message_is_method_call(m, MANAGER_INTERFACE, "ListUnitsByPatterns")) {
+        return list_units(m, true, true);
+    }
+    if (sd_bus_message_is_method_call(m, MANAGER_INTERFACE, "Subscribe") || sd_bus_message_is_method_call(m, MANAGER_INTERFACE, "Unsubscribe")) {
+        return sd_bus_reply_method_return(m, "");
+    }
+    if (sd_bus_message_is_method_call(m, "org.freedesktop.DBus.Properties", "Get")) {
+        const char *interface;
+        const char *property;
+        int r = sd_bus_message_read(m, "ss", &interface, &property);
+        if (r < 0) {
+            return r;
+        }
+        if (strcmp(property, "UserspaceTimestampMonotonic") == 0) {
+            return sd_bus_reply_method_return(m, "v", "t", UINT64_C(500000));
+        }
+        return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_UNKNOWN_PROPERTY, "Unknown property %s.%s", interface, property);
+    }
+    return 0;
+}
+
+static int on_unit(sd_bus_message* m, void* userdata, sd_bus_error* ret_error) {
+    (void)userdata;
+    (void)ret_error;
+
+    long unit = unit_by_path(sd_bus_message_get_path(m));
+    if (unit < 0) {
+        return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_UNKNOWN_OBJECT, "Unknown object %s", sd_bus_message_get_path(m));
+    }
+    if (sd_bus_message_is_method_call(m, "org.freedesktop.DBus.Properties", "GetAll")) {
+        return get_all(m, (size_t)unit);
+    }
+    if (sd_bus_message_is_method_call(m, "org.freedesktop.DBus.Properties", "Get")) {
+        return get(m, (size_t)unit);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    sd_bus *bus = NULL;
+    int r;
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s ADDRESS UNITS [FRAGMENT_DIR]\n", argv[0]);
+        return 2;
+    }
+    unit_count = strtoul(argv[2], NULL, 10);
+    if (unit_count > MAX_UNITS) {
+        fprintf(stderr, "at most %d units\n", MAX_UNITS);
+        return 2;
+    }
+    if (argc > 3) {
+        fragment_dir = argv[3];
+    }
+
+    r = sd_bus_new(&bus);
+    if (r >= 0) {
+        r = sd_bus_set_address(bus, argv[1]);
+    }
+    if (r >= 0) {
+        r = sd_bus_set_bus_client(bus, 1);
+    }
+    if (r >= 0) {
+        r = sd_bus_start(bus);
+    }
+    if (r >= 0) {
+        r = sd_bus_add_object(bus, NULL, MANAGER_PATH, on_manager, NULL);
+    }
+    if (r >= 0) {
+        r = sd_bus_add_fallback(bus, NULL, UNIT_PATH_PREFIX, on_unit, NULL);
+    }
+    if (r >= 0) {
+        r = sd_bus_request_name(bus, DESTINATION, 0);
+    }
+    if (r < 0) {
+        fprintf(stderr, "Failed to serve %s on %s: %s\n", DESTINATION, argv[1], strerror(-r));
+        sd_bus_unref(bus);
+        return 1;
+    }
+
+    printf("ready\n");
+    fflush(stdout);
+
+    /* Runs until killed or the bus goes away. */
+    for (;;) {
+        r = sd_bus_process(bus, NULL);
+        if (r < 0) {
+            break;
+        }
+        if (r > 0) {
+            continue;
+        }
+        r = sd_bus_wait(bus, UINT64_MAX);
+        if (r < 0 && r != -EINTR) {
+            break;
+        }
+    }
+
+    sd_bus_flush_close_unref(bus);
+    return 0;
+}
@@ -0,0 +1,19 @@
+//! Runs the C tests of tests/c, which build.rs compiles into libservice_tests.
+#![cfg(target_os = "linux")]
+
+use std::os::raw::c_int;
+
+extern "C" {
+    fn runUnitFileTests() -> c_int;
+    fn runIntegrityTests() -> c_int;
+}
+
+#[test]
+fn unit_file_parser() {
+    assert_eq!(unsafe { runUnitFileTests() }, 0, "failed checks are listed on stderr");
+}
+
+#[test]
+fn integrity() {
+    assert_eq!(unsafe { runIntegrityTests() }, 0, "failed checks are listed on stderr");
+}